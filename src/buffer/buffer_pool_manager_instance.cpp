@@ -11,6 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager_instance.h"
+
+#include <vector>
+
 #include "common/macros.h"
 
 namespace bustub {
@@ -31,6 +34,13 @@ BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
+  // Reopening an existing database, new pages go past the ones already there.
+  if (disk_manager_ != nullptr) {
+    page_id_t num_pages = disk_manager_->GetNumPages();
+    if (num_pages > next_page_id_) {
+      next_page_id_ += (num_pages - next_page_id_ + num_instances_ - 1) / num_instances_ * num_instances_;
+    }
+  }
   // We allocate a consecutive memory space for the buffer pool.
   pages_ = new Page[pool_size_];
   replacer_ = new LRUReplacer(pool_size);
@@ -48,40 +58,37 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
 
 auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
   // Make sure you call DiskManager::WritePage!
-  std::lock_guard<std::mutex> guardlock(latch_);
+  std::unique_lock<std::mutex> guardlock(latch_);
   if (page_table_.find(page_id) == page_table_.end()) {
     return false;
   }
-  disk_manager_->WritePage(page_id, pages_[page_table_[page_id]].data_);
-  pages_[page_table_[page_id]].is_dirty_ = false;
+  WriteFrame(&guardlock, page_table_[page_id]);
   return true;
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
-  std::lock_guard<std::mutex> guardlock(latch_);
-  for (auto item : page_table_) {
-    disk_manager_->WritePage(item.first, pages_[page_table_[item.first]].data_);
-    pages_[page_table_[item.first]].is_dirty_ = false;
+  std::unique_lock<std::mutex> guardlock(latch_);
+  std::vector<page_id_t> page_ids;
+  for (const auto &[page_id, frame_id] : page_table_) {
+    page_ids.push_back(page_id);
+  }
+  // The page table may change while a page waits for the log.
+  for (auto page_id : page_ids) {
+    auto it = page_table_.find(page_id);
+    if (it != page_table_.end()) {
+      WriteFrame(&guardlock, it->second);
+    }
   }
   // You can do it!
 }
 
 auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
   // 0.   Make sure you call AllocatePage!
-  std::lock_guard<std::mutex> guardlock(latch_);
+  std::unique_lock<std::mutex> guardlock(latch_);
   // 1.   If all the pages in the buffer pool are pinned, return nullptr.
   frame_id_t newframe;
-  if (!free_list_.empty()) {
-    newframe = free_list_.back();
-    free_list_.pop_back();
-  } else {
-    if (!replacer_->Victim(&newframe)) {
-      return nullptr;
-    }
-    if (pages_[newframe].is_dirty_) {
-      disk_manager_->WritePage(pages_[newframe].page_id_, pages_[newframe].data_);
-    }
-    page_table_.erase(pages_[newframe].page_id_);
+  if (!FindFrame(&guardlock, &newframe)) {
+    return nullptr;
   }
   *page_id = AllocatePage();
   page_table_[*page_id] = newframe;
@@ -90,6 +97,10 @@ auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
   pages_[newframe].pin_count_ = 1;
   disk_manager_->WritePage(*page_id, pages_[newframe].data_);
   pages_[newframe].is_dirty_ = false;
+  pages_[newframe].rec_lsn_ = INVALID_LSN;
+  pages_[newframe].delta_lsn_ = INVALID_LSN;
+  pages_[newframe].delta_logged_ = false;
+  SetRecLSN(newframe);
   return &pages_[newframe];
   // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
   // 3.   Update P's metadata, zero out memory and add P to the page table.
@@ -98,32 +109,37 @@ auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
 
 auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
   // 1.     Search the page table for the requested page (P).
-  std::lock_guard<std::mutex> guardlock(latch_);
+  std::unique_lock<std::mutex> guardlock(latch_);
   if (page_table_.find(page_id) != page_table_.end()) {
     // 1.1    If P exists, pin it and return it immediately.
     replacer_->Pin(page_table_[page_id]);
     pages_[page_table_[page_id]].pin_count_++;
+    SetRecLSN(page_table_[page_id]);
     return &pages_[page_table_[page_id]];
   }
   // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
   frame_id_t newframe;
-  if (!free_list_.empty()) {
-    newframe = free_list_.back();
-    free_list_.pop_back();
-  } else {
-    if (!replacer_->Victim(&newframe)) {
-      return nullptr;
-    }
-    if (pages_[newframe].is_dirty_) {
-      disk_manager_->WritePage(pages_[newframe].page_id_, pages_[newframe].data_);
-    }
-    page_table_.erase(pages_[newframe].page_id_);
+  if (!FindFrame(&guardlock, &newframe)) {
+    return nullptr;
+  }
+  // Another thread may have brought the page in while the victim waited for the log.
+  if (page_table_.find(page_id) != page_table_.end()) {
+    pages_[newframe].page_id_ = INVALID_PAGE_ID;
+    free_list_.push_back(newframe);
+    replacer_->Pin(page_table_[page_id]);
+    pages_[page_table_[page_id]].pin_count_++;
+    SetRecLSN(page_table_[page_id]);
+    return &pages_[page_table_[page_id]];
   }
   page_table_[page_id] = newframe;
   disk_manager_->ReadPage(page_id, pages_[newframe].data_);
   pages_[newframe].page_id_ = page_id;
   pages_[newframe].pin_count_ = 1;
   pages_[newframe].is_dirty_ = false;
+  pages_[newframe].rec_lsn_ = INVALID_LSN;
+  pages_[newframe].delta_lsn_ = INVALID_LSN;
+  pages_[newframe].delta_logged_ = false;
+  SetRecLSN(newframe);
   return &pages_[newframe];
   //        Note that pages are always found from the free list first.
   // 2.     If R is dirty, write it back to the disk.
@@ -134,19 +150,24 @@ auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
 auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   // 0.   Make sure you call DeallocatePage!
   // 1.   Search the page table for the requested page (P).
-  std::lock_guard<std::mutex> guardlock(latch_);
+  std::unique_lock<std::mutex> guardlock(latch_);
   if (page_table_.find(page_id) == page_table_.end()) {
     // 1.   If P does not exist, return true.
     return true;
   }
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   if (pages_[page_table_[page_id]].pin_count_ == 0) {
-    replacer_->Pin(page_table_[page_id]);
     if (pages_[page_table_[page_id]].is_dirty_) {
-      disk_manager_->WritePage(page_id, pages_[page_table_[page_id]].data_);
+      WriteFrame(&guardlock, page_table_[page_id]);
+      // Somebody fetched the page while it waited for the log.
+      if (pages_[page_table_[page_id]].pin_count_ != 0) {
+        return false;
+      }
     }
+    replacer_->Pin(page_table_[page_id]);
     pages_[page_table_[page_id]].ResetMemory();
     pages_[page_table_[page_id]].is_dirty_ = false;
+    pages_[page_table_[page_id]].rec_lsn_ = INVALID_LSN;
     pages_[page_table_[page_id]].page_id_ = INVALID_PAGE_ID;
     pages_[page_table_[page_id]].pin_count_ = 0;
     free_list_.push_back(page_table_[page_id]);
@@ -165,10 +186,87 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
   pages_[page_table_[page_id]].is_dirty_ |= is_dirty;
   if (pages_[page_table_[page_id]].pin_count_-- == 1) {
     replacer_->Unpin(page_table_[page_id]);
+    // Nobody modified the page, so it has nothing to recover.
+    if (!pages_[page_table_[page_id]].is_dirty_) {
+      pages_[page_table_[page_id]].rec_lsn_ = INVALID_LSN;
+    }
   }
   return true;
 }
 
+void BufferPoolManagerInstance::WriteFrame(std::unique_lock<std::mutex> *lk, frame_id_t frame_id) {
+  // Write-ahead logging: the log records describing the page must reach disk before the page does.
+  WaitForLog(lk, frame_id);
+  disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+  pages_[frame_id].is_dirty_ = false;
+  // A page that is still pinned can be modified again right away.
+  pages_[frame_id].rec_lsn_ = INVALID_LSN;
+  if (pages_[frame_id].pin_count_ > 0) {
+    SetRecLSN(frame_id);
+  }
+}
+
+void BufferPoolManagerInstance::WaitForLog(std::unique_lock<std::mutex> *lk, frame_id_t frame_id) {
+  if (log_manager_ == nullptr) {
+    return;
+  }
+  auto &page = pages_[frame_id];
+  // The page may change again while the latch is dropped, so check again after every wait.
+  for (auto lsn = page.GetLastLoggedLSN(); lsn > log_manager_->GetPersistentLSN(); lsn = page.GetLastLoggedLSN()) {
+    if (page.pin_count_++ == 0) {
+      replacer_->Pin(frame_id);
+    }
+    lk->unlock();
+    log_manager_->WaitUntilPersistent(lsn);
+    lk->lock();
+    if (--page.pin_count_ == 0) {
+      replacer_->Unpin(frame_id);
+    }
+  }
+}
+
+auto BufferPoolManagerInstance::FindFrame(std::unique_lock<std::mutex> *lk, frame_id_t *frame_id) -> bool {
+  while (true) {
+    if (!free_list_.empty()) {
+      *frame_id = free_list_.back();
+      free_list_.pop_back();
+      return true;
+    }
+    if (!replacer_->Victim(frame_id)) {
+      return false;
+    }
+    if (pages_[*frame_id].is_dirty_) {
+      WriteFrame(lk, *frame_id);
+      // Fetched while it waited for the log, the frame is in use again: look for another victim.
+      if (pages_[*frame_id].pin_count_ != 0) {
+        continue;
+      }
+      // Back in the replacer after the wait.
+      replacer_->Pin(*frame_id);
+    }
+    page_table_.erase(pages_[*frame_id].page_id_);
+    return true;
+  }
+}
+
+void BufferPoolManagerInstance::SetRecLSN(frame_id_t frame_id) {
+  // Every record written from now on has at least the next lsn.
+  if (log_manager_ != nullptr && !pages_[frame_id].is_dirty_ && pages_[frame_id].rec_lsn_ == INVALID_LSN) {
+    pages_[frame_id].rec_lsn_ = log_manager_->GetNextLSN();
+  }
+}
+
+auto BufferPoolManagerInstance::GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> {
+  std::lock_guard<std::mutex> guardlock(latch_);
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (const auto &[page_id, frame_id] : page_table_) {
+    if (pages_[frame_id].rec_lsn_ != INVALID_LSN) {
+      dirty_pages.emplace_back(page_id, pages_[frame_id].rec_lsn_);
+    }
+  }
+  return dirty_pages;
+}
+
 auto BufferPoolManagerInstance::AllocatePage() -> page_id_t {
   std::lock_guard<std::mutex> guardlock(platch_);
   const page_id_t next_page_id = next_page_id_;
@@ -35,6 +35,15 @@ auto ParallelBufferPoolManager::GetPoolSize() -> size_t {
   return num_instances_ * poolsize_;
 }
 
+auto ParallelBufferPoolManager::GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> {
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto instance_dirty_pages = mbp_[i]->GetDirtyPageTable();
+    dirty_pages.insert(dirty_pages.end(), instance_dirty_pages.begin(), instance_dirty_pages.end());
+  }
+  return dirty_pages;
+}
+
 auto ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) -> BufferPoolManager * {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   size_t targetindex = page_id % num_instances_;
@@ -12,6 +12,9 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <optional>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -19,8 +22,8 @@
 
 namespace bustub {
 
-auto LockManager::GrantS(const RID &rid, txn_id_t txn_id) -> bool {
-  for (auto i : lock_table_[rid].request_queue_) {
+auto LockManager::GrantS(const LockRequestQueue &queue, txn_id_t txn_id) -> bool {
+  for (const auto &i : queue.request_queue_) {
     if (i.txn_id_ == txn_id) {
       return true;
     }
@@ -33,12 +36,11 @@ auto LockManager::GrantS(const RID &rid, txn_id_t txn_id) -> bool {
   return true;
 }
 
-auto LockManager::GrantX(const RID &rid, txn_id_t txn_id) -> bool {
-  return lock_table_[rid].request_queue_.begin()->txn_id_ == txn_id;
+auto LockManager::GrantX(const LockRequestQueue &queue, txn_id_t txn_id) -> bool {
+  return queue.request_queue_.begin()->txn_id_ == txn_id;
 }
 
 auto LockManager::LockShared(Transaction *txn, const RID &rid) -> bool {
-  std::unique_lock lk(latch_);
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
@@ -57,39 +59,55 @@ auto LockManager::LockShared(Transaction *txn, const RID &rid) -> bool {
   if (txn->IsSharedLocked(rid)) {
     return true;
   }
+  if (FastLock(txn, rid, LockMode::SHARED)) {
+    txn->GetSharedLockSet()->emplace(rid);
+    return true;
+  }
+  auto &partition = GetPartition(rid);
+  std::unique_lock lk(partition.latch_);
+  Inflate(&partition, rid);
+  auto &queue = partition.lock_table_[rid];
   // Install request in the back.
-  lock_table_[rid].request_queue_.emplace_back(txn->GetTransactionId(), LockMode::SHARED);
-  auto thisiter = lock_table_[rid].request_queue_.end();
+  queue.request_queue_.emplace_back(txn->GetTransactionId(), LockMode::SHARED);
+  CountRequests(rid, 1);
+  auto thisiter = queue.request_queue_.end();
   --thisiter;
   // Kill all younger W-request.And notify.
-  for (auto i = lock_table_[rid].request_queue_.begin(); i != lock_table_[rid].request_queue_.end();) {
-    auto trans = TransactionManager::GetTransaction(i->txn_id_);
-    if (i->lock_mode_ == LockMode::EXCLUSIVE && i->txn_id_ > txn->GetTransactionId() &&
-        trans->GetState() != TransactionState::ABORTED) {
-      trans->SetState(TransactionState::ABORTED);
-      // Erase. Maybe not exist. Still fine.
-      trans->GetExclusiveLockSet()->erase(rid);
-      i = lock_table_[rid].request_queue_.erase(i);
-      continue;
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    TransactionRegistry::Guard registry_guard(&TransactionManager::txn_registry);
+    for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end();) {
+      auto trans = TransactionManager::GetTransaction(i->txn_id_);
+      if (i->lock_mode_ == LockMode::EXCLUSIVE && i->txn_id_ > txn->GetTransactionId() && !IsFinishing(trans)) {
+        // The victim may be running in another partition, it drops rid from its lock sets when it unlocks it.
+        trans->SetState(TransactionState::ABORTED);
+        profiler_.RecordWound();
+        i = queue.request_queue_.erase(i);
+        CountRequests(rid, -1);
+        continue;
+      }
+      ++i;
     }
-    ++i;
   }
-  lock_table_[rid].cv_.notify_all();
+  queue.cv_.notify_all();
   // Wait for kill,or granted.
-  while (txn->GetState() != TransactionState::ABORTED && !GrantS(rid, txn->GetTransactionId())) {
-    lock_table_[rid].cv_.wait(lk);
+  LockProfiler::WaitTimer timer{&profiler_};
+  while (txn->GetState() != TransactionState::ABORTED && !GrantS(queue, txn->GetTransactionId())) {
+    timer.Start();
+    queue.cv_.wait(lk);
   }
   // Check for kill.
-  if (txn->GetState() == TransactionState::ABORTED) {
-    return false;
+  auto granted = txn->GetState() != TransactionState::ABORTED;
+  if (granted) {
+    txn->GetSharedLockSet()->emplace(rid);
+    thisiter->granted_ = true;
   }
-  txn->GetSharedLockSet()->emplace(rid);
-  thisiter->granted_ = true;
-  return true;
+  // The profiler has a latch of its own, keep it out of the partition latch.
+  lk.unlock();
+  profiler_.RecordWait(LockMode::SHARED, rid, timer);
+  return granted;
 }
 
 auto LockManager::LockExclusive(Transaction *txn, const RID &rid) -> bool {
-  std::unique_lock lk(latch_);
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
@@ -101,58 +119,77 @@ auto LockManager::LockExclusive(Transaction *txn, const RID &rid) -> bool {
   if (txn->IsExclusiveLocked(rid)) {
     return true;
   }
+  if (txn->IsSharedLocked(rid)) {
+    profiler_.RecordUpgrade();
+  }
+  if (FastLock(txn, rid, LockMode::EXCLUSIVE)) {
+    txn->GetSharedLockSet()->erase(rid);
+    txn->GetExclusiveLockSet()->emplace(rid);
+    return true;
+  }
+  auto &partition = GetPartition(rid);
+  std::unique_lock lk(partition.latch_);
+  Inflate(&partition, rid);
+  auto &queue = partition.lock_table_[rid];
   // Check hold the S-lock.
   if (txn->IsSharedLocked(rid)) {
     // remove share request.
-    for (auto i = lock_table_[rid].request_queue_.begin(); i != lock_table_[rid].request_queue_.end(); ++i) {
+    for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end(); ++i) {
       if (i->txn_id_ == txn->GetTransactionId()) {
         txn->GetSharedLockSet()->erase(rid);
-        lock_table_[rid].request_queue_.erase(i);
+        queue.request_queue_.erase(i);
+        CountRequests(rid, -1);
         break;
       }
     }
   }
   // Install request in the back.
-  lock_table_[rid].request_queue_.emplace_back(txn->GetTransactionId(), LockMode::EXCLUSIVE);
-  auto thisiter = lock_table_[rid].request_queue_.end();
+  queue.request_queue_.emplace_back(txn->GetTransactionId(), LockMode::EXCLUSIVE);
+  CountRequests(rid, 1);
+  auto thisiter = queue.request_queue_.end();
   --thisiter;
   // Kill all younger request. Notify.
-  for (auto i = lock_table_[rid].request_queue_.begin(); i != lock_table_[rid].request_queue_.end();) {
-    auto trans = TransactionManager::GetTransaction(i->txn_id_);
-    if (trans->GetState() != TransactionState::ABORTED && i->txn_id_ > txn->GetTransactionId()) {
-      trans->SetState(TransactionState::ABORTED);
-      // Erase. Maybe not exsit . Still fine.
-      trans->GetSharedLockSet()->erase(rid);
-      trans->GetExclusiveLockSet()->erase(rid);
-      i = lock_table_[rid].request_queue_.erase(i);
-      continue;
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    TransactionRegistry::Guard registry_guard(&TransactionManager::txn_registry);
+    for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end();) {
+      auto trans = TransactionManager::GetTransaction(i->txn_id_);
+      if (!IsFinishing(trans) && i->txn_id_ > txn->GetTransactionId()) {
+        // The victim may be running in another partition, it drops rid from its lock sets when it unlocks it.
+        trans->SetState(TransactionState::ABORTED);
+        profiler_.RecordWound();
+        i = queue.request_queue_.erase(i);
+        CountRequests(rid, -1);
+        continue;
+      }
+      ++i;
     }
-    ++i;
   }
-  lock_table_[rid].cv_.notify_all();
+  queue.cv_.notify_all();
   // Wait for kill, or granted.
-  while (txn->GetState() != TransactionState::ABORTED && !GrantX(rid, txn->GetTransactionId())) {
-    lock_table_[rid].cv_.wait(lk);
+  LockProfiler::WaitTimer timer{&profiler_};
+  while (txn->GetState() != TransactionState::ABORTED && !GrantX(queue, txn->GetTransactionId())) {
+    timer.Start();
+    queue.cv_.wait(lk);
   }
   // Check for kill.
-  if (txn->GetState() == TransactionState::ABORTED) {
-    return false;
+  auto granted = txn->GetState() != TransactionState::ABORTED;
+  if (granted) {
+    thisiter->granted_ = true;
+    txn->GetExclusiveLockSet()->emplace(rid);
   }
-
-  thisiter->granted_ = true;
-  txn->GetExclusiveLockSet()->emplace(rid);
-  return true;
+  lk.unlock();
+  profiler_.RecordWait(LockMode::EXCLUSIVE, rid, timer);
+  return granted;
 }
 
 auto LockManager::LockUpgrade(Transaction *txn, const RID &rid) -> bool {
-  std::unique_lock lk(latch_);
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
   }
   if (txn->IsExclusiveLocked(rid)) {
     return true;
   }
-  if (lock_table_[rid].upgrading_ != INVALID_TXN_ID || txn->GetState() == TransactionState::SHRINKING) {
+  if (txn->GetState() == TransactionState::SHRINKING) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
@@ -164,61 +201,102 @@ auto LockManager::LockUpgrade(Transaction *txn, const RID &rid) -> bool {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
+  profiler_.RecordUpgrade();
+  if (FastLock(txn, rid, LockMode::EXCLUSIVE)) {
+    txn->GetSharedLockSet()->erase(rid);
+    txn->GetExclusiveLockSet()->emplace(rid);
+    return true;
+  }
+  auto &partition = GetPartition(rid);
+  std::unique_lock lk(partition.latch_);
+  Inflate(&partition, rid);
+  auto &queue = partition.lock_table_[rid];
+  if (queue.upgrading_ != INVALID_TXN_ID) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   // Find the S-request.remove it.
-  for (auto i = lock_table_[rid].request_queue_.begin(); i != lock_table_[rid].request_queue_.end(); ++i) {
+  for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end(); ++i) {
     if (i->txn_id_ == txn->GetTransactionId()) {
       txn->GetSharedLockSet()->erase(rid);
-      lock_table_[rid].request_queue_.erase(i);
+      queue.request_queue_.erase(i);
+      CountRequests(rid, -1);
       break;
     }
   }
   // Install request in the back.
-  lock_table_[rid].request_queue_.emplace_back(txn->GetTransactionId(), LockMode::EXCLUSIVE);
-  auto thisiter = lock_table_[rid].request_queue_.end();
+  queue.request_queue_.emplace_back(txn->GetTransactionId(), LockMode::EXCLUSIVE);
+  CountRequests(rid, 1);
+  auto thisiter = queue.request_queue_.end();
   --thisiter;
   // Kill all younger request. Notify.
-  for (auto i = lock_table_[rid].request_queue_.begin(); i != lock_table_[rid].request_queue_.end();) {
-    auto trans = TransactionManager::GetTransaction(i->txn_id_);
-    if (trans->GetState() != TransactionState::ABORTED && i->txn_id_ > txn->GetTransactionId()) {
-      trans->SetState(TransactionState::ABORTED);
-      // Erase. Maybe not exsit . Still fine.
-      trans->GetSharedLockSet()->erase(rid);
-      trans->GetExclusiveLockSet()->erase(rid);
-      i = lock_table_[rid].request_queue_.erase(i);
-      continue;
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    TransactionRegistry::Guard registry_guard(&TransactionManager::txn_registry);
+    for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end();) {
+      auto trans = TransactionManager::GetTransaction(i->txn_id_);
+      if (!IsFinishing(trans) && i->txn_id_ > txn->GetTransactionId()) {
+        // The victim may be running in another partition, it drops rid from its lock sets when it unlocks it.
+        trans->SetState(TransactionState::ABORTED);
+        profiler_.RecordWound();
+        i = queue.request_queue_.erase(i);
+        CountRequests(rid, -1);
+        continue;
+      }
+      ++i;
     }
-    ++i;
   }
-  lock_table_[rid].cv_.notify_all();
+  queue.cv_.notify_all();
   // Wait for kill, or granted.
-  while (txn->GetState() != TransactionState::ABORTED && !GrantX(rid, txn->GetTransactionId())) {
-    lock_table_[rid].cv_.wait(lk);
+  LockProfiler::WaitTimer timer{&profiler_};
+  while (txn->GetState() != TransactionState::ABORTED && !GrantX(queue, txn->GetTransactionId())) {
+    timer.Start();
+    queue.cv_.wait(lk);
   }
   // Check for kill.
-  if (txn->GetState() == TransactionState::ABORTED) {
-    return false;
+  auto granted = txn->GetState() != TransactionState::ABORTED;
+  if (granted) {
+    thisiter->granted_ = true;
+    txn->GetExclusiveLockSet()->emplace(rid);
   }
-
-  thisiter->granted_ = true;
-  txn->GetExclusiveLockSet()->emplace(rid);
-  return true;
+  lk.unlock();
+  profiler_.RecordWait(LockMode::EXCLUSIVE, rid, timer);
+  return granted;
 }
 
 auto LockManager::Unlock(Transaction *txn, const RID &rid) -> bool {
-  std::unique_lock lk(latch_);
+  for (auto &[oid, rows] : *txn->GetTableRowLockSet()) {
+    rows.erase(rid);
+  }
+  LockMode lock_mode;
+  if (FastUnlock(txn, rid, &lock_mode)) {
+    if (txn->GetState() == TransactionState::GROWING &&
+        (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ || lock_mode == LockMode::EXCLUSIVE)) {
+      txn->SetState(TransactionState::SHRINKING);
+    }
+    txn->GetExclusiveLockSet()->erase(rid);
+    txn->GetSharedLockSet()->erase(rid);
+    return true;
+  }
+  auto &partition = GetPartition(rid);
+  std::unique_lock lk(partition.latch_);
+  auto &queue = partition.lock_table_[rid];
   // Remove the request record.
   bool unlocked = false;
-  auto iter = lock_table_[rid].request_queue_.begin();
-  for (; iter != lock_table_[rid].request_queue_.end(); ++iter) {
+  auto iter = queue.request_queue_.begin();
+  for (; iter != queue.request_queue_.end(); ++iter) {
     if (iter->txn_id_ == txn->GetTransactionId()) {
       unlocked = true;
       break;
     }
   }
-  // What if can not unlock?
   if (!unlocked) {
-    txn->SetState(TransactionState::ABORTED);
-    LOG_INFO("Unlock fail");
+    // A wounded transaction lost its request already.
+    if (txn->GetState() != TransactionState::ABORTED) {
+      txn->SetState(TransactionState::ABORTED);
+      LOG_INFO("Unlock fail");
+    }
+    txn->GetExclusiveLockSet()->erase(rid);
+    txn->GetSharedLockSet()->erase(rid);
     return false;
   }
   if (txn->GetState() == TransactionState::GROWING &&
@@ -227,9 +305,575 @@ auto LockManager::Unlock(Transaction *txn, const RID &rid) -> bool {
   }
   txn->GetExclusiveLockSet()->erase(rid);
   txn->GetSharedLockSet()->erase(rid);
-  lock_table_[rid].request_queue_.erase(iter);
-  lock_table_[rid].cv_.notify_all();
+  queue.request_queue_.erase(iter);
+  CountRequests(rid, -1);
+  queue.cv_.notify_all();
+  return true;
+}
+
+auto LockManager::LockShared(Transaction *txn, table_oid_t oid, const RID &rid) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->IsTableSharedLocked(oid)) {
+    return true;
+  }
+  if (!LockIntention(txn, LockMode::INTENTION_SHARED, oid) || !LockShared(txn, rid)) {
+    return false;
+  }
+  AddRowLock(txn, oid, rid);
+  return true;
+}
+
+auto LockManager::LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->IsTableExclusiveLocked(oid)) {
+    return true;
+  }
+  if (!LockIntention(txn, LockMode::INTENTION_EXCLUSIVE, oid) || !LockExclusive(txn, rid)) {
+    return false;
+  }
+  AddRowLock(txn, oid, rid);
+  return true;
+}
+
+auto LockManager::LockUpgrade(Transaction *txn, table_oid_t oid, const RID &rid) -> bool {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->IsTableExclusiveLocked(oid)) {
+    return true;
+  }
+  if (!LockIntention(txn, LockMode::INTENTION_EXCLUSIVE, oid) || !LockUpgrade(txn, rid)) {
+    return false;
+  }
+  AddRowLock(txn, oid, rid);
   return true;
 }
 
+auto LockManager::LockIndexKey(Transaction *txn, index_oid_t index_oid, const Tuple &key, LockMode lock_mode) -> bool {
+  if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    return txn->GetState() != TransactionState::ABORTED;
+  }
+  auto rid = IndexBucketRid(index_oid, key);
+  if (lock_mode == LockMode::EXCLUSIVE) {
+    // Takes over a shared lock on the bucket too.
+    return LockExclusive(txn, rid);
+  }
+  // Only a repeatable read has to find the same entries again.
+  if (txn->GetIsolationLevel() != IsolationLevel::REPEATABLE_READ) {
+    return txn->GetState() != TransactionState::ABORTED;
+  }
+  return LockShared(txn, rid);
+}
+
+auto LockManager::IndexBucketRid(index_oid_t index_oid, const Tuple &key) -> RID {
+  // Records have page ids from 0 on, so the buckets of every index get a negative page id of their own.
+  auto bucket = std::hash<std::string_view>()(std::string_view(key.GetData(), key.GetLength())) % INDEX_LOCK_BUCKETS;
+  return RID(-2 - static_cast<page_id_t>(index_oid), static_cast<uint32_t>(bucket));
+}
+
+auto LockManager::LockIntention(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  // Only this transaction changes its table locks, no latch needed to look at them.
+  auto held = txn->GetTableLockSet()->find(oid);
+  if (held != txn->GetTableLockSet()->end() && CombineModes(held->second, lock_mode) == held->second) {
+    return true;
+  }
+  return LockTable(txn, lock_mode, oid);
+}
+
+auto LockManager::TryLockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  std::unique_lock lk(table_latch_);
+  if (txn->GetState() != TransactionState::GROWING) {
+    return false;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && lock_mode != LockMode::EXCLUSIVE) {
+    return false;
+  }
+  auto &queue = table_lock_table_[oid];
+  auto held = txn->GetTableLockSet()->find(oid);
+  auto mode = lock_mode;
+  auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                              [txn](const LockRequest &r) { return r.txn_id_ == txn->GetTransactionId(); });
+  if (held != txn->GetTableLockSet()->end()) {
+    mode = CombineModes(held->second, lock_mode);
+    if (mode == held->second) {
+      return true;
+    }
+    if (request == queue.request_queue_.end()) {
+      // Wounded, the table lock is gone already.
+      return false;
+    }
+    request->lock_mode_ = mode;
+  } else {
+    request = queue.request_queue_.emplace(queue.request_queue_.end(), txn->GetTransactionId(), mode);
+  }
+  if (!GrantTable(queue, txn->GetTransactionId())) {
+    if (held != txn->GetTableLockSet()->end()) {
+      request->lock_mode_ = held->second;
+    } else {
+      queue.request_queue_.erase(request);
+    }
+    return false;
+  }
+  request->granted_ = true;
+  (*txn->GetTableLockSet())[oid] = mode;
+  return true;
+}
+
+void LockManager::AddRowLock(Transaction *txn, table_oid_t oid, const RID &rid) {
+  auto &rows = (*txn->GetTableRowLockSet())[oid];
+  rows.emplace(rid);
+  // Try again every escalation_threshold_ locks, so failing attempts stay cheap.
+  if (escalation_threshold_ == 0 || rows.size() <= escalation_threshold_ ||
+      (rows.size() - 1) % escalation_threshold_ != 0) {
+    return;
+  }
+  bool exclusive = std::any_of(rows.begin(), rows.end(), [txn](const RID &r) { return txn->IsExclusiveLocked(r); });
+  if (!TryLockTable(txn, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED, oid)) {
+    return;
+  }
+  for (const auto &r : rows) {
+    DropRowLock(txn, r);
+  }
+  rows.clear();
+  profiler_.RecordEscalation();
+}
+
+void LockManager::DropRowLock(Transaction *txn, const RID &rid) {
+  txn->GetExclusiveLockSet()->erase(rid);
+  txn->GetSharedLockSet()->erase(rid);
+  LockMode lock_mode;
+  if (FastUnlock(txn, rid, &lock_mode)) {
+    return;
+  }
+  auto &partition = GetPartition(rid);
+  std::unique_lock lk(partition.latch_);
+  auto &queue = partition.lock_table_[rid];
+  auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                              [txn](const LockRequest &r) { return r.txn_id_ == txn->GetTransactionId(); });
+  if (request != queue.request_queue_.end()) {
+    queue.request_queue_.erase(request);
+    CountRequests(rid, -1);
+    queue.cv_.notify_all();
+  }
+}
+
+auto LockManager::FastLock(Transaction *txn, const RID &rid, LockMode lock_mode) -> bool {
+  auto &word = GetLockWord(rid);
+  auto value = word.word_.load();
+  while (true) {
+    if (WordState(value) == WORD_INFLATED ||
+        (WordState(value) == WORD_FAST && WordOwner(value) != txn->GetTransactionId())) {
+      return false;
+    }
+    if (WordState(value) == WORD_FREE) {
+      // Claim the word before writing an entry, so that no other transaction writes the entries at the same time.
+      auto claimed = MakeFastWord(0, txn->GetTransactionId());
+      if (word.word_.compare_exchange_weak(value, claimed)) {
+        value = claimed;
+      }
+      continue;
+    }
+    uint64_t entries = WordEntries(value);
+    size_t free_entry = FAST_PATH_ENTRIES;
+    size_t held_entry = FAST_PATH_ENTRIES;
+    for (size_t i = 0; i < FAST_PATH_ENTRIES; i++) {
+      if ((entries & (1UL << i)) == 0) {
+        free_entry = std::min(free_entry, i);
+      } else if (word.rids_[i].load() == rid.Get()) {
+        held_entry = i;
+      }
+    }
+    if (free_entry == FAST_PATH_ENTRIES) {
+      if (held_entry == FAST_PATH_ENTRIES || lock_mode != LockMode::EXCLUSIVE) {
+        return false;
+      }
+      // No entry left for the upgrade, it takes over the shared one. Inflate waits while the word is busy, so it never
+      // sees the new mode before the upgrade is done.
+      if (!word.word_.compare_exchange_weak(value, value | WORD_BUSY)) {
+        continue;
+      }
+      word.exclusive_[held_entry].store(true);
+      // Nobody else changes a busy word.
+      word.word_.store(value);
+      return true;
+    }
+    // The word is ours, so only we write its entries, and Inflate only reads the ones the swap below publishes.
+    word.rids_[free_entry].store(rid.Get());
+    word.exclusive_[free_entry].store(lock_mode == LockMode::EXCLUSIVE);
+    // An upgrade gives up the shared entry in the same swap.
+    uint64_t held = held_entry == FAST_PATH_ENTRIES ? 0 : 1UL << held_entry;
+    auto desired = MakeFastWord((entries | 1UL << free_entry) & ~held, txn->GetTransactionId());
+    if (word.word_.compare_exchange_weak(value, desired)) {
+      return true;
+    }
+  }
+}
+
+auto LockManager::FastUnlock(Transaction *txn, const RID &rid, LockMode *lock_mode) -> bool {
+  auto &word = GetLockWord(rid);
+  auto value = word.word_.load();
+  while (WordState(value) == WORD_FAST && WordOwner(value) == txn->GetTransactionId()) {
+    uint64_t entries = WordEntries(value);
+    size_t entry = 0;
+    while (entry < FAST_PATH_ENTRIES && ((entries & (1UL << entry)) == 0 || word.rids_[entry].load() != rid.Get())) {
+      entry++;
+    }
+    if (entry == FAST_PATH_ENTRIES) {
+      return false;
+    }
+    bool exclusive = word.exclusive_[entry].load();
+    entries &= ~(1UL << entry);
+    auto desired = entries == 0 ? WORD_FREE : MakeFastWord(entries, txn->GetTransactionId());
+    if (word.word_.compare_exchange_weak(value, desired)) {
+      *lock_mode = exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LockManager::Inflate(LockTablePartition *partition, const RID &rid) {
+  auto &word = GetLockWord(rid);
+  auto value = word.word_.load();
+  while (WordState(value) != WORD_INFLATED) {
+    if ((value & WORD_BUSY) != 0) {
+      // The owner is changing the mode of an entry in use, wait for it to finish.
+      std::this_thread::yield();
+      value = word.word_.load();
+      continue;
+    }
+    std::vector<std::pair<RID, bool>> locks;
+    for (size_t i = 0; i < FAST_PATH_ENTRIES; i++) {
+      if (WordState(value) == WORD_FAST && (WordEntries(value) & (1UL << i)) != 0) {
+        locks.emplace_back(RID(word.rids_[i].load()), word.exclusive_[i].load());
+      }
+    }
+    // The swap fails if the owner changed the word meanwhile, the entries read are the ones in use otherwise.
+    if (word.word_.compare_exchange_weak(value, MakeInflatedWord(locks.size()))) {
+      for (const auto &[locked, exclusive] : locks) {
+        auto &request = partition->lock_table_[locked].request_queue_.emplace_back(
+            WordOwner(value), exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED);
+        request.granted_ = true;
+      }
+      return;
+    }
+  }
+}
+
+void LockManager::CountRequests(const RID &rid, int64_t delta) {
+  auto &word = GetLockWord(rid);
+  // An inflated word only changes under the latch, a plain store will do.
+  auto requests = WordRequests(word.word_.load()) + delta;
+  word.word_.store(requests == 0 ? WORD_FREE : MakeInflatedWord(requests));
+}
+
+auto LockManager::AreCompatible(LockMode a, LockMode b) -> bool {
+  if (a == LockMode::EXCLUSIVE || b == LockMode::EXCLUSIVE) {
+    return false;
+  }
+  if (a == LockMode::INTENTION_SHARED || b == LockMode::INTENTION_SHARED) {
+    return true;
+  }
+  // Left are IX, S and SIX: only IX with IX and S with S get along.
+  return a == b && a != LockMode::SHARED_INTENTION_EXCLUSIVE;
+}
+
+auto LockManager::CombineModes(LockMode held, LockMode requested) -> LockMode {
+  if (held == requested) {
+    return held;
+  }
+  if (held == LockMode::EXCLUSIVE || requested == LockMode::EXCLUSIVE) {
+    return LockMode::EXCLUSIVE;
+  }
+  if (held == LockMode::INTENTION_SHARED) {
+    return requested;
+  }
+  if (requested == LockMode::INTENTION_SHARED) {
+    return held;
+  }
+  // Two different modes out of IX, S and SIX.
+  return LockMode::SHARED_INTENTION_EXCLUSIVE;
+}
+
+auto LockManager::GrantTable(const LockRequestQueue &queue, txn_id_t txn_id) -> bool {
+  auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                              [txn_id](const LockRequest &r) { return r.txn_id_ == txn_id; });
+  if (request == queue.request_queue_.end()) {
+    // Being killed, also jump out wait.
+    return true;
+  }
+  bool ahead = true;
+  for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end(); ++i) {
+    if (i == request) {
+      ahead = false;
+      continue;
+    }
+    if ((ahead || i->granted_) && !AreCompatible(i->lock_mode_, request->lock_mode_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto LockManager::LockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool {
+  std::unique_lock lk(table_latch_);
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && lock_mode != LockMode::EXCLUSIVE &&
+      lock_mode != LockMode::INTENTION_EXCLUSIVE) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  auto &queue = table_lock_table_[oid];
+  auto held = txn->GetTableLockSet()->find(oid);
+  auto mode = lock_mode;
+  if (held != txn->GetTableLockSet()->end()) {
+    mode = CombineModes(held->second, lock_mode);
+    if (mode == held->second) {
+      return true;
+    }
+    profiler_.RecordUpgrade();
+    // Upgrade in place, the request keeps its position in the queue.
+    for (auto &i : queue.request_queue_) {
+      if (i.txn_id_ == txn->GetTransactionId()) {
+        i.lock_mode_ = mode;
+        i.granted_ = false;
+        break;
+      }
+    }
+  } else {
+    queue.request_queue_.emplace_back(txn->GetTransactionId(), mode);
+  }
+  // Kill all younger conflicting request. Notify.
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    TransactionRegistry::Guard registry_guard(&TransactionManager::txn_registry);
+    for (auto i = queue.request_queue_.begin(); i != queue.request_queue_.end();) {
+      auto trans = TransactionManager::GetTransaction(i->txn_id_);
+      if (i->txn_id_ > txn->GetTransactionId() && !AreCompatible(i->lock_mode_, mode) && !IsFinishing(trans)) {
+        // The victim drops the table from its lock set when it unlocks it.
+        trans->SetState(TransactionState::ABORTED);
+        profiler_.RecordWound();
+        i = queue.request_queue_.erase(i);
+        continue;
+      }
+      ++i;
+    }
+  }
+  queue.cv_.notify_all();
+  // Wait for kill, or granted.
+  LockProfiler::WaitTimer timer{&profiler_};
+  while (txn->GetState() != TransactionState::ABORTED && !GrantTable(queue, txn->GetTransactionId())) {
+    timer.Start();
+    queue.cv_.wait(lk);
+  }
+  auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                              [txn](const LockRequest &r) { return r.txn_id_ == txn->GetTransactionId(); });
+  // Check for kill.
+  auto granted = txn->GetState() != TransactionState::ABORTED;
+  if (granted) {
+    request->granted_ = true;
+    (*txn->GetTableLockSet())[oid] = mode;
+  } else if (request != queue.request_queue_.end()) {
+    // Aborted elsewhere while waiting, take back the pending request so it does not hold up the queue.
+    if (held != txn->GetTableLockSet()->end()) {
+      request->lock_mode_ = held->second;
+      request->granted_ = true;
+    } else {
+      queue.request_queue_.erase(request);
+    }
+    queue.cv_.notify_all();
+  }
+  // The profiler has a latch of its own, keep it out of the table latch.
+  lk.unlock();
+  profiler_.RecordTableWait(mode, oid, timer);
+  return granted;
+}
+
+auto LockManager::UnlockTable(Transaction *txn, table_oid_t oid) -> bool {
+  std::unique_lock lk(table_latch_);
+  auto held = txn->GetTableLockSet()->find(oid);
+  if (held == txn->GetTableLockSet()->end()) {
+    return false;
+  }
+  auto mode = held->second;
+  txn->GetTableLockSet()->erase(held);
+  auto &queue = table_lock_table_[oid];
+  auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                              [txn](const LockRequest &r) { return r.txn_id_ == txn->GetTransactionId(); });
+  if (request == queue.request_queue_.end()) {
+    // A wounded transaction lost its request already.
+    if (txn->GetState() != TransactionState::ABORTED) {
+      txn->SetState(TransactionState::ABORTED);
+      LOG_INFO("Unlock fail");
+    }
+    return false;
+  }
+  if (txn->GetState() == TransactionState::GROWING &&
+      (mode == LockMode::EXCLUSIVE ||
+       (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ &&
+        (mode == LockMode::SHARED || mode == LockMode::SHARED_INTENTION_EXCLUSIVE)))) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+  queue.request_queue_.erase(request);
+  queue.cv_.notify_all();
+  return true;
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) { waits_for_[t1].emplace(t2); }
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  auto edges = waits_for_.find(t1);
+  if (edges == waits_for_.end()) {
+    return;
+  }
+  edges->second.erase(t2);
+  if (edges->second.empty()) {
+    waits_for_.erase(edges);
+  }
+}
+
+auto LockManager::FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::set<txn_id_t> *visited,
+                            txn_id_t *victim) -> bool {
+  auto on_path = std::find(path->begin(), path->end(), txn_id);
+  if (on_path != path->end()) {
+    // Back to a transaction on the path: everything from it onwards is a cycle.
+    *victim = *std::max_element(on_path, path->end());
+    return true;
+  }
+  if (!visited->emplace(txn_id).second) {
+    return false;
+  }
+  auto edges = waits_for_.find(txn_id);
+  if (edges == waits_for_.end()) {
+    return false;
+  }
+  path->push_back(txn_id);
+  for (auto next : edges->second) {
+    if (FindCycle(next, path, visited, victim)) {
+      return true;
+    }
+  }
+  path->pop_back();
+  return false;
+}
+
+auto LockManager::HasCycle(txn_id_t *txn_id) -> bool {
+  std::set<txn_id_t> visited;
+  for (const auto &[start, edges] : waits_for_) {
+    std::vector<txn_id_t> path;
+    if (FindCycle(start, &path, &visited, txn_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto LockManager::GetEdgeList() -> std::vector<std::pair<txn_id_t, txn_id_t>> {
+  std::vector<std::pair<txn_id_t, txn_id_t>> edges;
+  for (const auto &[from, to] : waits_for_) {
+    for (auto t : to) {
+      edges.emplace_back(from, t);
+    }
+  }
+  return edges;
+}
+
+void LockManager::AddQueueEdges(LockRequestQueue *queue, std::optional<RID> rid,
+                                std::unordered_map<txn_id_t, WaitSite> *waiting) {
+  bool table = !rid.has_value();
+  auto &requests = queue->request_queue_;
+  for (auto waiter = requests.begin(); waiter != requests.end(); ++waiter) {
+    if (IsFinishing(TransactionManager::GetTransaction(waiter->txn_id_))) {
+      continue;
+    }
+    bool granted = table ? GrantTable(*queue, waiter->txn_id_)
+                         : (waiter->lock_mode_ == LockMode::SHARED ? GrantS(*queue, waiter->txn_id_)
+                                                                    : GrantX(*queue, waiter->txn_id_));
+    if (granted) {
+      continue;
+    }
+    // Mirror the grant rules: a request waits for the conflicting requests ahead of it, and for table locks also for
+    // the conflicting granted ones behind it, i.e. upgrades.
+    bool ahead = true;
+    for (auto holder = requests.begin(); holder != requests.end(); ++holder) {
+      if (holder == waiter) {
+        ahead = false;
+        continue;
+      }
+      if (!ahead && !(table && holder->granted_)) {
+        continue;
+      }
+      bool conflict = table ? !AreCompatible(holder->lock_mode_, waiter->lock_mode_)
+                            : holder->lock_mode_ == LockMode::EXCLUSIVE || waiter->lock_mode_ == LockMode::EXCLUSIVE;
+      if (conflict && !IsFinishing(TransactionManager::GetTransaction(holder->txn_id_))) {
+        AddEdge(waiter->txn_id_, holder->txn_id_);
+      }
+    }
+    (*waiting)[waiter->txn_id_] = {queue, rid};
+  }
+}
+
+void LockManager::DetectDeadlocks() {
+  // Latch the whole lock table in a fixed order so that the graph is a consistent snapshot. Lock calls never hold the
+  // table latch and a partition latch at the same time, so this cannot deadlock with them.
+  std::vector<std::unique_lock<std::mutex>> guards;
+  guards.emplace_back(table_latch_);
+  for (auto &partition : partitions_) {
+    guards.emplace_back(partition->latch_);
+  }
+  TransactionRegistry::Guard registry_guard(&TransactionManager::txn_registry);
+  std::unordered_map<txn_id_t, WaitSite> waiting;
+  for (auto &[oid, queue] : table_lock_table_) {
+    AddQueueEdges(&queue, std::nullopt, &waiting);
+  }
+  for (auto &partition : partitions_) {
+    for (auto &[rid, queue] : partition->lock_table_) {
+      AddQueueEdges(&queue, rid, &waiting);
+    }
+  }
+  txn_id_t victim = INVALID_TXN_ID;
+  while (HasCycle(&victim)) {
+    // Only transactions found running are in the graph, and the registry guard keeps them from being freed.
+    TransactionManager::GetTransaction(victim)->SetState(TransactionState::ABORTED);
+    profiler_.RecordDeadlockVictim();
+    // A victim is always waiting somewhere, only a waiter has outgoing edges.
+    auto &site = waiting.at(victim);
+    if (site.rid_.has_value()) {
+      // Same as a wounded transaction, the record lock it waits for is taken from it.
+      auto &requests = site.queue_->request_queue_;
+      auto size = requests.size();
+      requests.remove_if([victim](const LockRequest &r) { return r.txn_id_ == victim; });
+      CountRequests(*site.rid_, static_cast<int64_t>(requests.size()) - static_cast<int64_t>(size));
+    }
+    site.queue_->cv_.notify_all();
+    waits_for_.erase(victim);
+    for (auto &[from, to] : waits_for_) {
+      to.erase(victim);
+    }
+  }
+  waits_for_.clear();
+}
+
+void LockManager::RunCycleDetection() {
+  std::unique_lock lk(detection_latch_);
+  while (enable_cycle_detection_) {
+    detection_cv_.wait_for(lk, cycle_detection_interval);
+    if (!enable_cycle_detection_) {
+      break;
+    }
+    lk.unlock();
+    DetectDeadlocks();
+    lk.lock();
+  }
+}
+
 }  // namespace bustub
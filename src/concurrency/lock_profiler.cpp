@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_profiler.cpp
+//
+// Identification: src/concurrency/lock_profiler.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/lock_profiler.h"
+
+#include <sstream>
+
+namespace bustub {
+
+void LockProfiler::RecordWait(LockMode lock_mode, const RID &rid, const WaitTimer &timer) {
+  if (!timer.Started()) {
+    return;
+  }
+  waiting_.fetch_sub(1, std::memory_order_relaxed);
+  AddWait(lock_mode, timer.Elapsed());
+  hot_records_.Add(rid);
+}
+
+void LockProfiler::RecordTableWait(LockMode lock_mode, table_oid_t oid, const WaitTimer &timer) {
+  if (!timer.Started()) {
+    return;
+  }
+  waiting_.fetch_sub(1, std::memory_order_relaxed);
+  AddWait(lock_mode, timer.Elapsed());
+  hot_tables_.Add(oid);
+}
+
+auto LockProfiler::GetWaitHistogram(LockMode lock_mode) const -> WaitHistogram {
+  WaitHistogram histogram;
+  const auto &waits = waits_[static_cast<size_t>(lock_mode)];
+  for (size_t i = 0; i < WAIT_BUCKETS; i++) {
+    histogram[i] = waits[i].load(std::memory_order_relaxed);
+  }
+  return histogram;
+}
+
+void LockProfiler::Reset() {
+  for (auto &waits : waits_) {
+    for (auto &count : waits) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+  wounds_.store(0, std::memory_order_relaxed);
+  deadlock_victims_.store(0, std::memory_order_relaxed);
+  upgrades_.store(0, std::memory_order_relaxed);
+  escalations_.store(0, std::memory_order_relaxed);
+  hot_records_.Clear();
+  hot_tables_.Clear();
+}
+
+auto LockProfiler::ToString() -> std::string {
+  static const char *mode_names[NUM_LOCK_MODES] = {"SHARED", "EXCLUSIVE", "INTENTION_SHARED", "INTENTION_EXCLUSIVE",
+                                                   "SHARED_INTENTION_EXCLUSIVE"};
+  std::stringstream os;
+  os << "lock waits in us, per bucket upper bound:\n";
+  for (size_t mode = 0; mode < NUM_LOCK_MODES; mode++) {
+    auto histogram = GetWaitHistogram(static_cast<LockMode>(mode));
+    uint64_t total = 0;
+    for (auto count : histogram) {
+      total += count;
+    }
+    if (total == 0) {
+      continue;
+    }
+    os << "  " << mode_names[mode] << ": " << total << " waits";
+    for (size_t i = 0; i < WAIT_BUCKETS; i++) {
+      if (histogram[i] == 0) {
+        continue;
+      }
+      if (i + 1 < WAIT_BUCKETS) {
+        os << ", <" << (1UL << i) << ": " << histogram[i];
+      } else {
+        os << ", >=" << (1UL << (i - 1)) << ": " << histogram[i];
+      }
+    }
+    os << "\n";
+  }
+  os << "wounds: " << GetWounds() << ", deadlock victims: " << GetDeadlockVictims() << ", upgrades: " << GetUpgrades()
+     << ", escalations: " << GetEscalations() << "\n";
+  os << "hot records:\n";
+  for (const auto &hot : GetHotRecords()) {
+    os << "  " << hot.key_.ToString() << ": " << hot.count_ << " waits (at most " << hot.error_ << " too many)\n";
+  }
+  os << "hot tables:\n";
+  for (const auto &hot : GetHotTables()) {
+    os << "  table " << hot.key_ << ": " << hot.count_ << " waits (at most " << hot.error_ << " too many)\n";
+  }
+  return os.str();
+}
+
+auto LockProfiler::Bucket(std::chrono::microseconds wait) -> size_t {
+  size_t bucket = 0;
+  // The smallest power of two above the wait, the last bucket takes all the longer waits.
+  while (bucket + 1 < WAIT_BUCKETS && wait.count() >= (1L << bucket)) {
+    bucket++;
+  }
+  return bucket;
+}
+
+void LockProfiler::AddWait(LockMode lock_mode, std::chrono::microseconds wait) {
+  waits_[static_cast<size_t>(lock_mode)][Bucket(wait)].fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace bustub
@@ -12,102 +12,354 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "catalog/catalog.h"
+#include "common/exception.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
+TransactionRegistry TransactionManager::txn_registry;
+
+/** Finished read-only transactions of the current thread, for the next ones to reuse. */
+thread_local std::vector<std::unique_ptr<Transaction>> read_only_pool;
+
+/** Finished transactions handed back to the current thread by Recycle, for the next Begin to reuse. */
+thread_local std::vector<std::unique_ptr<Transaction>> txn_pool;
 
 auto TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) -> Transaction * {
+  auto level = txn == nullptr ? isolation_level : txn->GetIsolationLevel();
+  if (level == IsolationLevel::SNAPSHOT_ISOLATION && !enable_mvcc) {
+    throw Exception("snapshot isolation needs enable_mvcc");
+  }
+  if (level == IsolationLevel::OPTIMISTIC && !enable_occ) {
+    throw Exception("optimistic transactions need enable_occ");
+  }
   // Acquire the global transaction latch in shared mode.
   global_txn_latch_.RLock();
 
-  if (txn == nullptr) {
+  if (txn == nullptr && txn_pool.empty()) {
     txn = new Transaction(next_txn_id_++, isolation_level);
+  } else if (txn == nullptr) {
+    txn = txn_pool.back().release();
+    txn_pool.pop_back();
+    txn->Recycle(next_txn_id_++, isolation_level);
+  }
+  txn_registry.Register(txn);
+
+  {
+    // Taken under the latch, so the watermark never passes a snapshot about to be registered.
+    std::scoped_lock active_txns_guard(active_txns_latch_);
+    // Logged under the latch too: a checkpoint either finds the transaction with its BEGIN lsn, or takes its snapshot
+    // before the BEGIN record and starts the next recovery no later than it.
+    if (enable_logging && log_manager_ != nullptr) {
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+      txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+      txn->SetBeginLSN(txn->GetPrevLSN());
+    }
+    txn->SetReadTs(last_commit_ts_);
+    active_txns_[txn->GetTransactionId()] = txn;
+  }
+  return txn;
+}
+
+auto TransactionManager::BeginReadOnly() -> Transaction * {
+  if (!enable_mvcc) {
+    throw Exception("read-only transactions need enable_mvcc");
+  }
+  Transaction *txn;
+  if (read_only_pool.empty()) {
+    txn = new Transaction(next_txn_id_++, Transaction::ReadOnly{});
+  } else {
+    txn = read_only_pool.back().release();
+    read_only_pool.pop_back();
+    txn->Recycle(next_txn_id_++, IsolationLevel::SNAPSHOT_ISOLATION);
   }
-  txn_map_mutex.lock();
-  txn_map[txn->GetTransactionId()] = txn;
-  txn_map_mutex.unlock();
+  // Nothing to log and no lock to take, only the watermark has to know about the snapshot.
+  std::scoped_lock active_txns_guard(active_txns_latch_);
+  txn->SetReadTs(last_commit_ts_);
+  read_only_snapshots_[txn->GetReadTs()]++;
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
+void TransactionManager::FinishReadOnly(Transaction *txn, TransactionState state) {
+  txn->SetState(state);
+  {
+    std::scoped_lock active_txns_guard(active_txns_latch_);
+    read_only_snapshots_[txn->GetReadTs()]--;
+  }
+  if (read_only_pool.size() < READ_ONLY_TXN_POOL_SIZE) {
+    read_only_pool.emplace_back(txn);
+  } else {
+    delete txn;
+  }
+}
+
+void TransactionManager::Recycle(Transaction *txn) {
+  BUSTUB_ASSERT(!txn->IsReadOnly(), "Read-only transactions go back to their pool when they finish.");
+  BUSTUB_ASSERT(txn->GetState() == TransactionState::COMMITTED || txn->GetState() == TransactionState::ABORTED,
+                "Only finished transactions can be recycled.");
+  if (txn_pool.size() < TXN_POOL_SIZE) {
+    txn_pool.emplace_back(txn);
+  } else {
+    delete txn;
+  }
+}
+
+auto TransactionManager::ValidateAndInstall(Transaction *txn) -> bool {
+  auto buffered = txn->GetBufferedWriteSet();
+  std::vector<RID> rids;
+  for (const auto &[rid, write] : *buffered) {
+    rids.push_back(rid);
+  }
+  // Lock in a fixed order, so that committers do not wound each other for nothing.
+  std::sort(rids.begin(), rids.end(), [](const RID &a, const RID &b) { return a.Get() < b.Get(); });
+  for (const auto &rid : rids) {
+    if (!txn->IsExclusiveLocked(rid) && !lock_manager_->LockExclusive(txn, rid)) {
+      return false;
+    }
+  }
+  // No lock is taken from now on, and the table heap applies the writes instead of buffering them.
+  txn->SetState(TransactionState::SHRINKING);
+  for (const auto &read : *txn->GetReadSet()) {
+    if (!read.table_->GetTupleVersions()->Validate(read.rid_, txn, read.version_)) {
+      return false;
+    }
+  }
+  for (const auto &rid : rids) {
+    const auto &write = buffered->at(rid);
+    bool applied = write.wtype_ == WType::DELETE ? write.table_->MarkDelete(rid, txn)
+                                                 : write.table_->UpdateTuple(write.tuple_, rid, txn);
+    // Wounded while applying: the locks are gone, stop here.
+    if (!applied || txn->GetState() == TransactionState::ABORTED) {
+      return false;
+    }
+  }
+  buffered->clear();
+  txn->GetReadSet()->clear();
+  return true;
+}
+
+auto TransactionManager::Commit(Transaction *txn) -> bool {
+  if (txn->IsReadOnly()) {
+    FinishReadOnly(txn, TransactionState::COMMITTED);
+    return true;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && !ValidateAndInstall(txn)) {
+    Abort(txn);
+    return false;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
-  // Perform all deletes before we commit.
   auto write_set = txn->GetWriteSet();
-  while (!write_set->empty()) {
-    auto &item = write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+  std::vector<std::pair<TableHeap *, RID>> changed;
+  if (enable_occ) {
+    for (const auto &item : *write_set) {
+      changed.emplace_back(item.table_, item.rid_);
+    }
+  }
+  std::unordered_set<TableHeap *> written_tables;
+  if ((enable_mvcc || enable_occ) && !write_set->empty()) {
+    std::scoped_lock commit_guard(commit_latch_);
+    txn->SetCommitTs(last_commit_ts_ + 1);
+    for (const auto &item : *write_set) {
+      if (enable_mvcc) {
+        item.table_->GetVersionStore()->Commit(item.rid_, txn, txn->GetCommitTs());
+      }
+      written_tables.emplace(item.table_);
     }
-    write_set->pop_back();
+    last_commit_ts_ = txn->GetCommitTs();
+  }
+
+  // Perform all deletes before we commit, one page at a time.
+  std::map<std::pair<TableHeap *, page_id_t>, std::vector<RID>> deletes;
+  for (auto item = write_set->rbegin(); item != write_set->rend(); ++item) {
+    if (item->wtype_ == WType::DELETE) {
+      deletes[{item->table_, item->rid_.GetPageId()}].push_back(item->rid_);
+    }
+  }
+  for (const auto &[page, rids] : deletes) {
+    // Note that this also releases the locks when holding the page latch.
+    page.first->ApplyDeletes(page.second, rids, txn);
   }
   write_set->clear();
+  for (const auto &[table, rid] : changed) {
+    table->GetTupleVersions()->Release(rid, txn, txn->GetCommitTs());
+  }
 
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+    if (txn->IsAsyncCommit()) {
+      // The locks are released right away, the flush thread writes the commit record within the bound.
+      log_manager_->RequestPersistent(txn->GetPrevLSN(), async_commit_delay);
+    } else {
+      // The commit is only acknowledged once its record is durable; concurrent committers share the same flush.
+      log_manager_->WaitUntilPersistent(txn->GetPrevLSN());
+    }
+  }
+
+  {
+    std::scoped_lock active_txns_guard(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
+  // Drop the versions no snapshot needs any more, and the ones no optimistic transaction can validate against.
+  if (enable_mvcc && !written_tables.empty()) {
+    auto watermark = GetWatermark();
+    for (auto *table : written_tables) {
+      table->GetVersionStore()->Collect(watermark);
+    }
+  }
+  if (enable_occ && !written_tables.empty()) {
+    auto watermark = GetOptimisticWatermark();
+    for (auto *table : written_tables) {
+      table->GetTupleVersions()->Collect(watermark);
+    }
+  }
   // Release all the locks.
   ReleaseLocks(txn);
+  // Nobody looks for the transaction without a lock of it, the caller may free it once this returns.
+  txn_registry.Unregister(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
+  return true;
 }
 
 void TransactionManager::Abort(Transaction *txn) {
+  if (txn->IsReadOnly()) {
+    FinishReadOnly(txn, TransactionState::ABORTED);
+    return;
+  }
   txn->SetState(TransactionState::ABORTED);
   // Rollback before releasing the lock.
   auto table_write_set = txn->GetWriteSet();
-  while (!table_write_set->empty()) {
-    auto &item = table_write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      table->RollbackDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
-    }
-    table_write_set->pop_back();
+  std::vector<std::pair<TableHeap *, RID>> versioned;
+  if (enable_mvcc || enable_occ) {
+    for (const auto &item : *table_write_set) {
+      versioned.emplace_back(item.table_, item.rid_);
+    }
+  }
+  // Buffered writes were never applied.
+  txn->GetBufferedWriteSet()->clear();
+  txn->GetReadSet()->clear();
+  // The writes to different pages are independent, so each page is rolled back on its own, newest write first.
+  std::map<std::pair<TableHeap *, page_id_t>, std::vector<const TableWriteRecord *>> page_writes;
+  for (auto item = table_write_set->rbegin(); item != table_write_set->rend(); ++item) {
+    page_writes[{item->table_, item->rid_.GetPageId()}].push_back(&*item);
+  }
+  for (const auto &[page, records] : page_writes) {
+    // Note that this also releases the locks of rolled back inserts when holding the page latch.
+    page.first->RollbackWrites(page.second, records, txn);
   }
   table_write_set->clear();
-  // Rollback index updates
+  // The saved versions are current again only once the heap is completely rolled back.
+  for (const auto &[table, rid] : versioned) {
+    if (enable_mvcc) {
+      table->GetVersionStore()->Rollback(rid, txn);
+    }
+    if (enable_occ) {
+      table->GetTupleVersions()->Release(rid, txn, last_commit_ts_);
+    }
+  }
+  // Rollback index updates, looking each index up once.
   auto index_write_set = txn->GetIndexWriteSet();
-  while (!index_write_set->empty()) {
-    auto &item = index_write_set->back();
-    auto catalog = item.catalog_;
+  std::map<std::pair<Catalog *, index_oid_t>, std::vector<IndexWriteRecord *>> index_writes;
+  for (auto item = index_write_set->rbegin(); item != index_write_set->rend(); ++item) {
+    index_writes[{item->catalog_, item->index_oid_}].push_back(&*item);
+  }
+  for (const auto &[index, records] : index_writes) {
+    auto [catalog, index_oid] = index;
     // Metadata identifying the table that should be deleted from.
-    TableInfo *table_info = catalog->GetTable(item.table_oid_);
-    IndexInfo *index_info = catalog->GetIndex(item.index_oid_);
-    auto new_key = item.tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
-                                            index_info->index_->GetKeyAttrs());
-    if (item.wtype_ == WType::DELETE) {
-      index_info->index_->InsertEntry(new_key, item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      index_info->index_->DeleteEntry(new_key, item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      // Delete the new key and insert the old key
-      index_info->index_->DeleteEntry(new_key, item.rid_, txn);
-      auto old_key = item.old_tuple_.KeyFromTuple(table_info->schema_, *(index_info->index_->GetKeySchema()),
-                                                  index_info->index_->GetKeyAttrs());
-      index_info->index_->InsertEntry(old_key, item.rid_, txn);
-    }
-    index_write_set->pop_back();
+    TableInfo *table_info = catalog->GetTable(records.front()->table_oid_);
+    IndexInfo *index_info = catalog->GetIndex(index_oid);
+    const auto &key_schema = *index_info->index_->GetKeySchema();
+    const auto &key_attrs = index_info->index_->GetKeyAttrs();
+    for (auto *item : records) {
+      auto new_key = item->tuple_.KeyFromTuple(table_info->schema_, key_schema, key_attrs);
+      if (item->wtype_ == WType::DELETE) {
+        index_info->index_->InsertEntry(new_key, item->rid_, txn);
+      } else if (item->wtype_ == WType::INSERT) {
+        index_info->index_->DeleteEntry(new_key, item->rid_, txn);
+      } else if (item->wtype_ == WType::UPDATE) {
+        // Delete the new key and insert the old key
+        index_info->index_->DeleteEntry(new_key, item->rid_, txn);
+        auto old_key = item->old_tuple_.KeyFromTuple(table_info->schema_, key_schema, key_attrs);
+        index_info->index_->InsertEntry(old_key, item->rid_, txn);
+      }
+    }
   }
   table_write_set->clear();
   index_write_set->clear();
 
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    txn->SetPrevLSN(log_manager_->AppendLogRecord(&log_record));
+  }
+
+  {
+    std::scoped_lock active_txns_guard(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
   // Release all the locks.
   ReleaseLocks(txn);
+  // Nobody looks for the transaction without a lock of it, the caller may free it once this returns.
+  txn_registry.Unregister(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+auto TransactionManager::GetActiveTransactionTable(lsn_t *oldest_begin_lsn) -> std::vector<std::pair<txn_id_t, lsn_t>> {
+  std::scoped_lock active_txns_guard(active_txns_latch_);
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  *oldest_begin_lsn = INVALID_LSN;
+  for (const auto &[txn_id, txn] : active_txns_) {
+    // The transaction is still writing, so the lsns are a snapshot that may be outdated by the time it is logged.
+    lsn_t begin_lsn = txn->GetBeginLSN();
+    if (begin_lsn == INVALID_LSN) {
+      continue;
+    }
+    active_txns.emplace_back(txn_id, txn->GetPrevLSN());
+    if (*oldest_begin_lsn == INVALID_LSN || begin_lsn < *oldest_begin_lsn) {
+      *oldest_begin_lsn = begin_lsn;
+    }
+  }
+  return active_txns;
+}
+
+auto TransactionManager::GetWatermark() -> timestamp_t {
+  std::scoped_lock active_txns_guard(active_txns_latch_);
+  timestamp_t watermark = last_commit_ts_;
+  for (const auto &[txn_id, txn] : active_txns_) {
+    watermark = std::min(watermark, txn->GetReadTs());
+  }
+  // Drop the finished snapshots older than every running one.
+  while (!read_only_snapshots_.empty() && read_only_snapshots_.begin()->second == 0) {
+    read_only_snapshots_.erase(read_only_snapshots_.begin());
+  }
+  if (!read_only_snapshots_.empty()) {
+    watermark = std::min(watermark, read_only_snapshots_.begin()->first);
+  }
+  return watermark;
+}
+
+auto TransactionManager::GetOptimisticWatermark() -> timestamp_t {
+  std::scoped_lock active_txns_guard(active_txns_latch_);
+  timestamp_t watermark = last_commit_ts_;
+  for (const auto &[txn_id, txn] : active_txns_) {
+    if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+      watermark = std::min(watermark, txn->GetReadTs());
+    }
+  }
+  return watermark;
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
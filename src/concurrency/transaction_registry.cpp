@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <functional>
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+void TransactionRegistry::Register(Transaction *txn) {
+  auto &shard = GetShard(txn->GetTransactionId());
+  std::scoped_lock guard(shard.latch_);
+  shard.txns_[txn->GetTransactionId()] = txn;
+}
+
+void TransactionRegistry::Unregister(Transaction *txn) {
+  {
+    auto &shard = GetShard(txn->GetTransactionId());
+    std::scoped_lock guard(shard.latch_);
+    auto it = shard.txns_.find(txn->GetTransactionId());
+    if (it == shard.txns_.end() || it->second != txn) {
+      return;
+    }
+    shard.txns_.erase(it);
+  }
+  // A guard entering from now on cannot find txn, only the ones already inside may hold it.
+  auto epoch = epoch_.fetch_add(1) + 1;
+  for (auto &slot : slots_) {
+    auto entered = slot.epoch_.load();
+    while (entered != 0 && entered < epoch) {
+      std::this_thread::yield();
+      entered = slot.epoch_.load();
+    }
+  }
+}
+
+auto TransactionRegistry::Find(txn_id_t txn_id) -> Transaction * {
+  auto &shard = GetShard(txn_id);
+  std::scoped_lock guard(shard.latch_);
+  auto it = shard.txns_.find(txn_id);
+  return it == shard.txns_.end() ? nullptr : it->second;
+}
+
+auto TransactionRegistry::Size() -> size_t {
+  size_t size = 0;
+  for (auto &shard : shards_) {
+    std::scoped_lock guard(shard.latch_);
+    size += shard.txns_.size();
+  }
+  return size;
+}
+
+auto TransactionRegistry::Enter() -> size_t {
+  // Start looking at a slot of its own, so that threads rarely compete for one.
+  auto slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % TXN_REGISTRY_GUARDS;
+  while (true) {
+    uint64_t free = 0;
+    if (slots_[slot].epoch_.compare_exchange_strong(free, epoch_.load())) {
+      return slot;
+    }
+    slot = (slot + 1) % TXN_REGISTRY_GUARDS;
+    if (slot == 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+}  // namespace bustub
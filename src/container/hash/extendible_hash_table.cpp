@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -23,20 +24,31 @@ namespace bustub {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
-                                     const KeyComparator &comparator, HashFunction<KeyType> hash_fn)
-    : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
+                                     const KeyComparator &comparator, HashFunction<KeyType> hash_fn,
+                                     LogManager *log_manager, page_id_t directory_page_id)
+    : directory_page_id_(directory_page_id),
+      buffer_pool_manager_(buffer_pool_manager),
+      comparator_(comparator),
+      hash_fn_(std::move(hash_fn)),
+      log_manager_(log_manager) {
+  // Open an existing hash table, everything about it is kept in its pages.
+  if (directory_page_id_ != INVALID_PAGE_ID) {
+    return;
+  }
   // allocate a page for directory.
   table_latch_.WLock();
   Page *dp = buffer_pool_manager->NewPage(&directory_page_id_);
   auto rdp = reinterpret_cast<HashTableDirectoryPage *>(dp);
+  PageImages images;
+  SaveImage(dp, &images);
   reinterpret_cast<Page *>(rdp)->WLatch();
   rdp->SetPageId(directory_page_id_);
   // Global Depth equals 0.
   page_id_t targetpage;
   buffer_pool_manager_->NewPage(&targetpage);
   buffer_pool_manager_->UnpinPage(targetpage, false);
-  reftopage_[0] = targetpage;
-  rdp->SetBucketPageId(0, 0);
+  rdp->SetBucketPageId(0, targetpage);
+  LogChanges(images);
   reinterpret_cast<Page *>(rdp)->WUnlatch();
   table_latch_.WUnlock();
   buffer_pool_manager_->UnpinPage(directory_page_id_, true);
@@ -64,7 +76,7 @@ inline auto HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectory
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 inline auto HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page) -> uint32_t {
-  return reftopage_[dir_page->GetBucketPageId(KeyToDirectoryIndex(key, dir_page))];
+  return dir_page->GetBucketPageId(KeyToDirectoryIndex(key, dir_page));
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -77,6 +89,63 @@ auto HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id) -> HASH_TABLE_BU
   return reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(buffer_pool_manager_->FetchPage(bucket_page_id));
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::SaveImage(Page *page, PageImages *images) {
+  if (enable_logging && log_manager_ != nullptr) {
+    images->emplace_back(page, std::vector<char>(page->GetData(), page->GetData() + PAGE_SIZE));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::MakeDeltas(const PageImages &images) -> std::vector<PageDelta> {
+  std::vector<PageDelta> deltas;
+  for (const auto &[page, image] : images) {
+    PageDelta delta = LogRecord::MakePageDelta(page->GetPageId(), image.data(), page->GetData());
+    if (!delta.ranges_.empty()) {
+      deltas.emplace_back(std::move(delta));
+    }
+  }
+  return deltas;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::LogChanges(const PageImages &images) {
+  std::vector<PageDelta> deltas = MakeDeltas(images);
+  if (deltas.empty()) {
+    return;
+  }
+  LogRecord log_record(std::move(deltas));
+  lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+  for (const auto &[page, image] : images) {
+    page->SetDeltaLSN(lsn);
+  }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::LogEntryChange(const PageImages &images, Transaction *transaction, LogRecordType log_record_type,
+                                     const KeyType &key, const ValueType &value) {
+  if constexpr (std::is_same_v<ValueType, RID>) {
+    if (transaction != nullptr) {
+      std::vector<PageDelta> deltas = MakeDeltas(images);
+      // A failed insert or remove changes nothing, there is nothing to undo.
+      if (deltas.empty()) {
+        return;
+      }
+      const auto *key_data = reinterpret_cast<const char *>(&key);
+      LogRecord log_record(transaction->GetTransactionId(), transaction->GetPrevLSN(), log_record_type,
+                           directory_page_id_, std::vector<char>(key_data, key_data + sizeof(KeyType)), value,
+                           std::move(deltas));
+      lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+      transaction->SetPrevLSN(lsn);
+      for (const auto &[page, image] : images) {
+        page->SetDeltaLSN(lsn);
+      }
+      return;
+    }
+  }
+  LogChanges(images);
+}
+
 /*****************************************************************************
  * SEARCH
  *****************************************************************************/
@@ -110,7 +179,10 @@ auto HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const
   HASH_TABLE_BUCKET_TYPE *orip = FetchBucketPage(targetpage);
   Page *pop = reinterpret_cast<Page *>(orip);
   pop->WLatch();
+  PageImages images;
+  SaveImage(pop, &images);
   int sign = orip->Insert(key, value, comparator_);
+  LogEntryChange(images, transaction, LogRecordType::INDEX_INSERT, key, value);
   pop->WUnlatch();
   if (sign == 1) {
     // Succeeded.
@@ -125,7 +197,7 @@ auto HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const
     table_latch_.RUnlock();
     buffer_pool_manager_->UnpinPage(directory_page_id_, false);
     buffer_pool_manager_->UnpinPage(targetpage, false);
-    return SplitInsert(nullptr, key, value);
+    return SplitInsert(transaction, key, value);
   }
   // Duplicate kv pair. or reach maximum depth.
   pdp->RUnlatch();
@@ -148,6 +220,11 @@ auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
   // Acquire talbe write lock.
   auto orip = FetchBucketPage(targetpage);
   auto imap = reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(buffer_pool_manager_->NewPage(&newpage));
+  // The directory, the bucket and its split image change together.
+  PageImages images;
+  SaveImage(reinterpret_cast<Page *>(dp), &images);
+  SaveImage(reinterpret_cast<Page *>(orip), &images);
+  SaveImage(reinterpret_cast<Page *>(imap), &images);
   if (thisld < gd) {
     // Get image index.
     bool highbit = static_cast<bool>(dp->GetLocalHighBit(dindex));
@@ -156,28 +233,22 @@ auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
     } else {
       iindex = dindex | (0x1 << thisld);
     }
-    // Increment local depth of two index, update page in refpage.
+    // Increment local depth of two index, the image index gets the new page.
     uint32_t premask = dp->GetLocalDepthMask(dindex);
-    page_id_t preref = dp->GetBucketPageId(dindex);
+    page_id_t preref = dindex & premask;
     dp->IncrLocalDepth(dindex);
     dp->IncrLocalDepth(iindex);
     uint32_t newmask = dp->GetLocalDepthMask(dindex);
     page_id_t dref = dindex & newmask;
     page_id_t iref = iindex & newmask;
-    reftopage_[dref] = reftopage_[preref];
-    if (preref != dref) {
-      reftopage_.erase(preref);
-    }
-    dp->SetBucketPageId(dindex, dref);
-    // Register new page in refpage for image index.
-    reftopage_[iref] = newpage;
-    dp->SetBucketPageId(iindex, iref);
+    dp->SetBucketPageId(iindex, newpage);
     // Move certain k-v to image page.
     for (uint32_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
       if (!orip->IsOccupied(i)) {
         break;
       }
-      if (static_cast<page_id_t>(Hash(orip->KeyAt(i)) & newmask) != dref) {
+      // Skip the slots emptied by earlier removals and splits, they must not come back in the image.
+      if (orip->IsReadable(i) && static_cast<page_id_t>(Hash(orip->KeyAt(i)) & newmask) != dref) {
         orip->RemoveAt(i);
         imap->Insert(orip->KeyAt(i), orip->ValueAt(i), comparator_);
       }
@@ -187,9 +258,9 @@ auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
       if (static_cast<page_id_t>(idx & premask) == preref) {
         dp->SetLocalDepth(idx, thisld + 1);
         if (static_cast<page_id_t>(idx & newmask) == iref) {
-          dp->SetBucketPageId(idx, iref);
+          dp->SetBucketPageId(idx, newpage);
         } else {
-          dp->SetBucketPageId(idx, dref);
+          dp->SetBucketPageId(idx, targetpage);
         }
       }
     }
@@ -208,35 +279,27 @@ auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
     iindex = dindex | (0x1 << thisld);
     dp->IncrLocalDepth(dindex);
     dp->IncrLocalDepth(iindex);
-    // Set new  bucketpageid.
+    // The image index gets the new page.
     uint32_t newmask = dp->GetLocalDepthMask(dindex);
     page_id_t dref = dindex & newmask;
-    page_id_t iref = iindex & newmask;
-    page_id_t preref = dp->GetBucketPageId(dindex);
-    reftopage_[dref] = reftopage_[preref];
-    if (dref != preref) {
-      reftopage_.erase(preref);
-    }
-    dp->SetBucketPageId(dindex, dref);
-    // Register new page for iindex.
-    reftopage_[iref] = newpage;
-    dp->SetBucketPageId(iindex, iref);
+    dp->SetBucketPageId(iindex, newpage);
     // Move certain k-v to image page.
     for (uint32_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
       if (!orip->IsOccupied(i)) {
         break;
       }
-      if ((Hash(orip->KeyAt(i)) & newmask) != static_cast<uint32_t>(dref)) {
+      if (orip->IsReadable(i) && (Hash(orip->KeyAt(i)) & newmask) != static_cast<uint32_t>(dref)) {
         orip->RemoveAt(i);
         imap->Insert(orip->KeyAt(i), orip->ValueAt(i), comparator_);
       }
     }
   }
+  LogChanges(images);
   table_latch_.WUnlock();
   buffer_pool_manager_->UnpinPage(directory_page_id_, true);
   buffer_pool_manager_->UnpinPage(newpage, true);
   buffer_pool_manager_->UnpinPage(targetpage, true);
-  return Insert(nullptr, key, value);
+  return Insert(transaction, key, value);
 }
 
 /*****************************************************************************
@@ -252,13 +315,17 @@ auto HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
   HASH_TABLE_BUCKET_TYPE *p = FetchBucketPage(targetpage);
   Page *pop = reinterpret_cast<Page *>(p);
   pop->WLatch();
-  if (p->Remove(key, value, comparator_)) {
+  PageImages images;
+  SaveImage(pop, &images);
+  bool removed = p->Remove(key, value, comparator_);
+  LogEntryChange(images, transaction, LogRecordType::INDEX_DELETE, key, value);
+  if (removed) {
     // Remove successfully and  merge when necessary.
     pop->WUnlatch();
     pdp->RUnlatch();
     table_latch_.RUnlock();
     buffer_pool_manager_->UnpinPage(directory_page_id_, false);
-    buffer_pool_manager_->UnpinPage(targetpage, false);
+    buffer_pool_manager_->UnpinPage(targetpage, true);
     Merge(nullptr, key, value);
     return true;
   }
@@ -300,20 +367,15 @@ void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key, const
     iindex = dindex | (0x1 << (tld - 1));
   }
   if (tld > 0 && p->IsEmpty() && dp->GetLocalDepth(iindex) == tld) {
-    // Should merge.
+    // Should merge, the empty bucket is dropped in favor of its image.
+    PageImages images;
+    SaveImage(reinterpret_cast<Page *>(dp), &images);
     dp->DecrLocalDepth(dindex);
     dp->DecrLocalDepth(iindex);
     uint32_t lowmask = dp->GetLocalDepthMask(dindex);
     page_id_t lowpageref = dindex & lowmask;
-    page_id_t predref = dp->GetBucketPageId(dindex);
-    page_id_t preiref = dp->GetBucketPageId(iindex);
-    reftopage_.erase(predref);
-    dp->SetBucketPageId(dindex, lowpageref);
-    dp->SetBucketPageId(iindex, lowpageref);
-    reftopage_[lowpageref] = reftopage_[preiref];
-    if (preiref != lowpageref) {
-      reftopage_.erase(preiref);
-    }
+    page_id_t imagepage = dp->GetBucketPageId(iindex);
+    dp->SetBucketPageId(dindex, imagepage);
     // Cast changes to all have the same lowpageref.
     // Check if can shrink. If all local depth is smaller than global depth, then shrink.
     bool shrink = true;
@@ -323,13 +385,14 @@ void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key, const
         shrink = false;
       }
       if (static_cast<page_id_t>(i & lowmask) == lowpageref) {
-        dp->SetBucketPageId(i, lowpageref);
+        dp->SetBucketPageId(i, imagepage);
         dp->SetLocalDepth(i, tld - 1);
       }
     }
     if (shrink) {
       dp->DecrGlobalDepth();
     }
+    LogChanges(images);
   }
   table_latch_.WUnlock();
   buffer_pool_manager_->UnpinPage(directory_page_id_, true);
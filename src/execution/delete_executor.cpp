@@ -12,6 +12,7 @@
 
 #include <memory>
 
+#include "common/exception.h"
 #include "execution/executors/delete_executor.h"
 
 namespace bustub {
@@ -21,32 +22,58 @@ DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *
     : AbstractExecutor(exec_ctx), plan_(plan), child_executor_(std::move(child_executor)) {}
 
 void DeleteExecutor::Init() {
+  if (GetExecutorContext()->GetTransaction()->IsReadOnly()) {
+    throw Exception("read-only transactions cannot delete");
+  }
   table_info_ = GetExecutorContext()->GetCatalog()->GetTable(plan_->TableOid());
   indexes_ = GetExecutorContext()->GetCatalog()->GetTableIndexes(table_info_->name_);
   child_executor_->Init();
+  auto txn = GetExecutorContext()->GetTransaction();
+  auto reason = txn->GetState() == TransactionState::SHRINKING ? AbortReason::LOCK_ON_SHRINKING : AbortReason::DEADLOCK;
+  if (!GetExecutorContext()->GetLockManager()->LockTable(txn, LockMode::INTENTION_EXCLUSIVE, table_info_->oid_)) {
+    throw TransactionAbortException(txn->GetTransactionId(), reason);
+  }
 }
 
 auto DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   while (child_executor_->Next(tuple, rid)) {
-    if (GetExecutorContext()->GetTransaction()->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ &&
-        GetExecutorContext()->GetTransaction()->IsSharedLocked(*rid)) {
-      if (!GetExecutorContext()->GetLockManager()->LockUpgrade(GetExecutorContext()->GetTransaction(), *rid)) {
+    // An optimistic transaction locks what it writes only when it commits.
+    auto level = GetExecutorContext()->GetTransaction()->GetIsolationLevel();
+    if (level == IsolationLevel::REPEATABLE_READ && GetExecutorContext()->GetTransaction()->IsSharedLocked(*rid)) {
+      if (!GetExecutorContext()->GetLockManager()->LockUpgrade(GetExecutorContext()->GetTransaction(),
+                                                               table_info_->oid_, *rid)) {
         return false;
       }
-    } else {
-      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(), *rid)) {
+    } else if (level != IsolationLevel::OPTIMISTIC) {
+      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(),
+                                                                 table_info_->oid_, *rid)) {
         return false;
       }
     }
     Tuple temp;
     if (!table_info_->table_->GetTuple(*rid, &temp, GetExecutorContext()->GetTransaction())) {
+      // A snapshot saw the tuple, so somebody else deleted it since.
+      if (GetExecutorContext()->GetTransaction()->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+        GetExecutorContext()->GetTransaction()->SetState(TransactionState::ABORTED);
+        return false;
+      }
+      // An optimistic read may find somebody else writing the tuple.
+      if (GetExecutorContext()->GetTransaction()->GetState() == TransactionState::ABORTED) {
+        return false;
+      }
       continue;
     }
-    table_info_->table_->MarkDelete(*rid, GetExecutorContext()->GetTransaction());
+    if (!table_info_->table_->MarkDelete(*rid, GetExecutorContext()->GetTransaction())) {
+      return false;
+    }
     for (auto *indexinfo : indexes_) {
-      indexinfo->index_->DeleteEntry(tuple->KeyFromTuple(table_info_->schema_, *indexinfo->index_->GetKeySchema(),
-                                                         indexinfo->index_->GetKeyAttrs()),
-                                     *rid, GetExecutorContext()->GetTransaction());
+      auto key = tuple->KeyFromTuple(table_info_->schema_, *indexinfo->index_->GetKeySchema(),
+                                     indexinfo->index_->GetKeyAttrs());
+      if (!GetExecutorContext()->GetLockManager()->LockIndexKey(GetExecutorContext()->GetTransaction(),
+                                                                indexinfo->index_oid_, key, LockMode::EXCLUSIVE)) {
+        return false;
+      }
+      indexinfo->index_->DeleteEntry(key, *rid, GetExecutorContext()->GetTransaction());
       GetExecutorContext()->GetTransaction()->GetIndexWriteSet()->emplace_back(
           *rid, table_info_->oid_, WType::DELETE, *tuple, indexinfo->index_oid_, GetExecutorContext()->GetCatalog());
     }
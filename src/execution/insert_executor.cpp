@@ -12,6 +12,7 @@
 
 #include <memory>
 
+#include "common/exception.h"
 #include "execution/executor_factory.h"
 #include "execution/executors/insert_executor.h"
 
@@ -22,8 +23,16 @@ InsertExecutor::InsertExecutor(ExecutorContext *exec_ctx, const InsertPlanNode *
     : AbstractExecutor(exec_ctx), plan_(plan), subex_(std::move(child_executor)) {}
 
 void InsertExecutor::Init() {
+  if (GetExecutorContext()->GetTransaction()->IsReadOnly()) {
+    throw Exception("read-only transactions cannot insert");
+  }
   tableinfo_ = GetExecutorContext()->GetCatalog()->GetTable(plan_->TableOid());
   indexes_ = GetExecutorContext()->GetCatalog()->GetTableIndexes(tableinfo_->name_);
+  auto txn = GetExecutorContext()->GetTransaction();
+  auto reason = txn->GetState() == TransactionState::SHRINKING ? AbortReason::LOCK_ON_SHRINKING : AbortReason::DEADLOCK;
+  if (!GetExecutorContext()->GetLockManager()->LockTable(txn, LockMode::INTENTION_EXCLUSIVE, tableinfo_->oid_)) {
+    throw TransactionAbortException(txn->GetTransactionId(), reason);
+  }
   if (plan_->IsRawInsert()) {
     riter_ = plan_->RawValues().begin();
   } else {
@@ -38,13 +47,18 @@ auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
       *tuple = Tuple(*riter_++, &tableinfo_->schema_);
       if (tableinfo_->table_->InsertTuple(*tuple, rid, GetExecutorContext()->GetTransaction())) {
         // Update index after success.
-        if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(), *rid)) {
+        if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(),
+                                                                   tableinfo_->oid_, *rid)) {
           return false;
         }
         for (auto *indexinfo : indexes_) {
-          indexinfo->index_->InsertEntry(tuple->KeyFromTuple(tableinfo_->schema_, *indexinfo->index_->GetKeySchema(),
-                                                             indexinfo->index_->GetKeyAttrs()),
-                                         *rid, GetExecutorContext()->GetTransaction());
+          auto key = tuple->KeyFromTuple(tableinfo_->schema_, *indexinfo->index_->GetKeySchema(),
+                                         indexinfo->index_->GetKeyAttrs());
+          if (!GetExecutorContext()->GetLockManager()->LockIndexKey(GetExecutorContext()->GetTransaction(),
+                                                                    indexinfo->index_oid_, key, LockMode::EXCLUSIVE)) {
+            return false;
+          }
+          indexinfo->index_->InsertEntry(key, *rid, GetExecutorContext()->GetTransaction());
           GetExecutorContext()->GetTransaction()->GetIndexWriteSet()->emplace_back(
               *rid, tableinfo_->oid_, WType::INSERT, *tuple, indexinfo->index_oid_, GetExecutorContext()->GetCatalog());
         }
@@ -55,13 +69,18 @@ auto InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   // Sub insert.
   while (subex_->Next(tuple, rid)) {
     if (tableinfo_->table_->InsertTuple(*tuple, rid, GetExecutorContext()->GetTransaction())) {
-      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(), *rid)) {
+      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(),
+                                                                 tableinfo_->oid_, *rid)) {
         return false;
       }
       for (auto *indexinfo : indexes_) {
-        indexinfo->index_->InsertEntry(tuple->KeyFromTuple(tableinfo_->schema_, *indexinfo->index_->GetKeySchema(),
-                                                           indexinfo->index_->GetKeyAttrs()),
-                                       *rid, GetExecutorContext()->GetTransaction());
+        auto key = tuple->KeyFromTuple(tableinfo_->schema_, *indexinfo->index_->GetKeySchema(),
+                                       indexinfo->index_->GetKeyAttrs());
+        if (!GetExecutorContext()->GetLockManager()->LockIndexKey(GetExecutorContext()->GetTransaction(),
+                                                                  indexinfo->index_oid_, key, LockMode::EXCLUSIVE)) {
+          return false;
+        }
+        indexinfo->index_->InsertEntry(key, *rid, GetExecutorContext()->GetTransaction());
         GetExecutorContext()->GetTransaction()->GetIndexWriteSet()->emplace_back(
             *rid, tableinfo_->oid_, WType::INSERT, *tuple, indexinfo->index_oid_, GetExecutorContext()->GetCatalog());
       }
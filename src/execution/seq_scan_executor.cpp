@@ -24,6 +24,28 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 
 void SeqScanExecutor::Init() {
   tableinfo_ = GetExecutorContext()->GetCatalog()->GetTable(plan_->GetTableOid());
+  // A repeatable read covers the whole table with one lock, a read committed one locks the records it reads in turn.
+  auto txn = GetExecutorContext()->GetTransaction();
+  auto reason = txn->GetState() == TransactionState::SHRINKING ? AbortReason::LOCK_ON_SHRINKING : AbortReason::DEADLOCK;
+  switch (txn->GetIsolationLevel()) {
+    case IsolationLevel::REPEATABLE_READ:
+      if (!GetExecutorContext()->GetLockManager()->LockTable(txn, LockMode::SHARED, plan_->GetTableOid())) {
+        throw TransactionAbortException(txn->GetTransactionId(), reason);
+      }
+      break;
+    case IsolationLevel::READ_COMMITTED:
+      if (!GetExecutorContext()->GetLockManager()->LockTable(txn, LockMode::INTENTION_SHARED, plan_->GetTableOid())) {
+        throw TransactionAbortException(txn->GetTransactionId(), reason);
+      }
+      break;
+    case IsolationLevel::READ_UNCOMMITTED:
+      break;
+    case IsolationLevel::SNAPSHOT_ISOLATION:
+    case IsolationLevel::OPTIMISTIC:
+      // A snapshot reads the versions saved by the writers, an optimistic read is validated at commit.
+      slot_ = RID();
+      break;
+  }
   iter_ = GetExecutorContext()
               ->GetCatalog()
               ->GetTable(plan_->GetTableOid())
@@ -31,23 +53,22 @@ void SeqScanExecutor::Init() {
 }
 
 auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  auto txn = GetExecutorContext()->GetTransaction();
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION ||
+      txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    return NextUnlocked(tuple, rid);
+  }
+  // Records are locked one by one unless the table lock covers them all.
+  bool lock_rows = txn->GetIsolationLevel() != IsolationLevel::READ_UNCOMMITTED &&
+                   !txn->IsTableSharedLocked(plan_->GetTableOid());
+  bool unlock_rows = txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED;
   for (TableIterator i = iter_; i != tableinfo_->table_->End(); i++) {
-    auto txn = GetExecutorContext()->GetTransaction();
-    switch (txn->GetIsolationLevel()) {
-      case IsolationLevel::REPEATABLE_READ:
-      case IsolationLevel::READ_COMMITTED: {
-        if (!GetExecutorContext()->GetLockManager()->LockShared(txn, i->GetRid())) {
-          return false;
-        }
-        break;
-      }
-      case IsolationLevel::READ_UNCOMMITTED: {
-        break;
-      }
+    if (lock_rows && !GetExecutorContext()->GetLockManager()->LockShared(txn, plan_->GetTableOid(), i->GetRid())) {
+      return false;
     }
     Tuple temp;
     if (!tableinfo_->table_->GetTuple(i->GetRid(), &temp, txn)) {
-      if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && !txn->IsExclusiveLocked(i->GetRid()) &&
+      if (unlock_rows && txn->IsSharedLocked(i->GetRid()) &&
           !GetExecutorContext()->GetLockManager()->Unlock(txn, i->GetRid())) {
         return false;
       }
@@ -59,10 +80,10 @@ auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
         auto pre = i;
         *tuple = MakeOutput(*i++);
         iter_ = i;
-        return !(txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && !txn->IsExclusiveLocked(pre->GetRid()) &&
+        return !(unlock_rows && txn->IsSharedLocked(pre->GetRid()) &&
                  !GetExecutorContext()->GetLockManager()->Unlock(txn, pre->GetRid()));
       }
-      if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && !txn->IsExclusiveLocked(i->GetRid()) &&
+      if (unlock_rows && txn->IsSharedLocked(i->GetRid()) &&
           !GetExecutorContext()->GetLockManager()->Unlock(txn, i->GetRid())) {
         return false;
       }
@@ -72,11 +93,35 @@ auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
     auto pre = i;
     *tuple = MakeOutput(*i++);
     iter_ = i;
-    return !(txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && !txn->IsExclusiveLocked(pre->GetRid()) &&
+    return !(unlock_rows && txn->IsSharedLocked(pre->GetRid()) &&
              !GetExecutorContext()->GetLockManager()->Unlock(txn, pre->GetRid()));
   }
   return false;
 }
+auto SeqScanExecutor::NextUnlocked(Tuple *tuple, RID *rid) -> bool {
+  auto txn = GetExecutorContext()->GetTransaction();
+  bool snapshot = txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+  while (tableinfo_->table_->NextSlot(&slot_)) {
+    Tuple temp;
+    bool found = snapshot ? tableinfo_->table_->GetSnapshotTuple(slot_, &temp, txn)
+                          : tableinfo_->table_->GetTuple(slot_, &temp, txn);
+    if (txn->GetState() == TransactionState::ABORTED) {
+      return false;
+    }
+    if (!found) {
+      continue;
+    }
+    if (plan_->GetPredicate() != nullptr &&
+        !plan_->GetPredicate()->Evaluate(&temp, &tableinfo_->schema_).GetAs<bool>()) {
+      continue;
+    }
+    *rid = slot_;
+    *tuple = MakeOutput(temp);
+    return true;
+  }
+  return false;
+}
+
 auto SeqScanExecutor::MakeOutput(const Tuple &t) -> Tuple {
   uint32_t c = plan_->OutputSchema()->GetColumnCount();
   std::vector<Value> values;
@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 #include <memory>
 
+#include "common/exception.h"
 #include "execution/executors/update_executor.h"
 
 namespace bustub {
@@ -20,38 +21,64 @@ UpdateExecutor::UpdateExecutor(ExecutorContext *exec_ctx, const UpdatePlanNode *
     : AbstractExecutor(exec_ctx), plan_(plan), table_info_(nullptr), child_executor_(std::move(child_executor)) {}
 
 void UpdateExecutor::Init() {
+  if (GetExecutorContext()->GetTransaction()->IsReadOnly()) {
+    throw Exception("read-only transactions cannot update");
+  }
   table_info_ = GetExecutorContext()->GetCatalog()->GetTable(plan_->TableOid());
   indexes_ = GetExecutorContext()->GetCatalog()->GetTableIndexes(table_info_->name_);
   child_executor_->Init();
+  auto txn = GetExecutorContext()->GetTransaction();
+  auto reason = txn->GetState() == TransactionState::SHRINKING ? AbortReason::LOCK_ON_SHRINKING : AbortReason::DEADLOCK;
+  if (!GetExecutorContext()->GetLockManager()->LockTable(txn, LockMode::INTENTION_EXCLUSIVE, table_info_->oid_)) {
+    throw TransactionAbortException(txn->GetTransactionId(), reason);
+  }
 }
 
 auto UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) -> bool {
   while (child_executor_->Next(tuple, rid)) {
-    if (GetExecutorContext()->GetTransaction()->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ &&
-        GetExecutorContext()->GetTransaction()->IsSharedLocked(*rid)) {
-      if (!GetExecutorContext()->GetLockManager()->LockUpgrade(GetExecutorContext()->GetTransaction(), *rid)) {
+    // An optimistic transaction locks what it writes only when it commits.
+    auto level = GetExecutorContext()->GetTransaction()->GetIsolationLevel();
+    if (level == IsolationLevel::REPEATABLE_READ && GetExecutorContext()->GetTransaction()->IsSharedLocked(*rid)) {
+      if (!GetExecutorContext()->GetLockManager()->LockUpgrade(GetExecutorContext()->GetTransaction(),
+                                                               table_info_->oid_, *rid)) {
         return false;
       }
-    } else {
-      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(), *rid)) {
+    } else if (level != IsolationLevel::OPTIMISTIC) {
+      if (!GetExecutorContext()->GetLockManager()->LockExclusive(GetExecutorContext()->GetTransaction(),
+                                                                 table_info_->oid_, *rid)) {
         return false;
       }
     }
     Tuple temp;
     if (!table_info_->table_->GetTuple(*rid, &temp, GetExecutorContext()->GetTransaction())) {
+      // A snapshot saw the tuple, so somebody else deleted it since.
+      if (GetExecutorContext()->GetTransaction()->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+        GetExecutorContext()->GetTransaction()->SetState(TransactionState::ABORTED);
+        return false;
+      }
+      // An optimistic read may find somebody else writing the tuple.
+      if (GetExecutorContext()->GetTransaction()->GetState() == TransactionState::ABORTED) {
+        return false;
+      }
       continue;
     }
     Tuple upd = GenerateUpdatedTuple(*tuple);
     if (table_info_->table_->UpdateTuple(upd, *rid, GetExecutorContext()->GetTransaction())) {
       for (auto *indexinfo : indexes_) {
-        indexinfo->index_->InsertEntry(tuple->KeyFromTuple(table_info_->schema_, *indexinfo->index_->GetKeySchema(),
-                                                           indexinfo->index_->GetKeyAttrs()),
-                                       *rid, GetExecutorContext()->GetTransaction());
+        auto key = tuple->KeyFromTuple(table_info_->schema_, *indexinfo->index_->GetKeySchema(),
+                                       indexinfo->index_->GetKeyAttrs());
+        if (!GetExecutorContext()->GetLockManager()->LockIndexKey(GetExecutorContext()->GetTransaction(),
+                                                                  indexinfo->index_oid_, key, LockMode::EXCLUSIVE)) {
+          return false;
+        }
+        indexinfo->index_->InsertEntry(key, *rid, GetExecutorContext()->GetTransaction());
         IndexWriteRecord rec(*rid, table_info_->oid_, WType::UPDATE, upd, indexinfo->index_oid_,
                              GetExecutorContext()->GetCatalog());
         rec.old_tuple_ = *tuple;
         GetExecutorContext()->GetTransaction()->GetIndexWriteSet()->emplace_back(std::move(rec));
       }
+    } else if (GetExecutorContext()->GetTransaction()->GetState() == TransactionState::ABORTED) {
+      return false;
     }
   }
   return false;
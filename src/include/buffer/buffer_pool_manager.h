@@ -15,6 +15,8 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -87,6 +89,13 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual auto GetPoolSize() -> size_t = 0;
 
+  /**
+   * Builds the dirty page table for a checkpoint. Pages that are pinned are reported even if they are still clean, as
+   * they may be modified at any time.
+   * @return the id and recovery lsn of every page that may differ from its version on disk
+   */
+  virtual auto GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> = 0;
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -15,6 +15,8 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/lru_replacer.h"
@@ -55,6 +57,8 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   auto GetPoolSize() -> size_t override { return pool_size_; }
 
+  auto GetDirtyPageTable() -> std::vector<std::pair<page_id_t, lsn_t>> override;
+
   /** @return pointer to all the pages in the buffer pool */
   auto GetPages() -> Page * { return pages_; }
 
@@ -101,6 +105,33 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void FlushAllPgsImp() override;
 
+  /**
+   * Writes the page held by a frame back to disk, forcing the log up to the page LSN first, and marks it clean.
+   * @param lk the held latch, dropped while waiting for the log
+   * @param frame_id the frame holding the page
+   */
+  void WriteFrame(std::unique_lock<std::mutex> *lk, frame_id_t frame_id);
+
+  /**
+   * Waits until the log records describing the page held by a frame are on disk. The latch is dropped while waiting,
+   * with the frame pinned so that it is neither evicted nor deleted meanwhile; others may still pin and change it.
+   * @param lk the held latch
+   * @param frame_id the frame holding the page
+   */
+  void WaitForLog(std::unique_lock<std::mutex> *lk, frame_id_t frame_id);
+
+  /**
+   * Finds a frame for a new page: a free one, or else the frame of a victim, written back if dirty and taken out of
+   * the page table.
+   * @param lk the held latch, dropped while waiting for the log of a victim
+   * @param[out] frame_id the frame found
+   * @return false if all the frames are pinned
+   */
+  auto FindFrame(std::unique_lock<std::mutex> *lk, frame_id_t *frame_id) -> bool;
+
+  /** Records the recovery lsn of a page that is pinned while clean. */
+  void SetRecLSN(frame_id_t frame_id);
+
   /**
    * Allocate a page on disk.∂
    * @return the id of the allocated page
@@ -136,7 +167,7 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
@@ -210,12 +210,15 @@ class Catalog {
     // Construct index metdata
     auto meta = std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
 
+    // Get the next OID for the new index, the index names its key buckets in the lock manager with it
+    const auto index_oid = next_index_oid_.fetch_add(1);
+
     // Construct the index, take ownership of metadata
     // TODO(Kyle): We should update the API for CreateIndex
     // to allow specification of the index type itself, not
     // just the key, value, and comparator types
-    auto index = std::make_unique<ExtendibleHashTableIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_,
-                                                                                               hash_function);
+    auto index = std::make_unique<ExtendibleHashTableIndex<KeyType, ValueType, KeyComparator>>(
+        std::move(meta), bpm_, hash_function, log_manager_, lock_manager_, index_oid);
 
     // Populate the index with all tuples in table heap
     auto *table_meta = GetTable(table_name);
@@ -224,9 +227,6 @@ class Catalog {
       index->InsertEntry(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid(), txn);
     }
 
-    // Get the next OID for the new index
-    const auto index_oid = next_index_oid_.fetch_add(1);
-
     // Construct index information; IndexInfo takes ownership of the Index itself
     auto index_info =
         std::make_unique<IndexInfo>(key_schema, index_name, std::move(index), index_oid, table_name, keysize);
@@ -324,8 +324,8 @@ class Catalog {
 
  private:
   [[maybe_unused]] BufferPoolManager *bpm_;
-  [[maybe_unused]] LockManager *lock_manager_;
-  [[maybe_unused]] LogManager *log_manager_;
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
 
   /**
    * Map table identifier -> table metadata.
@@ -27,6 +27,15 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** An asynchronously committed transaction becomes durable at most ASYNC_COMMIT_DELAY after its commit returns. */
+extern std::chrono::milliseconds async_commit_delay;
+
+/** True if table heaps keep the prior versions of tuples for snapshot isolation. Set before starting transactions. */
+extern std::atomic<bool> enable_mvcc;
+
+/** True if table heaps count the changes to their tuples for optimistic transactions. Set before starting them. */
+extern std::atomic<bool> enable_occ;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
@@ -34,6 +43,18 @@ static constexpr int HEADER_PAGE_ID = 0;                                      //
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_SEGMENT_SIZE = 64 * LOG_BUFFER_SIZE;                // size of a log segment file in byte
+static constexpr int MAX_FREE_LOG_SEGMENTS = 4;                               // recycled log segments kept around
+static constexpr int LOG_READ_AHEAD_SIZE = 1 << 22;                           // log bytes recovery reads at once
+static constexpr size_t LOCK_TABLE_PARTITIONS = 16;                           // number of lock table partitions
+static constexpr size_t LOCK_ESCALATION_THRESHOLD = 5000;                     // record locks escalated per table
+static constexpr size_t LOCK_WORDS_PER_PARTITION = 1024;                      // fast path lock words per partition
+static constexpr size_t TXN_REGISTRY_SHARDS = 16;                             // shards of the transaction registry
+static constexpr size_t TXN_REGISTRY_GUARDS = 64;                             // threads in the registry at once
+static constexpr size_t READ_ONLY_TXN_POOL_SIZE = 64;                         // read-only txns pooled per thread
+static constexpr size_t TXN_POOL_SIZE = 64;                                   // recycled txns pooled per thread
+static constexpr size_t INDEX_LOCK_BUCKETS = 1024;                            // key buckets locked per index
+static constexpr size_t LOCK_PROFILE_TOP_K = 16;                              // hot records and tables profiled
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
 
 using frame_id_t = int32_t;    // frame id type
@@ -41,6 +62,7 @@ using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
 using slot_offset_t = size_t;  // slot offset type
+using timestamp_t = int64_t;   // commit timestamp type
 using oid_t = uint16_t;
 
 }  // namespace bustub
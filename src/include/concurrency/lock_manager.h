@@ -13,28 +13,78 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <optional>
+#include <set>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "common/config.h"
+#include "common/macros.h"
 #include "common/rid.h"
+#include "concurrency/lock_profiler.h"
 #include "concurrency/transaction.h"
 
 namespace bustub {
 
 class TransactionManager;
 
+/** How the lock manager keeps transactions from waiting on each other forever. */
+enum class DeadlockPolicy {
+  /** An older transaction aborts the younger ones in its way when it asks for a lock, so nobody waits on a younger. */
+  WOUND_WAIT,
+  /** Transactions wait for whoever is in their way; every cycle_detection_interval the youngest transaction of each
+     cycle in the waits-for graph is aborted. */
+  DETECTION
+};
+
 /**
- * LockManager handles transactions asking for locks on records.
+ * LockManager handles transactions asking for locks on tables and records.
+ *
+ * Locking is hierarchical: a transaction takes an intention lock on a table before locking any of its records, or locks
+ * the table as a whole in SHARED or EXCLUSIVE mode and skips the record locks altogether. Table locks live in a table
+ * of their own, behind a single latch, since they are taken once per statement rather than once per record.
+ *
+ * The lock table is split by RID hash into partitions, each with its own latch, so requests for records in different
+ * partitions never contend. Every request queue has its own condition variable, hence releasing a lock only wakes up
+ * the transactions waiting for that record. A transaction wounded by an older one is only removed from the queue of the
+ * record they conflict on; it drops the record from its lock sets itself, when it releases its locks.
+ *
+ * Record locks taken through the calls naming the table are counted per table. Once a transaction holds more than
+ * escalation_threshold of them on one table, they are traded for a single SHARED or EXCLUSIVE lock on the table. The
+ * escalation only happens if the table lock can be granted right away; otherwise the record locks stay and it is tried
+ * again after another escalation_threshold of them.
+ *
+ * Index keys are locked by bucket: the keys of an index are hashed onto INDEX_LOCK_BUCKETS buckets, and each bucket is
+ * locked like a record of its own. A repeatable read shares the buckets of the keys it looks up, a writer locks the
+ * bucket of every index entry it adds or removes exclusively. Hence no entry can appear under a key a repeatable read
+ * looked up, or disappear from it, before the reader finishes, while writers of keys in other buckets go ahead. The
+ * hash index shares the bucket in ScanKey, the insert, delete and update executors lock it exclusively.
+ *
+ * Deadlocks are either prevented with wound-wait, or detected by a background thread looking for cycles in the
+ * waits-for graph, depending on the DeadlockPolicy the lock manager is created with. Detection only aborts a
+ * transaction that really is part of a deadlock, at the price of the deadlocked transactions waiting for the next
+ * round.
+ *
+ * Most record locks are never contended, so they skip the lock table: the records of a partition are hashed onto
+ * LOCK_WORDS_PER_PARTITION lock words, and a transaction locks a record with a compare-and-swap or two on its word, as
+ * long as no other transaction uses the word and it has a free entry. The first request the word cannot take inflates
+ * it under the partition latch: its locks become granted requests in the lock table, and every lock on the word goes
+ * through the lock table until the last request of its records is gone.
+ *
+ * Every lock request that has to wait is profiled, see LockProfiler.
  */
 class LockManager {
  public:
-  enum class LockMode { SHARED, EXCLUSIVE };
+  using LockMode = bustub::LockMode;
 
   class LockRequest {
    public:
@@ -57,11 +107,37 @@ class LockManager {
 
  public:
   /**
-   * Creates a new lock manager configured for the deadlock prevention policy.
+   * Creates a new lock manager.
+   * @param num_partitions the number of partitions of the lock table
+   * @param escalation_threshold the number of record locks on a table that get escalated, 0 to never escalate
+   * @param policy how deadlocks are handled, DETECTION starts the cycle detection thread
    */
-  LockManager() = default;
+  explicit LockManager(size_t num_partitions = LOCK_TABLE_PARTITIONS,
+                       size_t escalation_threshold = LOCK_ESCALATION_THRESHOLD,
+                       DeadlockPolicy policy = DeadlockPolicy::WOUND_WAIT)
+      : escalation_threshold_(escalation_threshold), policy_(policy) {
+    BUSTUB_ASSERT(num_partitions > 0, "The lock table needs at least one partition.");
+    for (size_t i = 0; i < num_partitions; i++) {
+      partitions_.emplace_back(std::make_unique<LockTablePartition>());
+    }
+    if (policy_ == DeadlockPolicy::DETECTION) {
+      enable_cycle_detection_ = true;
+      cycle_detection_thread_ = std::thread(&LockManager::RunCycleDetection, this);
+    }
+  }
+
+  ~LockManager() {
+    if (policy_ == DeadlockPolicy::DETECTION) {
+      {
+        std::scoped_lock guard(detection_latch_);
+        enable_cycle_detection_ = false;
+      }
+      detection_cv_.notify_all();
+      cycle_detection_thread_.join();
+    }
+  }
 
-  ~LockManager() = default;
+  DISALLOW_COPY_AND_MOVE(LockManager);
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -106,15 +182,224 @@ class LockManager {
    */
   auto Unlock(Transaction *txn, const RID &rid) -> bool;
 
-  auto GrantS(const RID &rid, txn_id_t txn_id) -> bool;
+  /**
+   * Lock a record of table oid, after taking the intention lock the record lock needs on the table. Nothing is locked
+   * if the table lock covers the record already. Record locks taken this way count towards lock escalation.
+   * @param txn the transaction requesting the lock
+   * @param oid the table the record belongs to
+   * @param rid the record to lock
+   * @return true if the lock is granted, false otherwise
+   */
+  auto LockShared(Transaction *txn, table_oid_t oid, const RID &rid) -> bool;
+  auto LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid) -> bool;
+  auto LockUpgrade(Transaction *txn, table_oid_t oid, const RID &rid) -> bool;
+
+  /**
+   * Lock the bucket of key in index index_oid. SHARED is for looking the key up and only taken by repeatable reads,
+   * which keeps phantoms out; EXCLUSIVE is for adding or removing an entry with the key. Optimistic transactions lock
+   * no bucket. See [LOCK_NOTE].
+   * @param txn the transaction requesting the lock
+   * @param index_oid the index the key belongs to
+   * @param key the index key, built with the key schema of the index
+   * @param lock_mode SHARED or EXCLUSIVE
+   * @return true if the lock is granted or not needed, false otherwise
+   */
+  auto LockIndexKey(Transaction *txn, index_oid_t index_oid, const Tuple &key, LockMode lock_mode) -> bool;
 
-  auto GrantX(const RID &rid, txn_id_t txn_id) -> bool;
+  /** @return the record standing for the bucket of key of index index_oid in the lock table */
+  static auto IndexBucketRid(index_oid_t index_oid, const Tuple &key) -> RID;
+
+  /**
+   * Acquire a lock on a table. INTENTION_SHARED is needed before shared record locks and INTENTION_EXCLUSIVE before
+   * exclusive ones. SHARED covers reading all the records of the table, EXCLUSIVE covers writing them as well, and
+   * SHARED_INTENTION_EXCLUSIVE covers reading all of them while writing some under exclusive record locks. If the table
+   * is locked already, the lock is upgraded in place to the weakest mode covering both. See [LOCK_NOTE].
+   * @param txn the transaction requesting the table lock
+   * @param lock_mode the mode to lock the table in
+   * @param oid the table to lock
+   * @return true if the lock is granted, false otherwise
+   */
+  auto LockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+
+  /**
+   * Release a table lock held by the transaction. The transaction should release its record locks on the table first.
+   * @param txn the transaction releasing the lock
+   * @param oid the table that is locked by the transaction
+   * @return true if the unlock is successful, false otherwise
+   */
+  auto UnlockTable(Transaction *txn, table_oid_t oid) -> bool;
+
+  /** @return true if a table lock in mode a can be granted while another transaction holds one in mode b */
+  static auto AreCompatible(LockMode a, LockMode b) -> bool;
+
+  /** @return the weakest table lock mode covering both held and requested */
+  static auto CombineModes(LockMode held, LockMode requested) -> LockMode;
+
+  /** @return the deadlock policy of this lock manager */
+  auto GetDeadlockPolicy() const -> DeadlockPolicy { return policy_; }
+
+  /** @return the waits, wounds, upgrades and hot spots collected since the lock manager started */
+  auto GetProfiler() -> LockProfiler * { return &profiler_; }
+
+  /*** Graph API, the waits-for graph is owned by the cycle detection thread while it runs. ***/
+
+  /** Adds an edge from t1 -> t2, t1 waits for t2. */
+  void AddEdge(txn_id_t t1, txn_id_t t2);
+
+  /** Removes an edge from t1 -> t2. */
+  void RemoveEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Checks if the graph has a cycle. The search starts from the oldest transaction and follows the oldest edges first,
+   * so the same graph always gives the same answer.
+   * @param[out] txn_id if the graph has a cycle, the youngest transaction in the cycle
+   * @return false if the graph has no cycle, otherwise stores the youngest transaction in the cycle to txn_id
+   */
+  auto HasCycle(txn_id_t *txn_id) -> bool;
+
+  /** @return the list of all edges in the graph */
+  auto GetEdgeList() -> std::vector<std::pair<txn_id_t, txn_id_t>>;
+
+  /** Runs a round of cycle detection: builds the waits-for graph from the lock table and breaks all its cycles. */
+  void DetectDeadlocks();
 
  private:
-  std::mutex latch_;
+  /** Record locks a lock word holds at most. */
+  static constexpr size_t FAST_PATH_ENTRIES = 4;
+
+  /**
+   * The record locks of one transaction on a bucket of records, taken without the lock table.
+   *
+   * The low two bits of word_ are the state: FREE, FAST or INFLATED. A FAST word keeps the entries in use in bits 2
+   * to 5, the busy bit 6 and the owning transaction in the upper half. An INFLATED word keeps the number of requests
+   * in the lock table for the records of the bucket in the upper half instead; it only changes under the partition
+   * latch.
+   *
+   * Only the owner writes the entries: a transaction first swaps a FREE word to a FAST one of its own without entries,
+   * then writes a free entry and publishes it with a second swap. The owner sets the busy bit while it changes the mode
+   * of an entry in use.
+   */
+  struct LockWord {
+    std::atomic<uint64_t> word_{0};
+    /** The record and the mode of every entry, only meaningful while the entry is in use. */
+    std::array<std::atomic<int64_t>, FAST_PATH_ENTRIES> rids_{};
+    std::array<std::atomic<bool>, FAST_PATH_ENTRIES> exclusive_{};
+  };
+
+  static constexpr uint64_t WORD_FREE = 0;
+  static constexpr uint64_t WORD_FAST = 1;
+  static constexpr uint64_t WORD_INFLATED = 2;
+  static constexpr uint64_t WORD_BUSY = 1UL << (2 + FAST_PATH_ENTRIES);
+
+  static auto WordState(uint64_t word) -> uint64_t { return word & 3; }
+  static auto WordEntries(uint64_t word) -> uint64_t { return (word >> 2) & ((1 << FAST_PATH_ENTRIES) - 1); }
+  static auto WordOwner(uint64_t word) -> txn_id_t { return static_cast<txn_id_t>(word >> 32); }
+  static auto WordRequests(uint64_t word) -> uint64_t { return word >> 32; }
+  static auto MakeFastWord(uint64_t entries, txn_id_t owner) -> uint64_t {
+    return WORD_FAST | entries << 2 | static_cast<uint64_t>(static_cast<uint32_t>(owner)) << 32;
+  }
+  static auto MakeInflatedWord(uint64_t requests) -> uint64_t { return WORD_INFLATED | requests << 32; }
+
+  /** A slice of the lock table. */
+  struct LockTablePartition {
+    std::mutex latch_;
+    /** Lock table for lock requests. Called while hold the latch. */
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
+    std::array<LockWord, LOCK_WORDS_PER_PARTITION> words_;
+  };
+
+  /** Hashing a RID is the identity, fold the page id into the slot number. */
+  static auto HashRid(const RID &rid) -> size_t {
+    size_t hash = std::hash<RID>()(rid);
+    return hash ^ (hash >> 32);
+  }
+
+  /** @return the partition of the lock table rid belongs to */
+  auto GetPartition(const RID &rid) -> LockTablePartition & { return *partitions_[HashRid(rid) % partitions_.size()]; }
+
+  /** @return the lock word of rid, in the partition of rid */
+  auto GetLockWord(const RID &rid) -> LockWord & {
+    return GetPartition(rid).words_[HashRid(rid) / partitions_.size() % LOCK_WORDS_PER_PARTITION];
+  }
+
+  /** Lock rid on its lock word, upgrading a shared lock txn holds there. @return false if the lock table is needed */
+  auto FastLock(Transaction *txn, const RID &rid, LockMode lock_mode) -> bool;
+
+  /**
+   * Release the lock txn holds on rid through its lock word.
+   * @param[out] lock_mode the mode of the released lock
+   * @return false if the lock is not on the lock word
+   */
+  auto FastUnlock(Transaction *txn, const RID &rid, LockMode *lock_mode) -> bool;
+
+  /** Move the locks on the lock word of rid into the lock table, if they are not there yet. Called under the latch. */
+  void Inflate(LockTablePartition *partition, const RID &rid);
+
+  /** Count requests added to the lock table for records of the lock word of rid, negative ones for removed requests. */
+  void CountRequests(const RID &rid, int64_t delta);
+
+  static auto GrantS(const LockRequestQueue &queue, txn_id_t txn_id) -> bool;
+
+  static auto GrantX(const LockRequestQueue &queue, txn_id_t txn_id) -> bool;
+
+  /** A table lock is granted once it is compatible with every granted request and every request queued before it. */
+  static auto GrantTable(const LockRequestQueue &queue, txn_id_t txn_id) -> bool;
+
+  /**
+   * @param txn a transaction found in the registry, nullptr if it is not running any more
+   * @return true if txn is aborted or already gone, so its requests are about to leave the queues
+   */
+  static auto IsFinishing(Transaction *txn) -> bool {
+    return txn == nullptr || txn->GetState() == TransactionState::ABORTED;
+  }
+
+  /** Take the intention lock on table oid unless the transaction holds a table lock covering it. */
+  auto LockIntention(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+
+  /** Lock table oid in lock_mode only if that is possible without waiting, nobody gets aborted otherwise. */
+  auto TryLockTable(Transaction *txn, LockMode lock_mode, table_oid_t oid) -> bool;
+
+  /** Count a record lock on table oid, escalating the record locks of the table once there are too many. */
+  void AddRowLock(Transaction *txn, table_oid_t oid, const RID &rid);
+
+  /** Release a record lock without the 2PL state change, for records covered by a table lock now. */
+  void DropRowLock(Transaction *txn, const RID &rid);
+
+  /** Where a transaction in the waits-for graph waits. */
+  struct WaitSite {
+    LockRequestQueue *queue_;
+    /** The record waited for, the waiter of a table lock takes its request back itself. */
+    std::optional<RID> rid_;
+  };
+
+  /** Add the edges of the transactions waiting in queue, the queue of rid or of a table, to the waits-for graph. */
+  void AddQueueEdges(LockRequestQueue *queue, std::optional<RID> rid, std::unordered_map<txn_id_t, WaitSite> *waiting);
+
+  /** Depth-first search for a cycle from txn_id, path holds the transactions on the way to it. */
+  auto FindCycle(txn_id_t txn_id, std::vector<txn_id_t> *path, std::set<txn_id_t> *visited, txn_id_t *victim) -> bool;
+
+  /** Wakes up every cycle_detection_interval to break the deadlocks. */
+  void RunCycleDetection();
+
+  std::vector<std::unique_ptr<LockTablePartition>> partitions_;
+
+  const size_t escalation_threshold_;
+
+  const DeadlockPolicy policy_;
+
+  /** Protects table_lock_table_. */
+  std::mutex table_latch_;
+  std::unordered_map<table_oid_t, LockRequestQueue> table_lock_table_;
+
+  LockProfiler profiler_;
 
-  /** Lock table for lock requests. Called while hold the latch.*/
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
+  /** Waits-for graph, ordered so that cycle detection is deterministic. */
+  std::map<txn_id_t, std::set<txn_id_t>> waits_for_;
+  bool enable_cycle_detection_{false};
+  std::thread cycle_detection_thread_;
+  /** Protects enable_cycle_detection_, lets the destructor cut the detection interval short. */
+  std::mutex detection_latch_;
+  std::condition_variable detection_cv_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,194 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_profiler.h
+//
+// Identification: src/include/concurrency/lock_profiler.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/** A key the space-saving sketch tracks, its count overestimates the true count by at most error_. */
+template <typename Key>
+struct HotKey {
+  Key key_;
+  uint64_t count_;
+  uint64_t error_;
+};
+
+/**
+ * SpaceSaving keeps the approximately most frequent of a stream of keys in a fixed number of counters.
+ *
+ * A key already tracked has its counter bumped. Otherwise the key takes over the counter with the smallest count and
+ * adds one to it, remembering the count it took over as its error. Any key seen more than n / capacity times out of n
+ * is guaranteed to be tracked.
+ */
+template <typename Key>
+class SpaceSaving {
+ public:
+  explicit SpaceSaving(size_t capacity) : capacity_(capacity) {}
+
+  /** Count one occurrence of key. */
+  void Add(const Key &key) {
+    std::scoped_lock guard(latch_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      counters_[it->second].count_++;
+      return;
+    }
+    if (counters_.size() < capacity_) {
+      index_[key] = counters_.size();
+      counters_.push_back({key, 1, 0});
+      return;
+    }
+    auto min = std::min_element(counters_.begin(), counters_.end(),
+                                [](const HotKey<Key> &a, const HotKey<Key> &b) { return a.count_ < b.count_; });
+    index_.erase(min->key_);
+    index_[key] = min - counters_.begin();
+    *min = {key, min->count_ + 1, min->count_};
+  }
+
+  /** @return the tracked keys, most frequent first */
+  auto Top() -> std::vector<HotKey<Key>> {
+    std::scoped_lock guard(latch_);
+    auto top = counters_;
+    std::sort(top.begin(), top.end(), [](const HotKey<Key> &a, const HotKey<Key> &b) { return a.count_ > b.count_; });
+    return top;
+  }
+
+  void Clear() {
+    std::scoped_lock guard(latch_);
+    counters_.clear();
+    index_.clear();
+  }
+
+ private:
+  const size_t capacity_;
+  std::mutex latch_;
+  std::vector<HotKey<Key>> counters_;
+  /** Where the counter of each tracked key is in counters_. */
+  std::unordered_map<Key, size_t> index_;
+};
+
+/**
+ * LockProfiler collects where and how long transactions wait in the lock manager.
+ *
+ * Only requests that block are timed, into a histogram per lock mode with power of two buckets of microseconds, and
+ * counted against the record or table they waited for in a space-saving sketch of LOCK_PROFILE_TOP_K keys. Wounds,
+ * deadlock victims, upgrades and escalations are counted as they happen. Locks granted right away touch at most a
+ * relaxed counter, so the profiler stays on. Index key buckets show up as records with negative page ids.
+ */
+class LockProfiler {
+ public:
+  /** Bucket i counts the waits shorter than 2^i microseconds not counted before it, the last one all longer waits. */
+  static constexpr size_t WAIT_BUCKETS = 24;
+
+  using WaitHistogram = std::array<uint64_t, WAIT_BUCKETS>;
+
+  /** Times a lock request from the first time it has to wait, the request counts as waiting until it is recorded. */
+  class WaitTimer {
+   public:
+    explicit WaitTimer(LockProfiler *profiler) : profiler_(profiler) {}
+
+    /** Start the clock, unless it is running already. */
+    void Start() {
+      if (!started_) {
+        started_ = true;
+        start_ = std::chrono::steady_clock::now();
+        profiler_->waiting_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /** @return true if the request waited */
+    auto Started() const -> bool { return started_; }
+
+    auto Elapsed() const -> std::chrono::microseconds {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_);
+    }
+
+   private:
+    LockProfiler *profiler_;
+    bool started_{false};
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  LockProfiler() : hot_records_(LOCK_PROFILE_TOP_K), hot_tables_(LOCK_PROFILE_TOP_K) {}
+
+  /** Record the wait of a request for rid in lock_mode, if it waited at all. No lock manager latch may be held. */
+  void RecordWait(LockMode lock_mode, const RID &rid, const WaitTimer &timer);
+
+  /** Record the wait of a request for table oid in lock_mode, if it waited at all. Same as RecordWait. */
+  void RecordTableWait(LockMode lock_mode, table_oid_t oid, const WaitTimer &timer);
+
+  void RecordWound() { wounds_.fetch_add(1, std::memory_order_relaxed); }
+  void RecordDeadlockVictim() { deadlock_victims_.fetch_add(1, std::memory_order_relaxed); }
+  void RecordUpgrade() { upgrades_.fetch_add(1, std::memory_order_relaxed); }
+  void RecordEscalation() { escalations_.fetch_add(1, std::memory_order_relaxed); }
+
+  /** @return the number of waits for locks in lock_mode per bucket */
+  auto GetWaitHistogram(LockMode lock_mode) const -> WaitHistogram;
+
+  /** @return the number of requests waiting right now */
+  auto GetWaiting() const -> uint64_t { return waiting_.load(std::memory_order_relaxed); }
+
+  /** @return the number of transactions aborted by wound-wait */
+  auto GetWounds() const -> uint64_t { return wounds_.load(std::memory_order_relaxed); }
+
+  /** @return the number of transactions aborted to break a deadlock */
+  auto GetDeadlockVictims() const -> uint64_t { return deadlock_victims_.load(std::memory_order_relaxed); }
+
+  /** @return the number of shared record locks and table locks upgraded */
+  auto GetUpgrades() const -> uint64_t { return upgrades_.load(std::memory_order_relaxed); }
+
+  /** @return the number of times record locks were escalated to a table lock */
+  auto GetEscalations() const -> uint64_t { return escalations_.load(std::memory_order_relaxed); }
+
+  /** @return the records waited for most often, most first */
+  auto GetHotRecords() -> std::vector<HotKey<RID>> { return hot_records_.Top(); }
+
+  /** @return the tables whose table locks were waited for most often, most first */
+  auto GetHotTables() -> std::vector<HotKey<table_oid_t>> { return hot_tables_.Top(); }
+
+  /** Start over from nothing but the requests waiting. Waits finishing meanwhile may or may not be counted. */
+  void Reset();
+
+  /** @return a human readable dump of everything collected */
+  auto ToString() -> std::string;
+
+ private:
+  static constexpr size_t NUM_LOCK_MODES = 5;
+
+  static auto Bucket(std::chrono::microseconds wait) -> size_t;
+
+  void AddWait(LockMode lock_mode, std::chrono::microseconds wait);
+
+  std::array<std::array<std::atomic<uint64_t>, WAIT_BUCKETS>, NUM_LOCK_MODES> waits_{};
+  std::atomic<uint64_t> waiting_{0};
+  std::atomic<uint64_t> wounds_{0};
+  std::atomic<uint64_t> deadlock_victims_{0};
+  std::atomic<uint64_t> upgrades_{0};
+  std::atomic<uint64_t> escalations_{0};
+  SpaceSaving<RID> hot_records_;
+  SpaceSaving<table_oid_t> hot_tables_;
+};
+
+}  // namespace bustub
@@ -17,6 +17,7 @@
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
 
 #include "common/config.h"
@@ -44,15 +45,26 @@ namespace bustub {
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
- * Transaction isolation level.
+ * Transaction isolation level. A SNAPSHOT_ISOLATION transaction reads the versions committed before it began without
+ * taking any shared lock, and aborts when it writes a tuple changed since. It needs enable_mvcc.
+ *
+ * An OPTIMISTIC transaction takes no record lock while it runs: it remembers the version of every tuple it reads and
+ * buffers its updates and deletes. At commit it locks the tuples it writes, checks that none of the tuples it read
+ * changed, and only then applies its writes; otherwise it aborts. It needs enable_occ.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION, OPTIMISTIC };
 
 /**
  * Type of write operation.
  */
 enum class WType { INSERT = 0, DELETE, UPDATE };
 
+/**
+ * Lock modes. Records are only locked SHARED or EXCLUSIVE. Tables may also be locked in the intention modes, which
+ * announce the record locks a transaction takes underneath.
+ */
+enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
+
 class TableHeap;
 class Catalog;
 using table_oid_t = uint32_t;
@@ -74,6 +86,18 @@ class TableWriteRecord {
   TableHeap *table_;
 };
 
+/**
+ * ReadRecord tracks the version of a tuple read by an optimistic transaction.
+ */
+class ReadRecord {
+ public:
+  ReadRecord(RID rid, TableHeap *table, uint64_t version) : rid_(rid), table_(table), version_(version) {}
+
+  RID rid_;
+  TableHeap *table_;
+  uint64_t version_;
+};
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -154,14 +178,32 @@ class Transaction {
         txn_id_(txn_id),
         prev_lsn_(INVALID_LSN),
         shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        exclusive_lock_set_{new std::unordered_set<RID>},
+        table_lock_set_{new std::unordered_map<table_oid_t, LockMode>},
+        table_row_lock_set_{new std::unordered_map<table_oid_t, std::unordered_set<RID>>} {
     // Initialize the sets that will be tracked.
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
+    read_set_ = std::make_shared<std::deque<ReadRecord>>();
+    buffered_write_set_ = std::make_shared<std::unordered_map<RID, TableWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
   }
 
+  /** Tag for the constructor of a read-only transaction. */
+  struct ReadOnly {};
+
+  /**
+   * Creates a read-only transaction. It reads a snapshot and never locks, so none of the write, page and lock sets are
+   * allocated: their getters return nullptr.
+   */
+  Transaction(txn_id_t txn_id, ReadOnly /*unused*/)
+      : isolation_level_(IsolationLevel::SNAPSHOT_ISOLATION),
+        thread_id_(std::this_thread::get_id()),
+        txn_id_(txn_id),
+        read_only_(true),
+        prev_lsn_(INVALID_LSN) {}
+
   ~Transaction() = default;
 
   DISALLOW_COPY(Transaction);
@@ -175,12 +217,56 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline auto GetIsolationLevel() const -> IsolationLevel { return isolation_level_; }
 
+  /** @return true if this is a read-only transaction */
+  inline auto IsReadOnly() const -> bool { return read_only_; }
+
+  /**
+   * Reuse a finished transaction for a new one. The sets are emptied but keep their memory.
+   * @param txn_id the id of the new transaction
+   * @param isolation_level the isolation level of the new transaction, a read-only one keeps SNAPSHOT_ISOLATION
+   */
+  inline void Recycle(txn_id_t txn_id, IsolationLevel isolation_level) {
+    thread_id_ = std::this_thread::get_id();
+    txn_id_ = txn_id;
+    state_ = TransactionState::GROWING;
+    prev_lsn_ = INVALID_LSN;
+    begin_lsn_ = INVALID_LSN;
+    async_commit_ = false;
+    read_ts_ = 0;
+    commit_ts_ = 0;
+    if (read_only_) {
+      return;
+    }
+    isolation_level_ = isolation_level;
+    table_write_set_->clear();
+    index_write_set_->clear();
+    read_set_->clear();
+    buffered_write_set_->clear();
+    page_set_->clear();
+    deleted_page_set_->clear();
+    shared_lock_set_->clear();
+    exclusive_lock_set_->clear();
+    table_lock_set_->clear();
+    table_row_lock_set_->clear();
+  }
+
   /** @return the list of table write records of this transaction */
   inline auto GetWriteSet() -> std::shared_ptr<std::deque<TableWriteRecord>> { return table_write_set_; }
 
   /** @return the list of index write records of this transaction */
   inline auto GetIndexWriteSet() -> std::shared_ptr<std::deque<IndexWriteRecord>> { return index_write_set_; }
 
+  /** @return the versions of the tuples read by this transaction, if it is optimistic */
+  inline auto GetReadSet() -> std::shared_ptr<std::deque<ReadRecord>> { return read_set_; }
+
+  /**
+   * @return the updates and deletes of this transaction not applied yet, if it is optimistic. The tuple of an update is
+   * the new one.
+   */
+  inline auto GetBufferedWriteSet() -> std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> {
+    return buffered_write_set_;
+  }
+
   /** @return the page set */
   inline auto GetPageSet() -> std::shared_ptr<std::deque<Page *>> { return page_set_; }
 
@@ -229,6 +315,30 @@ class Transaction {
     return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end();
   }
 
+  /** @return the records locked by this transaction through LockManager calls naming their table, by table */
+  inline auto GetTableRowLockSet() -> std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> {
+    return table_row_lock_set_;
+  }
+
+  /** @return the tables locked by this transaction, with the mode of each lock */
+  inline auto GetTableLockSet() -> std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> {
+    return table_lock_set_;
+  }
+
+  /** @return true if the lock on table oid lets this transaction read every record without locking it */
+  auto IsTableSharedLocked(table_oid_t oid) -> bool {
+    auto it = table_lock_set_->find(oid);
+    return it != table_lock_set_->end() &&
+           (it->second == LockMode::SHARED || it->second == LockMode::SHARED_INTENTION_EXCLUSIVE ||
+            it->second == LockMode::EXCLUSIVE);
+  }
+
+  /** @return true if the lock on table oid lets this transaction write every record without locking it */
+  auto IsTableExclusiveLocked(table_oid_t oid) -> bool {
+    auto it = table_lock_set_->find(oid);
+    return it != table_lock_set_->end() && it->second == LockMode::EXCLUSIVE;
+  }
+
   /** @return the current state of the transaction */
   inline auto GetState() -> TransactionState { return state_; }
 
@@ -247,22 +357,72 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the LSN of the transaction's BEGIN record */
+  inline auto GetBeginLSN() -> lsn_t { return begin_lsn_; }
+
+  /**
+   * Set the LSN of the transaction's BEGIN record.
+   * @param begin_lsn the lsn of the BEGIN record
+   */
+  inline void SetBeginLSN(lsn_t begin_lsn) { begin_lsn_ = begin_lsn; }
+
+  /** @return the timestamp of the snapshot read by this transaction: it sees the commits stamped at most this */
+  inline auto GetReadTs() const -> timestamp_t { return read_ts_; }
+
+  /**
+   * Set the read timestamp of the transaction.
+   * @param read_ts the commit timestamp of the last transaction committed when this one began
+   */
+  inline void SetReadTs(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return the commit timestamp of the transaction, 0 if it did not commit any change */
+  inline auto GetCommitTs() const -> timestamp_t { return commit_ts_; }
+
+  /**
+   * Set the commit timestamp of the transaction.
+   * @param commit_ts the commit timestamp
+   */
+  inline void SetCommitTs(timestamp_t commit_ts) { commit_ts_ = commit_ts; }
+
+  /** @return true if the commit of this transaction returns before its commit record is durable */
+  inline auto IsAsyncCommit() const -> bool { return async_commit_; }
+
+  /**
+   * Choose whether the commit waits for the commit record to reach the disk. An asynchronous commit only appends the
+   * record; the flush thread makes it durable within async_commit_delay, so a crash may lose it.
+   * @param async_commit true to commit asynchronously
+   */
+  inline void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
+
  private:
-  /** The current transaction state. */
-  TransactionState state_{TransactionState::GROWING};
+  /** The current transaction state, other transactions may abort it while it runs. */
+  std::atomic<TransactionState> state_{TransactionState::GROWING};
   /** The isolation level of the transaction. */
   IsolationLevel isolation_level_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
   txn_id_t txn_id_;
+  /** True for a read-only transaction, which has none of the sets below. */
+  bool read_only_{false};
 
   /** The undo set of table tuples. */
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
+  /** OCC: the tuples read, validated at commit. */
+  std::shared_ptr<std::deque<ReadRecord>> read_set_;
+  /** OCC: the writes applied at commit, by tuple. */
+  std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> buffered_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** The LSN of the first record written by the transaction. */
+  lsn_t begin_lsn_{INVALID_LSN};
+  /** Do not wait for the commit record to become durable. */
+  bool async_commit_{false};
+  /** MVCC: the snapshot the transaction reads, and the timestamp its changes are stamped with. */
+  timestamp_t read_ts_{0};
+  timestamp_t commit_ts_{0};
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -273,6 +433,10 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the tables locked by this transaction. */
+  std::shared_ptr<std::unordered_map<table_oid_t, LockMode>> table_lock_set_;
+  /** LockManager: the locked tuples of each table, counted for lock escalation. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::unordered_set<RID>>> table_row_lock_set_;
 };
 
 }  // namespace bustub
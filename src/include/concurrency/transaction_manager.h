@@ -13,13 +13,17 @@
 #pragma once
 
 #include <atomic>
-#include <shared_mutex>
+#include <map>
+#include <mutex>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -36,19 +40,38 @@ class TransactionManager {
   ~TransactionManager() = default;
 
   /**
-   * Begins a new transaction.
-   * @param txn an optional transaction object to be initialized, otherwise a new transaction is created.
+   * Begins a new transaction. Its snapshot holds every transaction committed so far.
+   * @param txn an optional transaction object to be initialized, otherwise one handed to Recycle on this thread is
+   * reused, or a new transaction is created.
    * @param isolation_level an optional isolation level of the transaction.
-   * @return an initialized transaction
+   * @return an initialized transaction, the caller frees it or hands it to Recycle once it finished
    */
   auto Begin(Transaction *txn = nullptr, IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ)
       -> Transaction *;
 
   /**
-   * Commits a transaction.
+   * Hand a committed or aborted transaction back instead of freeing it, for a later Begin of the calling thread to
+   * reuse together with the memory of its sets.
+   * @param txn a finished transaction created by Begin, the caller must not use it any more
+   */
+  void Recycle(Transaction *txn);
+
+  /**
+   * Begins a read-only transaction. It reads the snapshot of every transaction committed so far, without locks and
+   * without log records. The transaction comes from a pool of the calling thread and goes back to the pool of the
+   * thread committing or aborting it, so the caller must not free it.
+   * @return an initialized read-only transaction
+   */
+  auto BeginReadOnly() -> Transaction *;
+
+  /**
+   * Commits a transaction. A transaction that changed tuples gets the next commit timestamp, which is published only
+   * after all its versions are stamped with it. An optimistic transaction is validated first, and aborted if that
+   * fails.
    * @param txn the transaction to commit
+   * @return true if the transaction committed
    */
-  void Commit(Transaction *txn);
+  auto Commit(Transaction *txn) -> bool;
 
   /**
    * Aborts a transaction
@@ -56,27 +79,29 @@ class TransactionManager {
    */
   void Abort(Transaction *txn);
 
+  /** Every running transaction in the system, by id, for the lock manager to find the holders of its locks. */
+  static TransactionRegistry txn_registry;
+
   /**
-   * Global list of running transactions
+   * Locates and returns the transaction with the given transaction ID. Call it inside a TransactionRegistry::Guard, or
+   * while the transaction cannot finish, e.g. because it holds a lock whose latch the caller has.
+   * @param txn_id the id of the transaction to be found
+   * @return the transaction with the given transaction id, nullptr if it is not running
    */
-
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
+  static auto GetTransaction(txn_id_t txn_id) -> Transaction * { return txn_registry.Find(txn_id); }
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
-   * @return the transaction with the given transaction id
+   * Builds the active transaction table for a fuzzy checkpoint.
+   * @param[out] oldest_begin_lsn the smallest BEGIN lsn of the active transactions, INVALID_LSN if there are none
+   * @return the id and last lsn of every transaction that has not committed or aborted yet
    */
-  static auto GetTransaction(txn_id_t txn_id) -> Transaction * {
-    TransactionManager::txn_map_mutex.lock_shared();
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    TransactionManager::txn_map_mutex.unlock_shared();
-    return res;
-  }
+  auto GetActiveTransactionTable(lsn_t *oldest_begin_lsn) -> std::vector<std::pair<txn_id_t, lsn_t>>;
+
+  /** @return the oldest read timestamp in use: every running transaction sees the versions stamped at most this */
+  auto GetWatermark() -> timestamp_t;
+
+  /** @return the oldest read timestamp of the running optimistic transactions, the only ones validating their reads */
+  auto GetOptimisticWatermark() -> timestamp_t;
 
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
@@ -85,6 +110,16 @@ class TransactionManager {
   void ResumeTransactions();
 
  private:
+  /**
+   * Lock the tuples an optimistic transaction writes, check that the tuples it read did not change, then apply its
+   * buffered writes.
+   * @return false if the transaction has to abort
+   */
+  auto ValidateAndInstall(Transaction *txn) -> bool;
+
+  /** Finish a read-only transaction and return it to the pool of the calling thread. */
+  void FinishReadOnly(Transaction *txn, TransactionState state);
+
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
@@ -100,14 +135,34 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    // Table locks go last, they cover the record locks.
+    std::vector<table_oid_t> locked_tables;
+    for (const auto &[oid, mode] : *txn->GetTableLockSet()) {
+      locked_tables.push_back(oid);
+    }
+    for (auto oid : locked_tables) {
+      lock_manager_->UnlockTable(txn, oid);
+    }
   }
 
   std::atomic<txn_id_t> next_txn_id_{0};
   LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
+
+  /** The transactions of this manager that are still running. */
+  std::unordered_map<txn_id_t, Transaction *> active_txns_;
+  /** The number of running read-only transactions by read timestamp. Entries are dropped lazily, by GetWatermark. */
+  std::map<timestamp_t, size_t> read_only_snapshots_;
+  /** Protects active_txns_ and read_only_snapshots_. */
+  std::mutex active_txns_latch_;
+
+  /** The timestamp of the last commit, the read timestamp of the transactions beginning now. */
+  std::atomic<timestamp_t> last_commit_ts_{0};
+  /** Serializes stamping the versions of committing transactions. */
+  std::mutex commit_latch_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,91 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * TransactionRegistry maps the ids of the running transactions to their Transaction objects.
+ *
+ * The map is split by transaction id into shards with a latch each, so beginning and finishing transactions on
+ * different shards never contend. A transaction leaves the registry when it finishes, which keeps the map as small as
+ * the number of running transactions.
+ *
+ * A pointer found in the registry is only safe to use inside a Guard. Guards announce the epoch they entered in;
+ * unregistering a transaction starts a new epoch and waits for the guards of the older epochs to leave, since any of
+ * them may still use the pointer. After that nobody can reach the transaction through the registry any more, and it
+ * may be freed or reused. Guards are meant to be short and must not block on anything a finishing transaction holds.
+ */
+class TransactionRegistry {
+ public:
+  /** Keeps the transactions found while it lives from being reclaimed. */
+  class Guard {
+   public:
+    explicit Guard(TransactionRegistry *registry) : registry_(registry), slot_(registry->Enter()) {}
+    ~Guard() { registry_->Exit(slot_); }
+
+    DISALLOW_COPY_AND_MOVE(Guard);
+
+   private:
+    TransactionRegistry *registry_;
+    size_t slot_;
+  };
+
+  /** Add txn, replacing a finished transaction that had the same id. */
+  void Register(Transaction *txn);
+
+  /** Remove txn, then wait until no guard that may have found it is left. The caller may free txn afterwards. */
+  void Unregister(Transaction *txn);
+
+  /**
+   * Find a transaction, call it inside a Guard.
+   * @return the transaction with id txn_id, nullptr if it is not running
+   */
+  auto Find(txn_id_t txn_id) -> Transaction *;
+
+  /** @return the number of registered transactions */
+  auto Size() -> size_t;
+
+ private:
+  struct Shard {
+    std::mutex latch_;
+    std::unordered_map<txn_id_t, Transaction *> txns_;
+  };
+
+  /** The epoch a guard entered in, 0 if the slot is free. Padded, so that guards do not share a cache line. */
+  struct alignas(64) GuardSlot {
+    std::atomic<uint64_t> epoch_{0};
+  };
+
+  auto GetShard(txn_id_t txn_id) -> Shard & { return shards_[static_cast<size_t>(txn_id) % TXN_REGISTRY_SHARDS]; }
+
+  /** Take a free guard slot for the current epoch. @return the slot */
+  auto Enter() -> size_t;
+
+  void Exit(size_t slot) { slots_[slot].epoch_.store(0); }
+
+  std::array<Shard, TXN_REGISTRY_SHARDS> shards_;
+  std::atomic<uint64_t> epoch_{1};
+  std::array<GuardSlot, TXN_REGISTRY_GUARDS> slots_;
+};
+
+}  // namespace bustub
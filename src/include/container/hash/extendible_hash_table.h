@@ -15,11 +15,13 @@
 #include <queue>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
+#include "recovery/log_manager.h"
 #include "storage/page/hash_table_bucket_page.h"
 #include "storage/page/hash_table_directory_page.h"
 
@@ -31,6 +33,12 @@ namespace bustub {
  * Implementation of extendible hash table that is backed by a buffer pool
  * manager. Non-unique keys are supported. Supports insert and delete. The
  * table grows/shrinks dynamically as buckets become full/empty.
+ *
+ * With a log manager, every change to the directory and bucket pages is logged as a redo-only PAGE_DELTA record, a
+ * split or merge as a single record. Recovery thereby restores the pages, and the table can be reopened from its
+ * directory page without rebuilding it. An entry a transaction inserts or removes is logged in the transaction's
+ * chain as an INDEX_INSERT or INDEX_DELETE record instead, so that recovery can undo it if the transaction does not
+ * commit.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTable {
@@ -41,9 +49,12 @@ class ExtendibleHashTable {
    * @param buffer_pool_manager buffer pool manager to be used
    * @param comparator comparator for keys
    * @param hash_fn the hash function
+   * @param log_manager the log manager, nullptr to not log the changes
+   * @param directory_page_id the directory page of an existing hash table to open, INVALID_PAGE_ID for a new one
    */
   explicit ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
-                               const KeyComparator &comparator, HashFunction<KeyType> hash_fn);
+                               const KeyComparator &comparator, HashFunction<KeyType> hash_fn,
+                               LogManager *log_manager = nullptr, page_id_t directory_page_id = INVALID_PAGE_ID);
 
   /**
    * Inserts a key-value pair into the hash table.
@@ -75,6 +86,9 @@ class ExtendibleHashTable {
    */
   auto GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) -> bool;
 
+  /** @return the page id of the directory page, which identifies the hash table on disk */
+  auto GetDirectoryPageId() const -> page_id_t { return directory_page_id_; }
+
   /**
    * Returns the global depth.  Do not touch.
    */
@@ -162,6 +176,40 @@ class ExtendibleHashTable {
    */
   void Merge(Transaction *transaction, const KeyType &key, const ValueType &value);
 
+  /** Pages about to be changed, together with a copy of their data before the change. */
+  using PageImages = std::vector<std::pair<Page *, std::vector<char>>>;
+
+  /**
+   * Copies a page before it is changed, if changes are logged.
+   *
+   * @param page the page
+   * @param[out] images the copies taken so far
+   */
+  void SaveImage(Page *page, PageImages *images);
+
+  /**
+   * Logs what changed in the pages since their images were saved, as one PAGE_DELTA record.
+   *
+   * @param images the pages and their saved images
+   */
+  void LogChanges(const PageImages &images);
+
+  /**
+   * Logs the change to the bucket of an entry inserted or removed on behalf of a transaction, as one INDEX_INSERT or
+   * INDEX_DELETE record. Without a transaction, or for values other than rids, it is logged as a PAGE_DELTA record.
+   *
+   * @param images the bucket page and its saved image
+   * @param transaction the current transaction
+   * @param log_record_type INDEX_INSERT or INDEX_DELETE
+   * @param key the key of the entry
+   * @param value the value of the entry
+   */
+  void LogEntryChange(const PageImages &images, Transaction *transaction, LogRecordType log_record_type,
+                      const KeyType &key, const ValueType &value);
+
+  /** @return the changed byte ranges of the pages since their images were saved */
+  static auto MakeDeltas(const PageImages &images) -> std::vector<PageDelta>;
+
   // member variables
   page_id_t directory_page_id_;
   BufferPoolManager *buffer_pool_manager_;
@@ -170,8 +218,7 @@ class ExtendibleHashTable {
   // Readers includes inserts and removes, writers are splits and merges
   ReaderWriterLatch table_latch_;
   HashFunction<KeyType> hash_fn_;
-
-  std::unordered_map<page_id_t, page_id_t> reftopage_;
+  LogManager *log_manager_;
 };
 
 }  // namespace bustub
@@ -54,11 +54,19 @@ class SeqScanExecutor : public AbstractExecutor {
   auto MakeOutput(const Tuple &t) -> Tuple;
 
  private:
+  /**
+   * Next for the transactions reading without locks, which walk every slot: a snapshot reads the version it sees, an
+   * optimistic transaction remembers the version it read.
+   */
+  auto NextUnlocked(Tuple *tuple, RID *rid) -> bool;
+
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
   /** The iterator for scan */
   TableIterator iter_;
   /** Table Info */
   TableInfo *tableinfo_;
+  /** The last slot a scan without locks visited. */
+  RID slot_{};
 };
 }  // namespace bustub
@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +23,12 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes fuzzy checkpoints, transactions keep running while a checkpoint is taken.
+ *
+ * BeginCheckpoint logs a BEGIN_CHECKPOINT record, snapshots the active transaction table and the dirty page table
+ * into END_CHECKPOINT records and, once they are durable, points the master record at the checkpoint. The
+ * pages that were dirty at that time are then written out by a background thread, which EndCheckpoint waits for.
+ * Recovery starts redo at the smallest recovery lsn of the dirty page table instead of the beginning of the log.
  */
 class CheckpointManager {
  public:
@@ -29,15 +38,23 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager() { EndCheckpoint(); }
 
   void BeginCheckpoint();
   void EndCheckpoint();
 
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** The number of table entries per END_CHECKPOINT record, a record takes at most a quarter of the log buffer. */
+  static constexpr size_t MAX_CHECKPOINT_ENTRIES = LOG_BUFFER_SIZE / 4 / (sizeof(page_id_t) + sizeof(lsn_t));
+
+  /** Writes the pages of a dirty page table back to disk. */
+  void FlushDirtyPages(std::vector<std::pair<page_id_t, lsn_t>> dirty_pages);
+
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  /** The background thread flushing the dirty pages of the last checkpoint. */
+  std::thread flush_thread_;
 };
 
 }  // namespace bustub
@@ -13,9 +13,13 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <utility>
+#include <vector>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
@@ -25,16 +29,29 @@ namespace bustub {
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Records are appended into log_buffer_ while flush_buffer_ is being written out. Appenders do not take latch_: each
+ * one reserves its lsn and a slice of log_buffer_ with a single compare-and-swap on reservation_, serializes its record
+ * into the slice and then adds its size to filled_bytes_. To swap the buffers the flush thread seals reservation_, so
+ * that no new slice can be handed out, and waits until filled_bytes_ reaches the sealed offset, i.e. until the buffer
+ * is contiguously filled. Appenders only block when the active buffer fills up during a write. Committers do not
+ * write the log themselves: they ask the flush thread for a flush and wait for persistent_lsn_ to pass their commit
+ * record, hence every commit that arrives during a write is made durable by the
+ * next single DiskManager::WriteLog (group commit). Asynchronous committers only move flush_deadline_ forward, so the
+ * flush thread writes their commit records within async_commit_delay even when nobody waits for them.
  */
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+      : reservation_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
+    // The log file may already hold the log of an earlier run, new records go after it and continue its lsns.
+    ResumeLog();
   }
 
   ~LogManager() {
+    StopFlushThread();
     delete[] log_buffer_;
     delete[] flush_buffer_;
     log_buffer_ = nullptr;
@@ -46,29 +63,107 @@ class LogManager {
 
   auto AppendLogRecord(LogRecord *log_record) -> lsn_t;
 
-  inline auto GetNextLSN() -> lsn_t { return next_lsn_; }
+  /**
+   * Blocks until every log record up to and including lsn has been written to disk. Without a flush thread the
+   * caller writes the log buffer itself.
+   * @param lsn the log sequence number that must become persistent
+   */
+  void WaitUntilPersistent(lsn_t lsn);
+
+  /**
+   * Makes every log record up to and including lsn persistent within delay, without waiting for it. Without a flush
+   * thread the caller writes the log buffer itself. Use GetPersistentLSN or WaitUntilPersistent to learn when it is.
+   * @param lsn the log sequence number that must become persistent
+   * @param delay the longest the record may stay in memory only
+   */
+  void RequestPersistent(lsn_t lsn, std::chrono::milliseconds delay);
+
+  /**
+   * Finds where to start scanning the log file to reach a record. The offset is the start of the write that contained
+   * the record, i.e. it may lie a few records before it.
+   * @param lsn a persistent log sequence number
+   * @param[out] first_lsn if not null, the lsn of the record at the returned offset
+   * @return a log file offset at or before the record with the given lsn
+   */
+  auto GetLogOffset(lsn_t lsn, lsn_t *first_lsn = nullptr) -> int64_t;
+
+  /**
+   * Gives up the log before the write that contains lsn. The disk manager recycles the log segments that lie entirely
+   * before it.
+   * @param lsn the oldest log sequence number recovery still needs
+   */
+  void TruncateLog(lsn_t lsn);
+
+  inline auto GetNextLSN() -> lsn_t { return static_cast<lsn_t>(reservation_.load() >> 32); }
   inline auto GetPersistentLSN() -> lsn_t { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline auto GetLogBuffer() -> char * { return log_buffer_; }
+  inline auto GetDiskManager() -> DiskManager * { return disk_manager_; }
 
  private:
-  // TODO(students): you may add your own member variables
-
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /**
+   * Finds the last complete record in the log, cuts off a torn record behind it and makes the next lsn follow its lsn.
+   * The log is scanned from the checkpoint the master record points at, or from its start.
+   */
+  void ResumeLog();
+
+  /**
+   * Swaps the buffers and writes out everything appended so far. latch_ must be held by the caller through lock; it
+   * is released during the write.
+   */
+  void FlushBuffer(std::unique_lock<std::mutex> *lock);
+
+  /**
+   * Called by appenders that cannot reserve size bytes because the buffer is sealed or full. Returns once a flush
+   * freed up the buffer.
+   */
+  void WaitForSpace(int32_t size);
+
+  /** Serializes the record into dst, which must have room for log_record->GetSize() bytes. */
+  static void SerializeLogRecord(LogRecord *log_record, char *dst);
+
+  /** Marks reservation_ as sealed while the buffers are being swapped. */
+  static constexpr uint64_t SEALED = 1ULL << 31;
+  static constexpr uint64_t OFFSET_MASK = SEALED - 1;
+
+  /**
+   * The next log sequence number in the high 32 bits, the SEALED flag and the number of bytes reserved in log_buffer_
+   * in the low 32 bits. Both are advanced together by a single compare-and-swap.
+   */
+  std::atomic<uint64_t> reservation_;
+  /** Number of bytes of log_buffer_ that hold completely serialized records. */
+  std::atomic<uint64_t> filled_bytes_{0};
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
+  /** The lsn of the first record in log_buffer_. */
+  lsn_t buffer_first_lsn_{0};
+  /** The log file offset log_buffer_ will be written at. */
+  int64_t log_file_offset_{0};
+  /** The first lsn and the log file offset of every write, in order. */
+  std::vector<std::pair<lsn_t, int64_t>> flush_index_;
+
+  /** Only swapped while reservation_ is sealed and all its slices are filled. */
   char *log_buffer_;
   char *flush_buffer_;
-
+  /** True while flush_buffer_ is being written to disk. */
+  bool flush_in_progress_{false};
+  /** Set by appenders and committers to make the flush thread write without waiting for the timeout. */
+  bool flush_requested_{false};
+  /** The flush thread writes the log buffer no later than this, earlier than the timeout if asked to. */
+  std::chrono::steady_clock::time_point flush_deadline_{std::chrono::steady_clock::time_point::max()};
+
+  /** Serializes buffer swaps and protects the flags and the flush index. */
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
 
+  /** Wakes up the flush thread. */
   std::condition_variable cv_;
+  /** Signalled whenever the buffers are swapped or a write completes, wakes up appenders and committers. */
+  std::condition_variable flushed_cv_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.h
+//
+// Identification: src/include/recovery/log_reader.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <future>  // NOLINT
+#include <memory>
+
+#include "common/macros.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * LogReader streams the log sequentially from a given offset and hands out one record at a time, pointing right into
+ * its read buffer instead of copying the record out.
+ *
+ * The log is read in chunks of read_ahead_size bytes into two buffers: while the records of one chunk are consumed, the
+ * next chunk is read into the other buffer in the background. Every buffer keeps LOG_BUFFER_SIZE bytes of room in
+ * front of its chunk, a record cut by the end of a chunk is completed by copying its head there, so no record is ever
+ * split and at most one record per chunk is copied.
+ */
+class LogReader {
+ public:
+  /**
+   * @param disk_manager the disk manager holding the log
+   * @param offset the log offset of the first record
+   * @param read_ahead_size the number of log bytes read at once
+   */
+  LogReader(DiskManager *disk_manager, int64_t offset, int read_ahead_size = LOG_READ_AHEAD_SIZE);
+
+  ~LogReader();
+
+  DISALLOW_COPY_AND_MOVE(LogReader);
+
+  /**
+   * Moves to the next record. The log ends at the first record that is not complete or whose size is out of range.
+   * @return false at the end of the log
+   */
+  auto Next() -> bool;
+
+  /** @return the serialized current record, valid until the next call to Next */
+  inline auto GetRecord() const -> const char * { return pos_; }
+
+  /** @return the size of the current record */
+  inline auto GetRecordSize() const -> int32_t { return record_size_; }
+
+  /** @return the log offset of the current record, or of the end of the log once Next returned false */
+  inline auto GetRecordOffset() const -> int64_t { return base_offset_ + (pos_ - base_); }
+
+ private:
+  /** Starts reading the chunk at read_offset_ into the buffer that is not being consumed. */
+  void StartRead();
+
+  /**
+   * Switches to the chunk read by StartRead, moving the incomplete bytes at the end of the current chunk in front of
+   * it.
+   * @return false if there is no further chunk
+   */
+  auto NextChunk() -> bool;
+
+  DiskManager *disk_manager_;
+  const int read_ahead_size_;
+  /** The log is not read beyond the end it had when the reader was created. */
+  const int64_t end_offset_;
+
+  std::array<std::unique_ptr<char[]>, 2> buffers_;
+  /** The buffer being consumed. */
+  size_t current_{0};
+  /** The first byte in the current buffer and its log offset. */
+  const char *base_;
+  int64_t base_offset_;
+  /** The current record and the end of the bytes read into the current buffer. */
+  const char *pos_;
+  const char *end_;
+  int32_t record_size_{0};
+
+  /** The log offset of the next chunk to read. */
+  int64_t read_offset_;
+  /** The background read of the next chunk, yields the number of bytes read. */
+  std::future<int> pending_read_;
+};
+
+}  // namespace bustub
@@ -14,6 +14,8 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +34,27 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Start of a fuzzy checkpoint. */
+  BEGIN_CHECKPOINT,
+  /** End of a fuzzy checkpoint, carries the active transaction table and the dirty page table. */
+  END_CHECKPOINT,
+  /** An update that keeps the size of the tuple, only the changed byte ranges are logged. */
+  UPDATE_DELTA,
+  /** Physical, redo-only changes to one or more pages of an index. */
+  PAGE_DELTA,
+  /** Compensation log record, the change that undid a record of a loser transaction during recovery. Redo-only. */
+  CLR,
+  /** An entry a transaction inserted into a hash index, redone as the page delta of its bucket. */
+  INDEX_INSERT,
+  /** An entry a transaction removed from a hash index, redone as the page delta of its bucket. */
+  INDEX_DELETE,
+};
+
+/** The byte ranges of one page that changed, and their new contents concatenated in range order. */
+struct PageDelta {
+  page_id_t page_id_{INVALID_PAGE_ID};
+  std::vector<std::pair<uint32_t, uint32_t>> ranges_;
+  std::vector<char> data_;
 };
 
 /**
@@ -53,14 +76,39 @@ enum class LogRecordType {
  *-----------------------------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
+ * For delta update type log record, ranges are (offset in tuple, length) and the data is concatenated in range order
+ *-----------------------------------------------------------------------------------------
+ * | HEADER | tuple_rid | num_ranges | (offset, length) * num_ranges | old_data | new_data |
+ *-----------------------------------------------------------------------------------------
+ * For page delta type log record, all the pages are redone or none of them
+ *-----------------------------------------------------------------------------------------------------------
+ * | HEADER | num_pages | (page_id | num_ranges | (offset, length) * num_ranges | new_data) * num_pages |
+ *-----------------------------------------------------------------------------------------------------------
+ * For index entry type log record (including index insert and index delete), the entry is found again through the
+ * directory page of its index to undo it. The page deltas are laid out as in a page delta record
+ *--------------------------------------------------------------------------------------------
+ * | HEADER | directory_page_id | key_size | key_data | rid | num_pages | page deltas |
+ *--------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *------------------------------------
+ * For end checkpoint type log record, prevLSN is the lsn of the matching begin checkpoint record. Large tables are
+ * split over several end checkpoint records of the same checkpoint
+ *--------------------------------------------------------------------------------------------
+ * | HEADER | num_txns | (txn_id, last_lsn) * num_txns | num_pages | (page_id, rec_lsn) * num_pages |
+ *--------------------------------------------------------------------------------------------
+ * For compensation log record, the change is laid out as in a record of its type without the header. undoNextLSN is
+ * the prevLSN of the undone record, i.e. the next record of the transaction to undo. The index logs the pages it
+ * changes to undo an index entry record itself, its CLR carries a page delta of no pages.
+ *-------------------------------------------------------
+ * | HEADER | undoNextLSN | change_type | change_data |
+ *-------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
+  friend class LogReader;
 
  public:
   LogRecord() = default;
@@ -85,15 +133,17 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
   }
 
-  // constructor for UPDATE type
+  // constructor for UPDATE type, the record becomes an UPDATE_DELTA record if that is smaller
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
             const Tuple &old_tuple, const Tuple &new_tuple)
-      : txn_id_(txn_id),
-        prev_lsn_(prev_lsn),
-        log_record_type_(log_record_type),
-        update_rid_(update_rid),
-        old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type), update_rid_(update_rid) {
+    if (old_tuple.GetLength() == new_tuple.GetLength() && EncodeDelta(old_tuple, new_tuple)) {
+      log_record_type_ = LogRecordType::UPDATE_DELTA;
+      size_ = HEADER_SIZE + sizeof(RID) + GetDeltaSize();
+      return;
+    }
+    old_tuple_ = old_tuple;
+    new_tuple_ = new_tuple;
     // calculate log record size
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
@@ -110,8 +160,70 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for END_CHECKPOINT type
+  LogRecord(lsn_t begin_checkpoint_lsn, std::vector<std::pair<txn_id_t, lsn_t>> active_txns,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : prev_lsn_(begin_checkpoint_lsn),
+        log_record_type_(LogRecordType::END_CHECKPOINT),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    size_ = HEADER_SIZE + 2 * sizeof(int32_t) + active_txns_.size() * (sizeof(txn_id_t) + sizeof(lsn_t)) +
+            dirty_pages_.size() * (sizeof(page_id_t) + sizeof(lsn_t));
+  }
+
+  // constructor for PAGE_DELTA type, it belongs to no transaction and is never undone
+  explicit LogRecord(std::vector<PageDelta> page_deltas)
+      : log_record_type_(LogRecordType::PAGE_DELTA), page_deltas_(std::move(page_deltas)) {
+    size_ = HEADER_SIZE + sizeof(int32_t);
+    for (const auto &delta : page_deltas_) {
+      size_ += sizeof(page_id_t) + sizeof(int32_t) + delta.ranges_.size() * 2 * sizeof(uint32_t) + delta.data_.size();
+    }
+  }
+
+  // constructor for INDEX_INSERT/INDEX_DELETE type, page_deltas are the changes to the bucket of the entry
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t directory_page_id,
+            std::vector<char> index_key, const RID &index_rid, std::vector<PageDelta> page_deltas)
+      : LogRecord(std::move(page_deltas)) {
+    assert(log_record_type == LogRecordType::INDEX_INSERT || log_record_type == LogRecordType::INDEX_DELETE);
+    txn_id_ = txn_id;
+    prev_lsn_ = prev_lsn;
+    log_record_type_ = log_record_type;
+    index_page_id_ = directory_page_id;
+    index_key_ = std::move(index_key);
+    index_rid_ = index_rid;
+    size_ += sizeof(page_id_t) + sizeof(int32_t) + index_key_.size() + sizeof(RID);
+  }
+
+  // constructor for CLR type, change is a record of the change that undid the record logged before undo_next_lsn
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, lsn_t undo_next_lsn, const LogRecord &change) : LogRecord(change) {
+    lsn_ = INVALID_LSN;
+    txn_id_ = txn_id;
+    prev_lsn_ = prev_lsn;
+    log_record_type_ = LogRecordType::CLR;
+    undo_next_lsn_ = undo_next_lsn;
+    change_type_ = change.log_record_type_;
+    size_ = change.size_ + sizeof(lsn_t) + sizeof(LogRecordType);
+  }
+
   ~LogRecord() = default;
 
+  /**
+   * Computes what changed in a page.
+   * @param page_id the page
+   * @param before the page data before the change
+   * @param after the page data after the change
+   * @return the changed ranges of the page with their contents in after
+   */
+  static auto MakePageDelta(page_id_t page_id, const char *before, const char *after) -> PageDelta {
+    PageDelta delta;
+    delta.page_id_ = page_id;
+    DiffRanges(before, after, PAGE_SIZE, &delta.ranges_);
+    for (const auto &[offset, length] : delta.ranges_) {
+      delta.data_.insert(delta.data_.end(), after + offset, after + offset + length);
+    }
+    return delta;
+  }
+
   inline auto GetDeleteTuple() -> Tuple & { return delete_tuple_; }
 
   inline auto GetDeleteRID() -> RID & { return delete_rid_; }
@@ -126,8 +238,16 @@ class LogRecord {
 
   inline auto GetUpdateRID() -> RID & { return update_rid_; }
 
+  inline auto GetDeltaRanges() -> std::vector<std::pair<uint32_t, uint32_t>> & { return delta_ranges_; }
+
+  inline auto GetPageDeltas() -> std::vector<PageDelta> & { return page_deltas_; }
+
   inline auto GetNewPageRecord() -> page_id_t { return prev_page_id_; }
 
+  inline auto GetActiveTxns() -> std::vector<std::pair<txn_id_t, lsn_t>> & { return active_txns_; }
+
+  inline auto GetDirtyPages() -> std::vector<std::pair<page_id_t, lsn_t>> & { return dirty_pages_; }
+
   inline auto GetSize() -> int32_t { return size_; }
 
   inline auto GetLSN() -> lsn_t { return lsn_; }
@@ -138,6 +258,25 @@ class LogRecord {
 
   inline auto GetLogRecordType() -> LogRecordType & { return log_record_type_; }
 
+  inline auto GetUndoNextLSN() -> lsn_t { return undo_next_lsn_; }
+
+  inline auto GetIndexKey() -> std::vector<char> & { return index_key_; }
+
+  inline auto GetIndexRID() -> RID & { return index_rid_; }
+
+  /** @return the type of the change redo replays, for a CLR the type of the change it logs */
+  inline auto GetRedoType() const -> LogRecordType {
+    switch (log_record_type_) {
+      case LogRecordType::CLR:
+        return change_type_;
+      case LogRecordType::INDEX_INSERT:
+      case LogRecordType::INDEX_DELETE:
+        return LogRecordType::PAGE_DELTA;
+      default:
+        return log_record_type_;
+    }
+  }
+
   // For debug purpose
   inline auto ToString() const -> std::string {
     std::ostringstream os;
@@ -152,6 +291,56 @@ class LogRecord {
   }
 
  private:
+  /** Changed bytes closer than this are logged as one range, a range header costs as much. */
+  static constexpr uint32_t DELTA_MERGE_GAP = 2 * sizeof(uint32_t);
+
+  /** Appends the (offset, length) of the ranges in which two byte arrays of the given length differ. */
+  static void DiffRanges(const char *old_data, const char *new_data, uint32_t length,
+                         std::vector<std::pair<uint32_t, uint32_t>> *ranges) {
+    uint32_t start = 0;
+    while (start < length) {
+      if (old_data[start] == new_data[start]) {
+        start++;
+        continue;
+      }
+      uint32_t end = start + 1;
+      for (uint32_t i = end; i < length && i - end < DELTA_MERGE_GAP; i++) {
+        if (old_data[i] != new_data[i]) {
+          end = i + 1;
+        }
+      }
+      ranges->emplace_back(start, end - start);
+      start = end;
+    }
+  }
+
+  /**
+   * Collects the byte ranges in which two tuples of the same size differ.
+   * @return false if logging the ranges would not be smaller than logging both tuples
+   */
+  auto EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple) -> bool {
+    const char *old_data = old_tuple.GetData();
+    const char *new_data = new_tuple.GetData();
+    uint32_t length = old_tuple.GetLength();
+    DiffRanges(old_data, new_data, length, &delta_ranges_);
+    for (const auto &[offset, range_length] : delta_ranges_) {
+      delta_old_.insert(delta_old_.end(), old_data + offset, old_data + offset + range_length);
+      delta_new_.insert(delta_new_.end(), new_data + offset, new_data + offset + range_length);
+    }
+    if (GetDeltaSize() < 2 * (sizeof(int32_t) + length)) {
+      return true;
+    }
+    delta_ranges_.clear();
+    delta_old_.clear();
+    delta_new_.clear();
+    return false;
+  }
+
+  /** @return the size of the delta payload after the rid */
+  auto GetDeltaSize() const -> uint32_t {
+    return sizeof(int32_t) + delta_ranges_.size() * 2 * sizeof(uint32_t) + delta_old_.size() + delta_new_.size();
+  }
+
   // the length of log record(for serialization, in bytes)
   int32_t size_{0};
   // must have fields
@@ -173,9 +362,30 @@ class LogRecord {
   Tuple old_tuple_;
   Tuple new_tuple_;
 
+  // case3b: for delta update operation, the changed ranges and their bytes before and after the update
+  std::vector<std::pair<uint32_t, uint32_t>> delta_ranges_;
+  std::vector<char> delta_old_;
+  std::vector<char> delta_new_;
+
+  // case3c: for page delta operation
+  std::vector<PageDelta> page_deltas_;
+
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case5: for end checkpoint operation
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+
+  // case6: for compensation log records, the change itself is kept in the fields of its type
+  lsn_t undo_next_lsn_{INVALID_LSN};
+  LogRecordType change_type_{LogRecordType::INVALID};
+
+  // case7: for index entry operation, the index by its directory page and the entry, the bucket changes are in case3c
+  page_id_t index_page_id_{INVALID_PAGE_ID};
+  std::vector<char> index_key_;
+  RID index_rid_;
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
@@ -13,23 +13,74 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "recovery/log_manager.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
+/** Counters of the last Redo/Undo run. */
+struct RecoveryStatistics {
+  /** The log offset redo started scanning at, non-zero when it could start at a checkpoint. */
+  uint64_t start_offset_{0};
+  /** Number of log bytes scanned by redo. */
+  uint64_t log_bytes_{0};
+  /** Number of log records scanned by redo. */
+  uint64_t num_records_{0};
+  /** Number of records whose page was older than the record, i.e. that were actually replayed. */
+  uint64_t num_redone_{0};
+  /** Number of records rolled back by undo. */
+  uint64_t num_undone_{0};
+  std::chrono::microseconds redo_time_{0};
+  std::chrono::microseconds undo_time_{0};
+
+  /** @return the redo throughput in MB of log per second */
+  auto RedoThroughput() const -> double {
+    return redo_time_.count() == 0 ? 0 : static_cast<double>(log_bytes_) / static_cast<double>(redo_time_.count());
+  }
+};
+
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo streams the log sequentially through a LogReader on the calling thread, which also does the analysis (building
+ * active_txn_ and lsn_mapping_). If the master record points at a checkpoint, the scan starts early enough to see every
+ * record of the transactions active at the checkpoint, and records older than the smallest recovery lsn of its dirty
+ * page table are not replayed. Every record that touches a page is handed to one of the redo workers, chosen by page
+ * id, so the records of a page are replayed in lsn order while different pages are replayed concurrently.
+ *
+ * Undo rolls back the loser transactions together, newest record first, and logs every change it makes as a CLR. The
+ * entries they inserted into or removed from hash indexes are removed or put back through the index.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /**
+   * @param disk_manager the disk manager holding the log
+   * @param buffer_pool_manager the buffer pool the pages are replayed into
+   * @param log_manager the log manager the CLRs and ABORT records of undo are appended to
+   * @param num_workers the number of redo threads, 0 to use one per core
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager,
+              size_t num_workers = 0)
+      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), log_manager_(log_manager), offset_(0) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
+    if (num_workers == 0) {
+      num_workers = std::thread::hardware_concurrency();
+    }
+    // Every worker pins one page at a time, leave the rest of the pool for the undo phase.
+    num_workers_ = std::max<size_t>(1, std::min(num_workers, buffer_pool_manager->GetPoolSize() / 2));
   }
 
   ~LogRecovery() {
@@ -41,17 +92,81 @@ class LogRecovery {
   void Undo();
   auto DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool;
 
+  /** @return the counters of the last Redo/Undo run */
+  auto GetStatistics() const -> const RecoveryStatistics & { return stats_; }
+
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** A record to replay, or for NEWPAGE records the link from the previous page to the new one. */
+  struct RedoTask {
+    LogRecord log_record_;
+    bool link_prev_page_;
+    /** The page of a PAGE_DELTA record this task replays. */
+    size_t page_delta_index_{0};
+  };
+
+  /** The queue of records for one redo worker. */
+  struct RedoPartition {
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::deque<RedoTask> tasks_;
+    bool done_{false};
+  };
+
+  /** Upper bound on the records queued per worker, so that redo does not read the whole log into memory. */
+  static constexpr size_t MAX_QUEUED_TASKS = 4096;
+
+  /** Queues a task for the worker that owns page_id. */
+  void Dispatch(page_id_t page_id, RedoTask task);
 
-  /** Maintain active transactions and its corresponding latest lsn. */
+  /** Body of a redo worker, replays the tasks of one partition until it is done. */
+  void RunRedoWorker(RedoPartition *partition);
+
+  /**
+   * Replays a single record if the page does not reflect it yet.
+   * @return true if the record was applied, always false for the link of a NEWPAGE record
+   */
+  auto RedoRecord(RedoTask *task) -> bool;
+
+  /**
+   * Applies the change of an INSERT, delete, UPDATE or UPDATE_DELTA record, or of a CLR, to its page. An insert without
+   * a rid takes the first free slot and stores it in the record.
+   */
+  static void ApplyChange(TablePage *page, LogRecord *log_record);
+
+  /**
+   * Rolls back a single record of an uncommitted transaction and logs a CLR for it.
+   * @return false if there was nothing to roll back
+   */
+  auto UndoRecord(LogRecord *log_record) -> bool;
+
+  /**
+   * Rolls back an index entry record by removing the entry again or putting it back, and logs a CLR for it.
+   * @return false if the index was already rolled back
+   */
+  auto UndoIndexRecord(LogRecord *log_record) -> bool;
+
+  /** Undoes the entry of an index entry record in the hash index of generic keys of KeySize bytes. */
+  template <size_t KeySize>
+  auto UndoIndexChange(LogRecord *log_record) -> bool;
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
+  size_t num_workers_;
+
+  /** Maintain active transactions and its corresponding latest lsn, including the CLRs written by undo. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  std::unordered_map<lsn_t, int64_t> lsn_mapping_;
 
-  int offset_ __attribute__((__unused__));  // NOLINT
+  /** The log offset redo has scanned up to. */
+  int64_t offset_;
+  /** Holds the single records read by undo. */
   char *log_buffer_;
+
+  std::vector<std::unique_ptr<RedoPartition>> partitions_;
+  std::atomic<uint64_t> num_redone_{0};
+  RecoveryStatistics stats_;
 };
 
 }  // namespace bustub
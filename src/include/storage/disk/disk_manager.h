@@ -17,14 +17,35 @@
 #include <future>  // NOLINT
 #include <mutex>   // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
 
 namespace bustub {
 
+/**
+ * The master record tells recovery where the last complete checkpoint is and where to start reading the log.
+ */
+struct MasterRecord {
+  /** The lsn of the BEGIN_CHECKPOINT record. */
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  /** Records before this lsn are already reflected in the database file. */
+  lsn_t redo_lsn_{INVALID_LSN};
+  /** The log offset at which recovery starts scanning, and the lsn of the record found there. */
+  int64_t scan_offset_{0};
+  lsn_t scan_lsn_{INVALID_LSN};
+};
+
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is one logical byte stream split into segment files of log_segment_size bytes: segment 0 is "<db>.log" and
+ * segment n is "<db>.log.<n>". Segments that lie entirely before the truncation point are not needed by recovery any
+ * more and are renamed to "<db>.log.free.<n>", to be reused for the next segment instead of creating a new file. A
+ * reused file keeps its size and blocks and is overwritten in place, so the last segment may hold stale records behind
+ * the end of the log. The size of the last segment is then too large a guess for the end; LogManager::ResumeLog cuts
+ * the log back to the last record that continues the lsns.
  */
 class DiskManager {
  public:
@@ -32,35 +53,35 @@ class DiskManager {
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, int log_segment_size = LOG_SEGMENT_SIZE);
 
-  ~DiskManager() = default;
+  virtual ~DiskManager();
 
   /**
    * Shut down the disk manager and close all the file resources.
    */
-  void ShutDown();
+  virtual void ShutDown();
 
   /**
    * Write a page to the database file.
    * @param page_id id of the page
    * @param page_data raw page data
    */
-  void WritePage(page_id_t page_id, const char *page_data);
+  virtual void WritePage(page_id_t page_id, const char *page_data);
 
   /**
    * Read a page from the database file.
    * @param page_id id of the page
    * @param[out] page_data output buffer
    */
-  void ReadPage(page_id_t page_id, char *page_data);
+  virtual void ReadPage(page_id_t page_id, char *page_data);
 
   /**
    * Flush the entire log buffer into disk.
    * @param log_data raw log data
    * @param size size of log entry
    */
-  void WriteLog(char *log_data, int size);
+  virtual void WriteLog(char *log_data, int size);
 
   /**
    * Read a log entry from the log file.
@@ -69,7 +90,41 @@ class DiskManager {
    * @param offset offset of the log entry in the file
    * @return true if the read was successful, false otherwise
    */
-  auto ReadLog(char *log_data, int size, int offset) -> bool;
+  virtual auto ReadLog(char *log_data, int size, int64_t offset) -> bool;
+
+  /**
+   * Give up the log before offset. Only whole segments are recycled, the segment being appended to is always kept.
+   * @param offset the smallest log offset that must stay readable
+   */
+  virtual void TruncateLog(int64_t offset);
+
+  /**
+   * Cut the log back to offset, e.g. to drop a torn record at its end before appending behind it.
+   * @param offset the new end of the log, at most the current one
+   */
+  virtual void SetLogEndOffset(int64_t offset);
+
+  /** @return the offset of the first log byte that can still be read */
+  virtual auto GetLogStartOffset() -> int64_t;
+
+  /** @return the offset the next log write goes to */
+  virtual auto GetLogEndOffset() -> int64_t;
+
+  /**
+   * Durably replace the master record.
+   * @param master_record the new master record
+   */
+  virtual void WriteMasterRecord(const MasterRecord &master_record);
+
+  /**
+   * Read the master record.
+   * @param[out] master_record the master record
+   * @return false if no checkpoint was ever recorded
+   */
+  virtual auto ReadMasterRecord(MasterRecord *master_record) -> bool;
+
+  /** @return the number of pages the database already holds, so that new pages can be allocated past them */
+  virtual auto GetNumPages() const -> page_id_t;
 
   /** @return the number of disk flushes */
   auto GetNumFlushes() const -> int;
@@ -89,20 +144,53 @@ class DiskManager {
   /** Checks if the non-blocking flush future was set. */
   inline auto HasFlushLogFuture() -> bool { return flush_log_f_ != nullptr; }
 
- private:
-  auto GetFileSize(const std::string &file_name) -> int;
-  // stream to write log file
-  std::fstream log_io_;
+ protected:
+  /** Subclasses that manage their own storage skip opening the database and log files. */
+  DiskManager() = default;
+
+  /**
+   * Open (or create) the log file next to file_name_.
+   * @return false if no log file name can be derived from file_name_
+   */
+  auto OpenLogFile() -> bool;
+
+  /** Close the log segments opened by OpenLogFile. */
+  void CloseLogFiles();
+
+  auto GetFileSize(const std::string &file_name) const -> int;
+  // first segment of the log, the others get their segment number appended
   std::string log_name_;
+  // the master record lives in its own small file next to the log
+  std::string master_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
   int num_flushes_{0};
-  int num_writes_{0};
+  std::atomic<int> num_writes_{0};
   bool flush_log_{false};
   std::future<void> *flush_log_f_{nullptr};
   // With multiple buffer pool instances, need to protect file access
   std::mutex db_io_latch_;
+
+ private:
+  auto GetLogSegmentName(int segment) const -> std::string;
+  auto GetFreeLogSegmentName(int segment) const -> std::string;
+
+  /** Starts segment number segment, reusing a free segment file as it is if there is one. */
+  auto CreateLogSegment(int segment) -> int;
+
+  int log_segment_size_{LOG_SEGMENT_SIZE};
+  // protects everything below
+  std::mutex log_io_latch_;
+  // descriptor of the segment being appended to, and a cached descriptor for reading
+  int log_fd_{-1};
+  int log_read_fd_{-1};
+  int log_read_segment_{-1};
+  // the log offsets [log_start_offset_, log_end_offset_) are on disk
+  int64_t log_start_offset_{0};
+  int64_t log_end_offset_{0};
+  // segment numbers of the recycled files
+  std::vector<int> free_log_segments_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,91 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// mmap_disk_manager.h
+//
+// Identification: src/include/storage/disk/mmap_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * MmapDiskManager serves pages of a read-only database file straight out of a shared memory mapping. Reads are a
+ * single memcpy out of the page cache without any seek, read syscall or I/O latch, which makes it a good fit for
+ * reporting replicas. Because the file is never written, there is no write ordering to worry about.
+ *
+ * Sequential page reads are detected on the fly and the kernel is asked (madvise WILLNEED) to fault in the next
+ * window of the file before the scan gets there. That is the only hint given: scans go through the buffer pool, which
+ * does not know what backs it. Pages are still copied into buffer pool frames, since Page keeps its data inline.
+ */
+class MmapDiskManager : public DiskManager {
+ public:
+  /**
+   * Maps an existing database file read-only.
+   * @param db_file the file name of the database file to map
+   */
+  explicit MmapDiskManager(const std::string &db_file);
+
+  ~MmapDiskManager() override;
+
+  /**
+   * Unmap the database file and close the file descriptor.
+   */
+  void ShutDown() override;
+
+  /** The database is read-only, always throws. */
+  void WritePage(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Copy a page out of the mapping. Reading past the end of the file yields a zeroed page.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPage(page_id_t page_id, char *page_data) override;
+
+  /** The database is read-only, always throws. */
+  void WriteLog(char *log_data, int size) override;
+
+  /** A read-only database has no log to replay, always returns false. */
+  auto ReadLog(char *log_data, int size, int64_t offset) -> bool override;
+
+  /** @return the number of whole pages in the mapped file */
+  auto GetNumPages() const -> page_id_t override { return static_cast<page_id_t>(file_size_ / PAGE_SIZE); }
+
+ private:
+  /** Number of pages to prefetch ahead of a detected sequential scan. */
+  static constexpr int READAHEAD_PAGES = 64;
+
+  /**
+   * @param page_id id of the page
+   * @return pointer to the page inside the mapping, nullptr if the page lies past the end of the file
+   */
+  auto GetPageView(page_id_t page_id) const -> const char *;
+
+  /**
+   * Hint that the given range of pages will be read soon.
+   * @param first_page_id the first page of the range
+   * @param num_pages the number of pages in the range
+   */
+  void Prefetch(page_id_t first_page_id, int num_pages);
+
+  int fd_{-1};
+  char *data_{nullptr};
+  size_t file_size_{0};
+  /** The last page handed out, used to detect sequential scans. */
+  std::atomic<page_id_t> last_read_page_id_{INVALID_PAGE_ID};
+  /** Pages below this id have already been prefetched. */
+  std::atomic<page_id_t> prefetched_until_{0};
+};
+
+}  // namespace bustub
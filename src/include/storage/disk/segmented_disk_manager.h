@@ -0,0 +1,97 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// segmented_disk_manager.h
+//
+// Identification: src/include/storage/disk/segmented_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * SegmentedDiskManager splits the database into fixed-size segment files instead of one big file. Page P lives in
+ * segment P / pages_per_segment at offset (P % pages_per_segment) * PAGE_SIZE, and segments are placed round-robin
+ * over a list of directories, so a large table can be striped across several devices.
+ *
+ * Every segment has its own file descriptor and is accessed with pread/pwrite, hence there is no shared file cursor
+ * and no I/O latch: requests to different segments (and different pages of the same segment) run in parallel.
+ *
+ * The log is kept in segment files next to the database file name, exactly like DiskManager.
+ */
+class SegmentedDiskManager : public DiskManager {
+ public:
+  /** 1 GB segments by default. */
+  static constexpr int DEFAULT_PAGES_PER_SEGMENT = (1 << 30) / PAGE_SIZE;
+
+  /**
+   * Creates a new segmented disk manager.
+   * @param db_file the database file name, segment files are named "<db_file basename>.<segment number>"
+   * @param directories the directories the segments are spread over, empty to keep them next to db_file
+   * @param pages_per_segment the number of pages in each segment file
+   */
+  explicit SegmentedDiskManager(const std::string &db_file, std::vector<std::string> directories = {},
+                                int pages_per_segment = DEFAULT_PAGES_PER_SEGMENT);
+
+  ~SegmentedDiskManager() override;
+
+  /**
+   * Close all the segment files and the log file.
+   */
+  void ShutDown() override;
+
+  /**
+   * Write a page to its segment file.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePage(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Read a page from its segment file.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPage(page_id_t page_id, char *page_data) override;
+
+  /** Pages are allocated in order, so all segments but the last one found on disk are full. */
+  auto GetNumPages() const -> page_id_t override;
+
+  /**
+   * @param segment_id the segment number
+   * @return the path of the segment file
+   */
+  auto GetSegmentFileName(size_t segment_id) const -> std::string;
+
+  /** @return the number of pages in each segment file */
+  auto GetPagesPerSegment() const -> int { return pages_per_segment_; }
+
+ private:
+  /**
+   * Returns the file descriptor of a segment, opening or creating the segment file on first use.
+   * @param segment_id the segment number
+   * @return the file descriptor of the segment
+   */
+  auto GetSegmentFd(size_t segment_id) -> int;
+
+  std::vector<std::string> directories_;
+  const int pages_per_segment_;
+  /** File descriptor of every segment opened so far, -1 for segments not opened yet. */
+  std::vector<int> segment_fds_;
+  /** Protects segment_fds_ itself, not the I/O on the descriptors. */
+  std::shared_mutex segment_latch_;
+};
+
+}  // namespace bustub
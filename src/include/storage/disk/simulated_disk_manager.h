@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// simulated_disk_manager.h
+//
+// Identification: src/include/storage/disk/simulated_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/** Describes how long a single simulated I/O takes before its data transfer starts. */
+struct LatencyDistribution {
+  enum class Kind { CONSTANT, UNIFORM, EXPONENTIAL };
+
+  Kind kind_{Kind::CONSTANT};
+  /** The mean latency. */
+  std::chrono::microseconds mean_{0};
+  /** Half-width of the latency interval around the mean, only used by UNIFORM. */
+  std::chrono::microseconds spread_{0};
+};
+
+/** Configuration of a SimulatedDiskManager. */
+struct SimulatedDiskOptions {
+  LatencyDistribution read_latency_;
+  LatencyDistribution write_latency_;
+  /** Maximum transfer rate of the device in bytes per second, 0 for unlimited. */
+  uint64_t bandwidth_bytes_per_sec_{0};
+  /**
+   * Maximum number of I/Os in flight, further requests wait for a free slot. 0 for unlimited. Without sleeping, I/Os
+   * are issued back to back and overlap as long as the queue has room.
+   */
+  uint32_t queue_depth_{0};
+  /** Seed of the latency generator, the same seed produces the same latencies. */
+  uint64_t seed_{0};
+  /** If false, latencies are only accounted for in the trace and the simulated clock, nobody actually sleeps. */
+  bool sleep_{true};
+  /** Record every I/O in the trace. */
+  bool trace_{true};
+};
+
+/** One I/O issued against a SimulatedDiskManager. */
+struct IoTraceEntry {
+  enum class Op { READ_PAGE, WRITE_PAGE, READ_LOG, WRITE_LOG };
+
+  Op op_;
+  /** The page accessed, INVALID_PAGE_ID for log I/O. */
+  page_id_t page_id_;
+  /** Number of bytes transferred. */
+  int size_;
+  /** Simulated time at which the I/O was issued, relative to the creation of the disk manager. */
+  std::chrono::microseconds issue_time_;
+  /** Simulated time the I/O took, including waiting for the bandwidth cap. */
+  std::chrono::microseconds latency_;
+};
+
+/**
+ * SimulatedDiskManager keeps the whole database and log in memory and charges every I/O a configurable latency,
+ * drawn from a seeded distribution, plus its transfer time under a bandwidth cap. At most queue_depth I/Os are in
+ * flight at once. This makes eviction policies, prefetching and group commit comparable across machines, since the
+ * host's page cache and device never get involved.
+ */
+class SimulatedDiskManager : public DiskManager {
+ public:
+  explicit SimulatedDiskManager(const SimulatedDiskOptions &options);
+
+  ~SimulatedDiskManager() override = default;
+
+  /** Nothing to close, the data stays available until the disk manager is destroyed. */
+  void ShutDown() override {}
+
+  void WritePage(page_id_t page_id, const char *page_data) override;
+
+  /** Reading a page that was never written yields a zeroed page. */
+  void ReadPage(page_id_t page_id, char *page_data) override;
+
+  void WriteLog(char *log_data, int size) override;
+
+  auto ReadLog(char *log_data, int size, int64_t offset) -> bool override;
+
+  /** The log is kept in memory as a whole, truncation is ignored. */
+  void TruncateLog(int64_t offset) override {}
+
+  void SetLogEndOffset(int64_t offset) override;
+
+  auto GetLogEndOffset() -> int64_t override;
+
+  void WriteMasterRecord(const MasterRecord &master_record) override;
+
+  auto ReadMasterRecord(MasterRecord *master_record) -> bool override;
+
+  /** @return one past the highest page id written so far */
+  auto GetNumPages() const -> page_id_t override;
+
+  /** @return a copy of the I/O trace recorded so far */
+  auto GetTrace() -> std::vector<IoTraceEntry>;
+
+  /** Forget all the I/Os recorded so far. */
+  void ClearTrace();
+
+  /** @return the simulated device time consumed so far, i.e. the sum of all I/O latencies */
+  auto GetSimulatedTime() -> std::chrono::microseconds;
+
+ private:
+  /**
+   * Charges one I/O: waits for a free queue slot, draws its latency, reserves its transfer on the bandwidth-capped
+   * channel, records it and sleeps for the resulting time if configured to.
+   */
+  void SimulateIo(IoTraceEntry::Op op, page_id_t page_id, int size);
+
+  auto DrawLatency(const LatencyDistribution &distribution) -> std::chrono::microseconds;
+
+  const SimulatedDiskOptions options_;
+  const std::chrono::steady_clock::time_point start_time_;
+
+  /** Protects pages_, log_ and the master record. */
+  mutable std::mutex data_latch_;
+  std::unordered_map<page_id_t, std::unique_ptr<char[]>> pages_;
+  std::vector<char> log_;
+  bool has_master_record_{false};
+  MasterRecord master_record_;
+
+  /** Protects everything below. */
+  std::mutex io_latch_;
+  std::condition_variable queue_cv_;
+  uint32_t in_flight_{0};
+  std::mt19937_64 rng_;
+  /** The simulated clock when not sleeping: when the next I/O is issued. */
+  std::chrono::microseconds clock_{0};
+  /** Simulated completion times of the I/Os in flight when not sleeping, earliest first. */
+  std::priority_queue<std::chrono::microseconds, std::vector<std::chrono::microseconds>,
+                      std::greater<std::chrono::microseconds>>
+      completions_;
+  /** Simulated time at which the transfer channel becomes idle again. */
+  std::chrono::microseconds channel_free_time_{0};
+  std::chrono::microseconds simulated_time_{0};
+  std::vector<IoTraceEntry> trace_;
+};
+
+}  // namespace bustub
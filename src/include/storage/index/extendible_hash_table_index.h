@@ -17,6 +17,7 @@
 #include <string>
 #include <vector>
 
+#include "concurrency/lock_manager.h"
 #include "container/hash/extendible_hash_table.h"
 #include "container/hash/hash_function.h"
 #include "storage/index/index.h"
@@ -28,8 +29,14 @@ namespace bustub {
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTableIndex : public Index {
  public:
+  /**
+   * Create a new index. With a lock manager, ScanKey shares the lock on the bucket of the key for repeatable reads, see
+   * LockManager::LockIndexKey; the executors lock the buckets of the entries they add or remove.
+   * @param index_oid the oid of the index in the catalog, which names its buckets in the lock manager
+   */
   ExtendibleHashTableIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
-                           const HashFunction<KeyType> &hash_fn);
+                           const HashFunction<KeyType> &hash_fn, LogManager *log_manager = nullptr,
+                           LockManager *lock_manager = nullptr, index_oid_t index_oid = 0);
 
   ~ExtendibleHashTableIndex() override = default;
 
@@ -42,6 +49,9 @@ class ExtendibleHashTableIndex : public Index {
  protected:
   // comparator for key
   KeyComparator comparator_;
+  // lock manager for the key buckets, nullptr to lock nothing
+  LockManager *lock_manager_;
+  index_oid_t index_oid_;
   // container
   ExtendibleHashTable<KeyType, ValueType, KeyComparator> container_;
 };
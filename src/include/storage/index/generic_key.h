@@ -77,6 +77,10 @@ template <size_t KeySize>
 class GenericComparator {
  public:
   inline auto operator()(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs) const -> int {
+    // Without a key schema the keys can only be told apart by their bytes, enough to find equal keys.
+    if (key_schema_ == nullptr) {
+      return memcmp(lhs.data_, rhs.data_, KeySize);
+    }
     uint32_t column_count = key_schema_->GetColumnCount();
 
     for (uint32_t i = 0; i < column_count; i++) {
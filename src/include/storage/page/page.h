@@ -66,6 +66,12 @@ class Page {
   /** Sets the page LSN. */
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
 
+  /** Sets the lsn of the last PAGE_DELTA record that changed the page. */
+  inline void SetDeltaLSN(lsn_t lsn) {
+    delta_lsn_ = lsn;
+    delta_logged_ = true;
+  }
+
  protected:
   static_assert(sizeof(page_id_t) == 4);
   static_assert(sizeof(lsn_t) == 4);
@@ -78,6 +84,9 @@ class Page {
   /** Zeroes out the data that is held within the page. */
   inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }
 
+  /** @return the lsn of the last log record that changed the page, which must be persistent before the page is. */
+  inline auto GetLastLoggedLSN() -> lsn_t { return delta_logged_ ? delta_lsn_ : GetLSN(); }
+
   /** The actual data that is stored within a page. */
   char data_[PAGE_SIZE]{};
   /** The ID of this page. */
@@ -86,6 +95,18 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /**
+   * Recovery lsn: a lower bound of the lsns that modified the page since it was last written. INVALID_LSN if the page
+   * is clean and unpinned.
+   */
+  lsn_t rec_lsn_ = INVALID_LSN;
+  /**
+   * The lsn of the last PAGE_DELTA record that changed the page. Index pages have no room for a page LSN, so it is
+   * only kept in memory, for write-ahead logging.
+   */
+  lsn_t delta_lsn_ = INVALID_LSN;
+  /** True if the page is logged with PAGE_DELTA records, its bytes at OFFSET_LSN are then data, not a page LSN. */
+  bool delta_logged_ = false;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
@@ -13,6 +13,8 @@
 #pragma once
 
 #include <cstring>
+#include <utility>
+#include <vector>
 
 #include "common/rid.h"
 #include "concurrency/lock_manager.h"
@@ -113,6 +115,23 @@ class TablePage : public Page {
   /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. */
   void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
 
+  /**
+   * Overwrite byte ranges of a tuple in place, the tuple keeps its size. Used by recovery to redo and undo
+   * UPDATE_DELTA log records.
+   * @param rid rid of the tuple
+   * @param ranges the (offset in the tuple, length) of every range
+   * @param data the bytes of all the ranges, concatenated in range order
+   */
+  void ApplyTupleDelta(const RID &rid, const std::vector<std::pair<uint32_t, uint32_t>> &ranges, const char *data);
+
+  /**
+   * Put a tuple into the empty slot of rid, which reverses an ApplyDelete. Used by recovery to redo inserts and to
+   * undo APPLYDELETE log records, so that the tuple gets back the rid later log records name it by.
+   * @param rid rid of the tuple, its slot is empty or the next one after the last
+   * @param tuple the tuple to put back
+   */
+  void RestoreTuple(const RID &rid, const Tuple &tuple);
+
   /**
    * Read a tuple from a table.
    * @param rid rid of the tuple to read
@@ -123,6 +142,20 @@ class TablePage : public Page {
    */
   auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) -> bool;
 
+  /**
+   * Copy a tuple out of the page without locking it. The caller holds the page latch.
+   * @param rid rid of the tuple to read
+   * @param[out] tuple the tuple that was read
+   * @return true if the slot holds a tuple
+   */
+  auto ReadTuple(const RID &rid, Tuple *tuple) -> bool;
+
+  /**
+   * @note returned tuple count may be an overestimate because some slots may be empty
+   * @return at least the number of tuples in this page
+   */
+  auto GetTupleCount() -> uint32_t { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_TUPLE_COUNT); }
+
   /** @return the rid of the first tuple in this page */
 
   /**
@@ -158,12 +191,6 @@ class TablePage : public Page {
     memcpy(GetData() + OFFSET_FREE_SPACE, &free_space_pointer, sizeof(uint32_t));
   }
 
-  /**
-   * @note returned tuple count may be an overestimate because some slots may be empty
-   * @return at least the number of tuples in this page
-   */
-  auto GetTupleCount() -> uint32_t { return *reinterpret_cast<uint32_t *>(GetData() + OFFSET_TUPLE_COUNT); }
-
   /** Set the number of tuples in this page. */
   void SetTupleCount(uint32_t tuple_count) { memcpy(GetData() + OFFSET_TUPLE_COUNT, &tuple_count, sizeof(uint32_t)); }
 
@@ -12,11 +12,15 @@
 
 #pragma once
 
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "storage/table/tuple_versions.h"
+#include "storage/table/version_store.h"
 
 namespace bustub {
 
@@ -60,7 +64,8 @@ class TableHeap {
   auto InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> bool;
 
   /**
-   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
+   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called. An optimistic transaction only
+   * buffers the delete until it commits.
    * @param rid resource id of the tuple of delete
    * @param txn transaction performing the delete
    * @return true iff the delete is successful (i.e the tuple exists)
@@ -69,6 +74,7 @@ class TableHeap {
 
   /**
    * if the new tuple is too large to fit in the old page, return false (will delete and insert)
+   * An optimistic transaction only buffers the update until it commits.
    * @param tuple new tuple
    * @param rid rid of the old tuple
    * @param txn transaction performing the update
@@ -91,7 +97,25 @@ class TableHeap {
   void RollbackDelete(const RID &rid, Transaction *txn);
 
   /**
-   * Read a tuple from the table.
+   * Called on commit to actually delete the tuples txn marked deleted on one page, under a single fetch and latch.
+   * @param page_id the page holding the tuples
+   * @param rids the tuples to delete
+   * @param txn the committing transaction
+   */
+  void ApplyDeletes(page_id_t page_id, const std::vector<RID> &rids, Transaction *txn);
+
+  /**
+   * Called on abort to undo the writes txn made on one page, under a single fetch and latch.
+   * @param page_id the page holding the tuples
+   * @param records the write records of the page, newest first
+   * @param txn the aborting transaction
+   */
+  void RollbackWrites(page_id_t page_id, const std::vector<const TableWriteRecord *> &records, Transaction *txn);
+
+  /**
+   * Read a tuple from the table. An optimistic transaction reads without locking, sees its own buffered writes and
+   * remembers the version of the tuple; it is aborted if another transaction is changing the tuple. A read-only
+   * transaction reads its snapshot.
    * @param rid rid of the tuple to read
    * @param tuple output variable for the tuple
    * @param txn transaction performing the read
@@ -99,6 +123,29 @@ class TableHeap {
    */
   auto GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
 
+  /**
+   * Read the version of a tuple visible to the snapshot of txn, without locking it.
+   * @param rid rid of the tuple to read
+   * @param tuple output variable for the tuple
+   * @param txn the snapshot transaction
+   * @return true if a version of the tuple is visible to txn
+   */
+  auto GetSnapshotTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
+
+  /**
+   * Advance to the next slot of the table, deleted or not. Snapshot reads walk the slots since a tuple deleted in the
+   * heap may still be visible to them.
+   * @param[in,out] rid the current slot, a default-constructed RID to start at the first slot
+   * @return false past the last slot
+   */
+  auto NextSlot(RID *rid) -> bool;
+
+  /** @return the prior versions of the tuples of this table */
+  auto GetVersionStore() -> VersionStore * { return &versions_; }
+
+  /** @return the version counters of the tuples of this table */
+  auto GetTupleVersions() -> TupleVersions * { return &tuple_versions_; }
+
   /** @return the begin iterator of this table */
   auto Begin(Transaction *txn) -> TableIterator;
 
@@ -109,10 +156,20 @@ class TableHeap {
   inline auto GetFirstPageId() const -> page_id_t { return first_page_id_; }
 
  private:
+  /** @return true if the writes of txn are buffered, i.e. it is optimistic and has not started to commit */
+  static auto IsBuffering(Transaction *txn) -> bool {
+    return txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC && txn->GetState() == TransactionState::GROWING;
+  }
+
+  /** GetTuple for an optimistic transaction. */
+  auto GetOptimisticTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool;
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  VersionStore versions_;
+  TupleVersions tuple_versions_;
 };
 
 }  // namespace bustub
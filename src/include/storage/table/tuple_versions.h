@@ -0,0 +1,95 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_versions.h
+//
+// Identification: src/include/storage/table/tuple_versions.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/**
+ * TupleVersions counts the committed changes to each tuple of one table, for the optimistic transactions to validate
+ * their reads against.
+ *
+ * Every change to a slot of the table heap marks the slot with the changing transaction until it commits or aborts,
+ * which gives the slot a new version, unique within the table. A read stays valid as long as the slot has the version
+ * read and no other transaction has changed it since. Slots without an entry are at version 0.
+ *
+ * An entry is dropped once every running optimistic transaction began after its last change: none of them can have
+ * read an older version, so whatever version they read, no change came after it. A read of a slot whose entry is gone
+ * is therefore valid, and a slot changed again gets a new entry with a version no read has seen.
+ */
+class TupleVersions {
+ public:
+  /**
+   * Read the version of rid.
+   * @param[out] version the version of rid
+   * @return false if another transaction changed rid and has not committed yet
+   */
+  auto Read(const RID &rid, Transaction *txn, uint64_t *version) -> bool;
+
+  /** Mark rid as changed by txn. Called with the page of rid latched, before the change is visible. */
+  void Write(const RID &rid, Transaction *txn);
+
+  /**
+   * Clear the mark txn left on rid at commit or abort, making its change a new version.
+   * @param ts the commit timestamp of txn, or the last commit timestamp when it aborts
+   */
+  void Release(const RID &rid, Transaction *txn, timestamp_t ts);
+
+  /** @return true if rid is still at version and no other transaction changed it since */
+  auto Validate(const RID &rid, Transaction *txn, uint64_t version) -> bool;
+
+  /** Drop the entries last changed at or before watermark, the oldest read timestamp of the optimistic transactions. */
+  void Collect(timestamp_t watermark);
+
+  /** @return the number of slots with an entry */
+  auto Size() -> size_t;
+
+ private:
+  static constexpr size_t NUM_PARTITIONS = 16;
+
+  struct Entry {
+    uint64_t version_{0};
+    /** The transaction with an uncommitted change to the tuple, INVALID_TXN_ID if none. */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** The timestamp of the last change. */
+    timestamp_t ts_{0};
+  };
+
+  struct Partition {
+    std::mutex latch_;
+    std::unordered_map<RID, Entry> entries_;
+    /** The slots released, in release order, for Collect to look at once the watermark passes them. */
+    std::deque<std::pair<timestamp_t, RID>> released_;
+  };
+
+  auto GetPartition(const RID &rid) -> Partition & {
+    size_t hash = std::hash<RID>()(rid);
+    return partitions_[(hash ^ (hash >> 32)) % NUM_PARTITIONS];
+  }
+
+  std::array<Partition, NUM_PARTITIONS> partitions_;
+  /** The last version handed out. */
+  std::atomic<uint64_t> last_version_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,101 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/storage/table/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * VersionStore keeps the prior versions of the tuples of one table for the transactions reading a snapshot.
+ *
+ * The newest version of a tuple is the one in the table heap. When a transaction changes a tuple, the version it
+ * replaces is pushed onto the tuple's version chain, stamped with the commit timestamp of the transaction that created
+ * it. A snapshot with read timestamp ts sees the newest version stamped at most ts, or the changes of its own
+ * transaction. A chain is dropped once every running transaction sees the version in the heap.
+ *
+ * The store lives in memory only: after a restart every tuple has a single version again.
+ */
+class VersionStore {
+ public:
+  /** Where the version of a tuple visible to a snapshot is. */
+  enum class Visibility { HEAP, VERSION, NONE };
+
+  /**
+   * Check whether txn may change rid. A snapshot transaction must not change a tuple that another transaction changed
+   * and committed after the snapshot was taken.
+   * @return false on a write-write conflict
+   */
+  auto CanWrite(const RID &rid, Transaction *txn) -> bool;
+
+  /**
+   * Save the version of rid txn is about to replace in the heap, unless txn replaced it already. Called with the page
+   * of rid latched, so readers never see the heap change before the version is saved.
+   * @param rid the tuple changed
+   * @param txn the changing transaction
+   * @param old the version replaced, nullptr if the slot holds no tuple
+   */
+  void SaveVersion(const RID &rid, Transaction *txn, const Tuple *old);
+
+  /** Stamp the heap version txn created with its commit timestamp. */
+  void Commit(const RID &rid, Transaction *txn, timestamp_t commit_ts);
+
+  /** Drop the version txn saved, after the heap was rolled back to it. */
+  void Rollback(const RID &rid, Transaction *txn);
+
+  /**
+   * Find the version of rid visible to the snapshot of txn. Called with the page of rid latched.
+   * @param[out] tuple the visible version, only set for VERSION
+   */
+  auto Resolve(const RID &rid, Transaction *txn, Tuple *tuple) -> Visibility;
+
+  /** Drop the chains of the tuples whose heap version every snapshot at or after watermark sees. */
+  void Collect(timestamp_t watermark);
+
+  /** @return the number of tuples with a version chain */
+  auto Size() -> size_t;
+
+ private:
+  struct Version {
+    /** Commit timestamp of the transaction that created the version, 0 if every snapshot sees it. */
+    timestamp_t ts_;
+    /** False if the slot held no tuple at this version. */
+    bool exists_;
+    Tuple tuple_;
+  };
+
+  struct VersionChain {
+    /** The transaction that created the heap version while it has not committed, INVALID_TXN_ID afterwards. */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** Commit timestamp of the heap version. */
+    timestamp_t ts_{0};
+    /** The replaced versions, oldest first. */
+    std::vector<Version> versions_;
+  };
+
+  std::mutex latch_;
+  std::unordered_map<RID, VersionChain> chains_;
+  /** The tuples committed to, in timestamp order, with the timestamp at which their chain becomes useless. */
+  std::deque<std::pair<timestamp_t, RID>> committed_;
+};
+
+}  // namespace bustub
@@ -12,16 +12,77 @@
 
 #include "recovery/checkpoint_manager.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace bustub {
 
 void CheckpointManager::BeginCheckpoint() {
-  // Block all the transactions and ensure that both the WAL and all dirty buffer pool pages are persisted to disk,
-  // creating a consistent checkpoint. Do NOT allow transactions to resume at the end of this method, resume them
-  // in CheckpointManager::EndCheckpoint() instead. This is for grading purposes.
+  // Only one checkpoint at a time.
+  EndCheckpoint();
+
+  LogRecord begin_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::BEGIN_CHECKPOINT);
+  lsn_t begin_lsn = log_manager_->AppendLogRecord(&begin_record);
+
+  lsn_t oldest_begin_lsn;
+  auto active_txns = transaction_manager_->GetActiveTransactionTable(&oldest_begin_lsn);
+  auto dirty_pages = buffer_pool_manager_->GetDirtyPageTable();
+
+  // Everything before the oldest recovery lsn is already on disk.
+  lsn_t redo_lsn = begin_lsn;
+  for (const auto &[page_id, rec_lsn] : dirty_pages) {
+    redo_lsn = std::min(redo_lsn, rec_lsn);
+  }
+  // Undo needs the whole history of the transactions that are still running.
+  lsn_t scan_lsn = oldest_begin_lsn == INVALID_LSN ? redo_lsn : std::min(redo_lsn, oldest_begin_lsn);
+
+  // Tables too large for one record are split over several END_CHECKPOINT records, recovery merges them.
+  lsn_t end_lsn;
+  size_t num_logged_txns = 0;
+  size_t num_logged_pages = 0;
+  do {
+    size_t num_txns = std::min(active_txns.size() - num_logged_txns, MAX_CHECKPOINT_ENTRIES);
+    size_t num_pages = std::min(dirty_pages.size() - num_logged_pages, MAX_CHECKPOINT_ENTRIES - num_txns);
+    auto txns_begin = active_txns.begin() + num_logged_txns;
+    auto pages_begin = dirty_pages.begin() + num_logged_pages;
+    LogRecord end_record(begin_lsn, {txns_begin, txns_begin + num_txns}, {pages_begin, pages_begin + num_pages});
+    end_lsn = log_manager_->AppendLogRecord(&end_record);
+    num_logged_txns += num_txns;
+    num_logged_pages += num_pages;
+  } while (num_logged_txns < active_txns.size() || num_logged_pages < dirty_pages.size());
+  log_manager_->WaitUntilPersistent(end_lsn);
+
+  MasterRecord master_record;
+  master_record.checkpoint_lsn_ = begin_lsn;
+  master_record.redo_lsn_ = redo_lsn;
+  master_record.scan_offset_ = log_manager_->GetLogOffset(scan_lsn, &master_record.scan_lsn_);
+  log_manager_->GetDiskManager()->WriteMasterRecord(master_record);
+  // Recovery starts at the new master record from now on, the log before it can be recycled.
+  log_manager_->TruncateLog(scan_lsn);
+
+  flush_thread_ = std::thread(&CheckpointManager::FlushDirtyPages, this, std::move(dirty_pages));
 }
 
 void CheckpointManager::EndCheckpoint() {
-  // Allow transactions to resume, completing the checkpoint.
+  // Wait for the pages of the last checkpoint to be written.
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+}
+
+void CheckpointManager::FlushDirtyPages(std::vector<std::pair<page_id_t, lsn_t>> dirty_pages) {
+  for (const auto &[page_id, rec_lsn] : dirty_pages) {
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      continue;
+    }
+    // Keep writers out while the page is copied to disk.
+    page->RLatch();
+    buffer_pool_manager_->FlushPage(page_id);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+  }
 }
 
 }  // namespace bustub
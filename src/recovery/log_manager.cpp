@@ -12,6 +12,13 @@
 
 #include "recovery/log_manager.h"
 
+#include <algorithm>
+#include <cstring>
+#include <thread>  // NOLINT
+
+#include "common/macros.h"
+#include "recovery/log_reader.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +29,333 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::scoped_lock lock(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock flush_lock(latch_);
+    while (enable_logging) {
+      auto timeout = std::chrono::steady_clock::now() + log_timeout;
+      // An asynchronous commit may move the deadline before the timeout while we are waiting.
+      while (!flush_requested_ && enable_logging) {
+        auto deadline = std::min(timeout, flush_deadline_);
+        if (std::chrono::steady_clock::now() >= deadline) {
+          break;
+        }
+        cv_.wait_until(flush_lock, deadline);
+      }
+      FlushBuffer(&flush_lock);
+    }
+    // Whatever was appended before shutting down.
+    FlushBuffer(&flush_lock);
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::scoped_lock lock(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    enable_logging = false;
+    flush_thread = flush_thread_;
+    cv_.notify_one();
+  }
+  flush_thread->join();
+  delete flush_thread;
+  std::scoped_lock lock(latch_);
+  flush_thread_ = nullptr;
+  // Anybody who asked for a flush after the thread's last one writes the log itself from now on.
+  flushed_cv_.notify_all();
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t { return INVALID_LSN; }
+auto LogManager::AppendLogRecord(LogRecord *log_record) -> lsn_t {
+  BUSTUB_ASSERT(log_record->GetSize() <= LOG_BUFFER_SIZE, "Log record larger than the log buffer.");
+  const auto size = static_cast<uint64_t>(log_record->GetSize());
+  uint64_t reservation = reservation_.load();
+  // Claim the next lsn and the next size bytes of the buffer in one step.
+  while (true) {
+    if ((reservation & SEALED) == 0 && (reservation & OFFSET_MASK) + size <= LOG_BUFFER_SIZE) {
+      if (reservation_.compare_exchange_weak(reservation, reservation + (1ULL << 32) + size)) {
+        break;
+      }
+      continue;
+    }
+    WaitForSpace(log_record->GetSize());
+    reservation = reservation_.load();
+  }
+  log_record->lsn_ = static_cast<lsn_t>(reservation >> 32);
+  // log_buffer_ cannot be swapped before this slice is filled.
+  SerializeLogRecord(log_record, log_buffer_ + (reservation & OFFSET_MASK));
+  filled_bytes_ += size;
+  return log_record->lsn_;
+}
+
+void LogManager::WaitForSpace(int32_t size) {
+  std::unique_lock lock(latch_);
+  // The buffers are swapped under latch_, so a flush may have made room while we were waiting for it.
+  uint64_t reservation = reservation_.load();
+  if ((reservation & SEALED) == 0 && (reservation & OFFSET_MASK) + size <= LOG_BUFFER_SIZE) {
+    return;
+  }
+  if (flush_thread_ == nullptr) {
+    FlushBuffer(&lock);
+    return;
+  }
+  flush_requested_ = true;
+  cv_.notify_one();
+  flushed_cv_.wait(lock);
+}
+
+void LogManager::WaitUntilPersistent(lsn_t lsn) {
+  std::unique_lock lock(latch_);
+  // No record beyond the last assigned lsn exists, e.g. pages that are not logged carry no meaningful page LSN.
+  lsn = std::min<lsn_t>(lsn, GetNextLSN() - 1);
+  while (persistent_lsn_ < lsn) {
+    if (flush_thread_ == nullptr) {
+      FlushBuffer(&lock);
+      continue;
+    }
+    flush_requested_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+}
+
+void LogManager::RequestPersistent(lsn_t lsn, std::chrono::milliseconds delay) {
+  std::unique_lock lock(latch_);
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  if (flush_thread_ == nullptr) {
+    while (persistent_lsn_ < lsn) {
+      FlushBuffer(&lock);
+    }
+    return;
+  }
+  auto deadline = std::chrono::steady_clock::now() + delay;
+  if (deadline < flush_deadline_) {
+    flush_deadline_ = deadline;
+    cv_.notify_one();
+  }
+}
+
+auto LogManager::GetLogOffset(lsn_t lsn, lsn_t *first_lsn) -> int64_t {
+  std::scoped_lock lock(latch_);
+  auto it = std::upper_bound(flush_index_.begin(), flush_index_.end(), lsn,
+                             [](lsn_t target, const std::pair<lsn_t, int64_t> &write) { return target < write.first; });
+  if (it == flush_index_.begin()) {
+    if (first_lsn != nullptr) {
+      *first_lsn = flush_index_.empty() ? INVALID_LSN : flush_index_.front().first;
+    }
+    return flush_index_.empty() ? log_file_offset_ : flush_index_.front().second;
+  }
+  --it;
+  if (first_lsn != nullptr) {
+    *first_lsn = it->first;
+  }
+  return it->second;
+}
+
+void LogManager::TruncateLog(lsn_t lsn) {
+  int64_t offset = GetLogOffset(lsn);
+  {
+    std::scoped_lock lock(latch_);
+    auto it = std::find_if(flush_index_.begin(), flush_index_.end(),
+                           [offset](const std::pair<lsn_t, int64_t> &write) { return write.second >= offset; });
+    flush_index_.erase(flush_index_.begin(), it);
+  }
+  disk_manager_->TruncateLog(offset);
+}
+
+void LogManager::ResumeLog() {
+  int64_t offset = disk_manager_->GetLogStartOffset();
+  MasterRecord master_record;
+  lsn_t lsn;
+  if (disk_manager_->ReadMasterRecord(&master_record) &&
+      disk_manager_->ReadLog(log_buffer_, LogRecord::HEADER_SIZE, master_record.scan_offset_)) {
+    memcpy(&lsn, log_buffer_ + sizeof(int32_t), sizeof(lsn_t));
+    if (lsn == master_record.scan_lsn_) {
+      offset = master_record.scan_offset_;
+    }
+  }
+  lsn_t last_lsn = INVALID_LSN;
+  int64_t end_offset = offset;
+  {
+    LogReader reader(disk_manager_, offset);
+    while (reader.Next()) {
+      // Every lsn is handed out to exactly one record, a record that does not continue them is torn.
+      memcpy(&lsn, reader.GetRecord() + sizeof(int32_t), sizeof(lsn_t));
+      if (lsn == INVALID_LSN || (last_lsn != INVALID_LSN && lsn != last_lsn + 1)) {
+        break;
+      }
+      last_lsn = lsn;
+      end_offset = reader.GetRecordOffset() + reader.GetRecordSize();
+    }
+  }
+  // Recovery stops at a torn record, records appended behind it would never be read.
+  disk_manager_->SetLogEndOffset(end_offset);
+  log_file_offset_ = disk_manager_->GetLogEndOffset();
+  buffer_first_lsn_ = last_lsn + 1;
+  reservation_ = static_cast<uint64_t>(buffer_first_lsn_) << 32;
+  persistent_lsn_ = last_lsn;
+}
+
+void LogManager::FlushBuffer(std::unique_lock<std::mutex> *lock) {
+  // flush_buffer_ may only be reused once its previous write is done.
+  flushed_cv_.wait(*lock, [this] { return !flush_in_progress_; });
+  flush_requested_ = false;
+  // Every record appended so far is part of this write.
+  flush_deadline_ = std::chrono::steady_clock::time_point::max();
+  // Stop handing out slices of the active buffer.
+  uint64_t reservation = reservation_.fetch_or(SEALED);
+  uint64_t size = reservation & OFFSET_MASK;
+  lsn_t next_lsn = static_cast<lsn_t>(reservation >> 32);
+  if (size == 0) {
+    reservation_ = reservation;
+    return;
+  }
+  // Wait for the appenders that already own a slice, they are only copying their record.
+  while (filled_bytes_.load() != size) {
+    std::this_thread::yield();
+  }
+  std::swap(log_buffer_, flush_buffer_);
+  flush_index_.emplace_back(buffer_first_lsn_, log_file_offset_);
+  buffer_first_lsn_ = next_lsn;
+  log_file_offset_ += static_cast<int64_t>(size);
+  filled_bytes_ = 0;
+  reservation_ = static_cast<uint64_t>(next_lsn) << 32;
+  flush_in_progress_ = true;
+  // Appenders that found the buffer full can go on with the fresh one.
+  flushed_cv_.notify_all();
+
+  lock->unlock();
+  disk_manager_->WriteLog(flush_buffer_, static_cast<int>(size));
+  lock->lock();
+
+  persistent_lsn_ = next_lsn - 1;
+  flush_in_progress_ = false;
+  flushed_cv_.notify_all();
+}
+
+void LogManager::SerializeLogRecord(LogRecord *log_record, char *dst) {
+  // The must have fields are laid out at the beginning of LogRecord exactly as in the header.
+  memcpy(dst, log_record, LogRecord::HEADER_SIZE);
+  int pos = LogRecord::HEADER_SIZE;
+
+  // A compensation log record is followed by its change, laid out as in a record of the change's type.
+  if (log_record->log_record_type_ == LogRecordType::CLR) {
+    memcpy(dst + pos, &log_record->undo_next_lsn_, sizeof(lsn_t));
+    memcpy(dst + pos + sizeof(lsn_t), &log_record->change_type_, sizeof(LogRecordType));
+    pos += sizeof(lsn_t) + sizeof(LogRecordType);
+  }
+  // An index entry record is followed by its bucket changes, laid out as in a page delta record.
+  if (log_record->log_record_type_ == LogRecordType::INDEX_INSERT ||
+      log_record->log_record_type_ == LogRecordType::INDEX_DELETE) {
+    auto key_size = static_cast<int32_t>(log_record->index_key_.size());
+    memcpy(dst + pos, &log_record->index_page_id_, sizeof(page_id_t));
+    memcpy(dst + pos + sizeof(page_id_t), &key_size, sizeof(int32_t));
+    pos += sizeof(page_id_t) + sizeof(int32_t);
+    memcpy(dst + pos, log_record->index_key_.data(), key_size);
+    pos += key_size;
+    memcpy(dst + pos, &log_record->index_rid_, sizeof(RID));
+    pos += sizeof(RID);
+  }
+  switch (log_record->GetRedoType()) {
+    case LogRecordType::INSERT:
+      memcpy(dst + pos, &log_record->insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(dst + pos, &log_record->delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(dst + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.SerializeTo(dst + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::UPDATE_DELTA: {
+      memcpy(dst + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      auto num_ranges = static_cast<int32_t>(log_record->delta_ranges_.size());
+      memcpy(dst + pos, &num_ranges, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &[offset, length] : log_record->delta_ranges_) {
+        memcpy(dst + pos, &offset, sizeof(uint32_t));
+        memcpy(dst + pos + sizeof(uint32_t), &length, sizeof(uint32_t));
+        pos += 2 * sizeof(uint32_t);
+      }
+      memcpy(dst + pos, log_record->delta_old_.data(), log_record->delta_old_.size());
+      pos += log_record->delta_old_.size();
+      memcpy(dst + pos, log_record->delta_new_.data(), log_record->delta_new_.size());
+      break;
+    }
+    case LogRecordType::PAGE_DELTA: {
+      auto num_pages = static_cast<int32_t>(log_record->page_deltas_.size());
+      memcpy(dst + pos, &num_pages, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &delta : log_record->page_deltas_) {
+        auto num_ranges = static_cast<int32_t>(delta.ranges_.size());
+        memcpy(dst + pos, &delta.page_id_, sizeof(page_id_t));
+        memcpy(dst + pos + sizeof(page_id_t), &num_ranges, sizeof(int32_t));
+        pos += sizeof(page_id_t) + sizeof(int32_t);
+        for (const auto &[offset, length] : delta.ranges_) {
+          memcpy(dst + pos, &offset, sizeof(uint32_t));
+          memcpy(dst + pos + sizeof(uint32_t), &length, sizeof(uint32_t));
+          pos += 2 * sizeof(uint32_t);
+        }
+        memcpy(dst + pos, delta.data_.data(), delta.data_.size());
+        pos += delta.data_.size();
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      memcpy(dst + pos, &log_record->prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(dst + pos, &log_record->page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::END_CHECKPOINT: {
+      auto num_txns = static_cast<int32_t>(log_record->active_txns_.size());
+      memcpy(dst + pos, &num_txns, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &[txn_id, last_lsn] : log_record->active_txns_) {
+        memcpy(dst + pos, &txn_id, sizeof(txn_id_t));
+        memcpy(dst + pos + sizeof(txn_id_t), &last_lsn, sizeof(lsn_t));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      auto num_pages = static_cast<int32_t>(log_record->dirty_pages_.size());
+      memcpy(dst + pos, &num_pages, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      for (const auto &[page_id, rec_lsn] : log_record->dirty_pages_) {
+        memcpy(dst + pos, &page_id, sizeof(page_id_t));
+        memcpy(dst + pos + sizeof(page_id_t), &rec_lsn, sizeof(lsn_t));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      // BEGIN/COMMIT/ABORT/BEGIN_CHECKPOINT only have the header.
+      break;
+  }
+}
 
 }  // namespace bustub
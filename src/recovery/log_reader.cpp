@@ -0,0 +1,99 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.cpp
+//
+// Identification: src/recovery/log_reader.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "recovery/log_record.h"
+
+namespace bustub {
+
+LogReader::LogReader(DiskManager *disk_manager, int64_t offset, int read_ahead_size)
+    : disk_manager_(disk_manager),
+      read_ahead_size_(read_ahead_size),
+      end_offset_(disk_manager->GetLogEndOffset()),
+      base_offset_(offset),
+      read_offset_(offset) {
+  BUSTUB_ASSERT(read_ahead_size_ > 0, "The read ahead size must be positive.");
+  for (auto &buffer : buffers_) {
+    buffer = std::make_unique<char[]>(LOG_BUFFER_SIZE + read_ahead_size_);
+  }
+  base_ = pos_ = end_ = buffers_[current_].get() + LOG_BUFFER_SIZE;
+  StartRead();
+}
+
+LogReader::~LogReader() {
+  // The read must not outlive its buffer.
+  if (pending_read_.valid()) {
+    pending_read_.wait();
+  }
+}
+
+auto LogReader::Next() -> bool {
+  pos_ += record_size_;
+  record_size_ = 0;
+  while (true) {
+    if (end_ - pos_ >= LogRecord::HEADER_SIZE) {
+      int32_t size;
+      memcpy(&size, pos_, sizeof(int32_t));
+      if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE) {
+        return false;
+      }
+      if (size <= end_ - pos_) {
+        record_size_ = size;
+        return true;
+      }
+    }
+    if (!NextChunk()) {
+      return false;
+    }
+  }
+}
+
+void LogReader::StartRead() {
+  auto size = static_cast<int>(std::min<int64_t>(read_ahead_size_, end_offset_ - read_offset_));
+  if (size <= 0) {
+    pending_read_ = std::future<int>();
+    return;
+  }
+  char *dst = buffers_[1 - current_].get() + LOG_BUFFER_SIZE;
+  int64_t offset = read_offset_;
+  read_offset_ += size;
+  pending_read_ = std::async(std::launch::async, [this, dst, size, offset] {
+    return disk_manager_->ReadLog(dst, size, offset) ? size : 0;
+  });
+}
+
+auto LogReader::NextChunk() -> bool {
+  if (!pending_read_.valid()) {
+    return false;
+  }
+  int count = pending_read_.get();
+  if (count == 0) {
+    return false;
+  }
+  // Only the head of a single record is left over, it fits in front of the chunk.
+  auto tail = static_cast<int>(end_ - pos_);
+  char *chunk = buffers_[1 - current_].get() + LOG_BUFFER_SIZE;
+  memcpy(chunk - tail, pos_, tail);
+  base_offset_ = GetRecordOffset();
+  base_ = pos_ = chunk - tail;
+  end_ = chunk + count;
+  current_ = 1 - current_;
+  // The old buffer is free now.
+  StartRead();
+  return true;
+}
+
+}  // namespace bustub
@@ -12,15 +12,187 @@
 
 #include "recovery/log_recovery.h"
 
+#include <cstring>
+#include <queue>
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "common/logger.h"
+#include "common/macros.h"
+#include "container/hash/extendible_hash_table.h"
+#include "recovery/log_reader.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
+
+/** @return true for the records that change a tuple, undone by the opposite change to the table page */
+static auto IsTupleChange(LogRecordType log_record_type) -> bool {
+  switch (log_record_type) {
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::UPDATE_DELTA:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/** @return true for the records of entries a transaction inserted into or removed from an index */
+static auto IsIndexChange(LogRecordType log_record_type) -> bool {
+  return log_record_type == LogRecordType::INDEX_INSERT || log_record_type == LogRecordType::INDEX_DELETE;
+}
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool { return false; }
+auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) -> bool {
+  // The caller makes sure the whole record, as announced by its size, is in the buffer.
+  memcpy(&log_record->size_, data, sizeof(int32_t));
+  memcpy(&log_record->lsn_, data + 4, sizeof(lsn_t));
+  memcpy(&log_record->txn_id_, data + 8, sizeof(txn_id_t));
+  memcpy(&log_record->prev_lsn_, data + 12, sizeof(lsn_t));
+  memcpy(&log_record->log_record_type_, data + 16, sizeof(LogRecordType));
+  // The log ends with zeroes, or with garbage if the last write was torn.
+  if (log_record->size_ < LogRecord::HEADER_SIZE || log_record->lsn_ == INVALID_LSN ||
+      log_record->log_record_type_ <= LogRecordType::INVALID ||
+      log_record->log_record_type_ > LogRecordType::INDEX_DELETE) {
+    return false;
+  }
+  const char *pos = data + LogRecord::HEADER_SIZE;
+  if (log_record->log_record_type_ == LogRecordType::CLR) {
+    log_record->undo_next_lsn_ = *reinterpret_cast<const lsn_t *>(pos);
+    log_record->change_type_ = *reinterpret_cast<const LogRecordType *>(pos + sizeof(lsn_t));
+    pos += sizeof(lsn_t) + sizeof(LogRecordType);
+    if (!IsTupleChange(log_record->change_type_) && log_record->change_type_ != LogRecordType::PAGE_DELTA) {
+      return false;
+    }
+  }
+  if (IsIndexChange(log_record->log_record_type_)) {
+    const char *end = data + log_record->size_;
+    log_record->index_page_id_ = *reinterpret_cast<const page_id_t *>(pos);
+    int32_t key_size = *reinterpret_cast<const int32_t *>(pos + sizeof(page_id_t));
+    pos += sizeof(page_id_t) + sizeof(int32_t);
+    if (key_size < 0 || pos + key_size + sizeof(RID) > end) {
+      return false;
+    }
+    log_record->index_key_.assign(pos, pos + key_size);
+    log_record->index_rid_ = *reinterpret_cast<const RID *>(pos + key_size);
+    pos += key_size + sizeof(RID);
+  }
+  switch (log_record->GetRedoType()) {
+    case LogRecordType::INSERT:
+      log_record->insert_rid_ = *reinterpret_cast<const RID *>(pos);
+      log_record->insert_tuple_.DeserializeFrom(pos + sizeof(RID));
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      log_record->delete_rid_ = *reinterpret_cast<const RID *>(pos);
+      log_record->delete_tuple_.DeserializeFrom(pos + sizeof(RID));
+      break;
+    case LogRecordType::UPDATE:
+      log_record->update_rid_ = *reinterpret_cast<const RID *>(pos);
+      pos += sizeof(RID);
+      log_record->old_tuple_.DeserializeFrom(pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.DeserializeFrom(pos);
+      break;
+    case LogRecordType::UPDATE_DELTA: {
+      log_record->update_rid_ = *reinterpret_cast<const RID *>(pos);
+      pos += sizeof(RID);
+      int32_t num_ranges = *reinterpret_cast<const int32_t *>(pos);
+      pos += sizeof(int32_t);
+      const char *end = data + log_record->size_;
+      if (num_ranges < 0 || pos + num_ranges * 2 * sizeof(uint32_t) > end) {
+        return false;
+      }
+      log_record->delta_ranges_.clear();
+      size_t num_bytes = 0;
+      for (int32_t i = 0; i < num_ranges; i++) {
+        log_record->delta_ranges_.emplace_back(*reinterpret_cast<const uint32_t *>(pos),
+                                               *reinterpret_cast<const uint32_t *>(pos + sizeof(uint32_t)));
+        num_bytes += log_record->delta_ranges_.back().second;
+        pos += 2 * sizeof(uint32_t);
+      }
+      if (pos + 2 * num_bytes != end) {
+        return false;
+      }
+      log_record->delta_old_.assign(pos, pos + num_bytes);
+      log_record->delta_new_.assign(pos + num_bytes, end);
+      break;
+    }
+    case LogRecordType::PAGE_DELTA: {
+      const char *end = data + log_record->size_;
+      int32_t num_pages = *reinterpret_cast<const int32_t *>(pos);
+      pos += sizeof(int32_t);
+      log_record->page_deltas_.clear();
+      for (int32_t i = 0; i < num_pages; i++) {
+        if (pos + sizeof(page_id_t) + sizeof(int32_t) > end) {
+          return false;
+        }
+        PageDelta &delta = log_record->page_deltas_.emplace_back();
+        delta.page_id_ = *reinterpret_cast<const page_id_t *>(pos);
+        int32_t num_ranges = *reinterpret_cast<const int32_t *>(pos + sizeof(page_id_t));
+        pos += sizeof(page_id_t) + sizeof(int32_t);
+        if (num_ranges < 0 || pos + num_ranges * 2 * sizeof(uint32_t) > end) {
+          return false;
+        }
+        size_t num_bytes = 0;
+        for (int32_t j = 0; j < num_ranges; j++) {
+          delta.ranges_.emplace_back(*reinterpret_cast<const uint32_t *>(pos),
+                                     *reinterpret_cast<const uint32_t *>(pos + sizeof(uint32_t)));
+          if (delta.ranges_.back().first + delta.ranges_.back().second > PAGE_SIZE) {
+            return false;
+          }
+          num_bytes += delta.ranges_.back().second;
+          pos += 2 * sizeof(uint32_t);
+        }
+        if (pos + num_bytes > end) {
+          return false;
+        }
+        delta.data_.assign(pos, pos + num_bytes);
+        pos += num_bytes;
+      }
+      if (pos != end) {
+        return false;
+      }
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      log_record->prev_page_id_ = *reinterpret_cast<const page_id_t *>(pos);
+      log_record->page_id_ = *reinterpret_cast<const page_id_t *>(pos + sizeof(page_id_t));
+      break;
+    case LogRecordType::END_CHECKPOINT: {
+      int32_t num_txns = *reinterpret_cast<const int32_t *>(pos);
+      pos += sizeof(int32_t);
+      log_record->active_txns_.clear();
+      for (int32_t i = 0; i < num_txns; i++) {
+        log_record->active_txns_.emplace_back(*reinterpret_cast<const txn_id_t *>(pos),
+                                              *reinterpret_cast<const lsn_t *>(pos + sizeof(txn_id_t)));
+        pos += sizeof(txn_id_t) + sizeof(lsn_t);
+      }
+      int32_t num_pages = *reinterpret_cast<const int32_t *>(pos);
+      pos += sizeof(int32_t);
+      log_record->dirty_pages_.clear();
+      for (int32_t i = 0; i < num_pages; i++) {
+        log_record->dirty_pages_.emplace_back(*reinterpret_cast<const page_id_t *>(pos),
+                                              *reinterpret_cast<const lsn_t *>(pos + sizeof(page_id_t)));
+        pos += sizeof(page_id_t) + sizeof(lsn_t);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +201,387 @@ auto LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  auto start_time = std::chrono::steady_clock::now();
+  stats_ = RecoveryStatistics();
+  num_redone_ = 0;
+  active_txn_.clear();
+  lsn_mapping_.clear();
+
+  partitions_.clear();
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers_; i++) {
+    partitions_.emplace_back(std::make_unique<RedoPartition>());
+    workers.emplace_back(&LogRecovery::RunRedoWorker, this, partitions_.back().get());
+  }
+
+  // Start at the last checkpoint if there is one, otherwise at the oldest log segment that was kept. The master record
+  // of an older log is ignored.
+  offset_ = disk_manager_->GetLogStartOffset();
+  lsn_t redo_lsn = INVALID_LSN;
+  MasterRecord master_record;
+  LogRecord log_record;
+  if (disk_manager_->ReadMasterRecord(&master_record) &&
+      disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, master_record.scan_offset_) &&
+      DeserializeLogRecord(log_buffer_, &log_record) && log_record.lsn_ == master_record.scan_lsn_) {
+    offset_ = master_record.scan_offset_;
+    redo_lsn = master_record.redo_lsn_;
+  }
+  stats_.start_offset_ = offset_;
+  // Transactions that finished in the scanned part of the log, the checkpoint may still list them as active.
+  std::unordered_set<txn_id_t> finished_txns;
+
+  LogReader reader(disk_manager_, offset_);
+  while (reader.Next()) {
+    // A torn record ends the log.
+    if (!DeserializeLogRecord(reader.GetRecord(), &log_record)) {
+      break;
+    }
+    lsn_mapping_[log_record.lsn_] = reader.GetRecordOffset();
+    offset_ = reader.GetRecordOffset() + reader.GetRecordSize();
+    stats_.num_records_++;
+
+    // Analysis: a transaction stays active until its COMMIT/ABORT record.
+    switch (log_record.log_record_type_) {
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record.txn_id_);
+        finished_txns.insert(log_record.txn_id_);
+        break;
+      case LogRecordType::BEGIN_CHECKPOINT:
+      case LogRecordType::PAGE_DELTA:
+        break;
+      case LogRecordType::END_CHECKPOINT:
+        for (const auto &[txn_id, last_lsn] : log_record.active_txns_) {
+          if (finished_txns.count(txn_id) == 0) {
+            auto it = active_txn_.find(txn_id);
+            if (it == active_txn_.end() || it->second < last_lsn) {
+              active_txn_[txn_id] = last_lsn;
+            }
+          }
+        }
+        break;
+      default:
+        active_txn_[log_record.txn_id_] = log_record.lsn_;
+        break;
+    }
+    // Older records are reflected in the database file already, they are only scanned for the analysis.
+    if (log_record.lsn_ < redo_lsn) {
+      continue;
+    }
+
+    switch (log_record.GetRedoType()) {
+      case LogRecordType::INSERT:
+        Dispatch(log_record.insert_rid_.GetPageId(), {log_record, false});
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+      case LogRecordType::ROLLBACKDELETE:
+        Dispatch(log_record.delete_rid_.GetPageId(), {log_record, false});
+        break;
+      case LogRecordType::UPDATE:
+      case LogRecordType::UPDATE_DELTA:
+        Dispatch(log_record.update_rid_.GetPageId(), {log_record, false});
+        break;
+      case LogRecordType::PAGE_DELTA:
+        for (size_t i = 0; i < log_record.page_deltas_.size(); i++) {
+          Dispatch(log_record.page_deltas_[i].page_id_, {log_record, false, i});
+        }
+        break;
+      case LogRecordType::NEWPAGE:
+        Dispatch(log_record.page_id_, {log_record, false});
+        if (log_record.prev_page_id_ != INVALID_PAGE_ID) {
+          Dispatch(log_record.prev_page_id_, {log_record, true});
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  for (auto &partition : partitions_) {
+    {
+      std::scoped_lock partition_guard(partition->latch_);
+      partition->done_ = true;
+    }
+    partition->cv_.notify_all();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  partitions_.clear();
+
+  stats_.log_bytes_ = offset_ - stats_.start_offset_;
+  stats_.num_redone_ = num_redone_;
+  stats_.redo_time_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+  LOG_INFO("Redo replayed %lu of %lu log records, %lu bytes at %.2f MB/s", stats_.num_redone_, stats_.num_records_,
+           stats_.log_bytes_, stats_.RedoThroughput());
+}
+
+void LogRecovery::Dispatch(page_id_t page_id, RedoTask task) {
+  auto &partition = partitions_[static_cast<size_t>(page_id) % partitions_.size()];
+  std::unique_lock partition_guard(partition->latch_);
+  partition->cv_.wait(partition_guard, [&] { return partition->tasks_.size() < MAX_QUEUED_TASKS; });
+  partition->tasks_.emplace_back(std::move(task));
+  partition->cv_.notify_all();
+}
+
+void LogRecovery::RunRedoWorker(RedoPartition *partition) {
+  std::deque<RedoTask> tasks;
+  while (true) {
+    {
+      std::unique_lock partition_guard(partition->latch_);
+      partition->cv_.wait(partition_guard, [&] { return !partition->tasks_.empty() || partition->done_; });
+      if (partition->tasks_.empty()) {
+        return;
+      }
+      // Take the whole queue at once, the reader only waits for us when the queue is full.
+      tasks.swap(partition->tasks_);
+    }
+    partition->cv_.notify_all();
+    for (auto &task : tasks) {
+      if (RedoRecord(&task)) {
+        num_redone_++;
+      }
+    }
+    tasks.clear();
+  }
+}
+
+auto LogRecovery::RedoRecord(RedoTask *task) -> bool {
+  LogRecord &log_record = task->log_record_;
+  page_id_t page_id;
+  switch (log_record.GetRedoType()) {
+    case LogRecordType::INSERT:
+      page_id = log_record.insert_rid_.GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+    case LogRecordType::UPDATE_DELTA:
+      page_id = log_record.update_rid_.GetPageId();
+      break;
+    case LogRecordType::NEWPAGE:
+      page_id = task->link_prev_page_ ? log_record.prev_page_id_ : log_record.page_id_;
+      break;
+    case LogRecordType::PAGE_DELTA:
+      page_id = log_record.page_deltas_[task->page_delta_index_].page_id_;
+      break;
+    default:
+      page_id = log_record.delete_rid_.GetPageId();
+      break;
+  }
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "The redo workers must not exhaust the buffer pool.");
+
+  // Linking is idempotent and the next page id never changes once set, so it does not depend on the page LSN. It is
+  // part of replaying the NEWPAGE record and not counted on its own.
+  if (task->link_prev_page_) {
+    bool changed = page->GetNextPageId() != log_record.page_id_;
+    if (changed) {
+      page->SetNextPageId(log_record.page_id_);
+    }
+    buffer_pool_manager_->UnpinPage(page_id, changed);
+    return false;
+  }
+
+  // Index pages have no page LSN. Their deltas are physical after-images and replaying all of them in log order ends in
+  // the same page, no matter which of them the page on disk already reflects. A record is counted once.
+  if (log_record.GetRedoType() == LogRecordType::PAGE_DELTA) {
+    const PageDelta &delta = log_record.page_deltas_[task->page_delta_index_];
+    const char *data = delta.data_.data();
+    for (const auto &[offset, length] : delta.ranges_) {
+      memcpy(page->GetData() + offset, data, length);
+      data += length;
+    }
+    buffer_pool_manager_->UnpinPage(page_id, true);
+    return task->page_delta_index_ == 0;
+  }
+
+  if (page->GetLSN() >= log_record.lsn_) {
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    return false;
+  }
+  if (log_record.GetRedoType() == LogRecordType::NEWPAGE) {
+    page->Init(log_record.page_id_, PAGE_SIZE, log_record.prev_page_id_, nullptr, nullptr);
+  } else {
+    ApplyChange(page, &log_record);
+  }
+  page->SetLSN(log_record.lsn_);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  return true;
+}
+
+void LogRecovery::ApplyChange(TablePage *page, LogRecord *log_record) {
+  switch (log_record->GetRedoType()) {
+    case LogRecordType::INSERT:
+      page->RestoreTuple(log_record->insert_rid_, log_record->insert_tuple_);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->MarkDelete(log_record->delete_rid_, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->ApplyDelete(log_record->delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->RollbackDelete(log_record->delete_rid_, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple old_tuple;
+      page->UpdateTuple(log_record->new_tuple_, &old_tuple, log_record->update_rid_, nullptr, nullptr, nullptr);
+      break;
+    }
+    case LogRecordType::UPDATE_DELTA:
+      page->ApplyTupleDelta(log_record->update_rid_, log_record->delta_ranges_, log_record->delta_new_.data());
+      break;
+    default:
+      break;
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
- *iterate through active txn map and undo each operation
+ *roll back the records of all the loser transactions in a single pass, newest first, following the prev_lsn chains.
+ *Every undone record is compensated by a CLR whose undo_next_lsn skips it, so an interrupted undo is never repeated.
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  auto start_time = std::chrono::steady_clock::now();
+  stats_.num_undone_ = 0;
+  // The next record to undo of every loser, the newest one on top.
+  std::priority_queue<std::pair<lsn_t, txn_id_t>> to_undo;
+  for (const auto &[txn_id, last_lsn] : active_txn_) {
+    to_undo.emplace(last_lsn, txn_id);
+  }
+  LogRecord log_record;
+  while (!to_undo.empty()) {
+    auto [lsn, txn_id] = to_undo.top();
+    to_undo.pop();
+    auto it = lsn_mapping_.find(lsn);
+    BUSTUB_ASSERT(it != lsn_mapping_.end(), "Every record of an active transaction was seen by redo.");
+    disk_manager_->ReadLog(log_buffer_, LOG_BUFFER_SIZE, it->second);
+    lsn_t undo_next_lsn = INVALID_LSN;
+    if (DeserializeLogRecord(log_buffer_, &log_record) && log_record.log_record_type_ != LogRecordType::BEGIN) {
+      if (log_record.log_record_type_ == LogRecordType::CLR) {
+        // The records up to the one it compensates are undone already.
+        undo_next_lsn = log_record.undo_next_lsn_;
+      } else {
+        if (UndoRecord(&log_record)) {
+          stats_.num_undone_++;
+        }
+        undo_next_lsn = log_record.prev_lsn_;
+      }
+    }
+    if (undo_next_lsn != INVALID_LSN) {
+      to_undo.emplace(undo_next_lsn, txn_id);
+      continue;
+    }
+    // Rolled back completely, the next recovery does not need to look at the transaction again.
+    LogRecord abort_record(txn_id, active_txn_[txn_id], LogRecordType::ABORT);
+    log_manager_->AppendLogRecord(&abort_record);
+  }
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  stats_.undo_time_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+}
+
+auto LogRecovery::UndoRecord(LogRecord *log_record) -> bool {
+  if (IsIndexChange(log_record->log_record_type_)) {
+    return UndoIndexRecord(log_record);
+  }
+  if (!IsTupleChange(log_record->log_record_type_)) {
+    // An allocated page stays part of the table, it is simply empty.
+    return false;
+  }
+  // The change that undoes the record.
+  LogRecord change = *log_record;
+  page_id_t page_id;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      change.log_record_type_ = LogRecordType::APPLYDELETE;
+      change.delete_rid_ = log_record->insert_rid_;
+      change.delete_tuple_ = log_record->insert_tuple_;
+      page_id = log_record->insert_rid_.GetPageId();
+      break;
+    case LogRecordType::MARKDELETE:
+      change.log_record_type_ = LogRecordType::ROLLBACKDELETE;
+      page_id = log_record->delete_rid_.GetPageId();
+      break;
+    case LogRecordType::APPLYDELETE:
+      // The tuple goes back into its own slot, the older records of the transaction name it by its rid.
+      change.log_record_type_ = LogRecordType::INSERT;
+      change.insert_rid_ = log_record->delete_rid_;
+      change.insert_tuple_ = log_record->delete_tuple_;
+      page_id = log_record->delete_rid_.GetPageId();
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      change.log_record_type_ = LogRecordType::MARKDELETE;
+      page_id = log_record->delete_rid_.GetPageId();
+      break;
+    case LogRecordType::UPDATE:
+      std::swap(change.old_tuple_, change.new_tuple_);
+      page_id = log_record->update_rid_.GetPageId();
+      break;
+    default:
+      std::swap(change.delta_old_, change.delta_new_);
+      page_id = log_record->update_rid_.GetPageId();
+      break;
+  }
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Undo must be able to fetch the page.");
+  ApplyChange(page, &change);
+  // The page stays pinned until it carries the lsn of the CLR, so it cannot reach the disk before the CLR does.
+  LogRecord clr(log_record->txn_id_, active_txn_[log_record->txn_id_], log_record->prev_lsn_, change);
+  active_txn_[log_record->txn_id_] = log_manager_->AppendLogRecord(&clr);
+  page->SetLSN(clr.lsn_);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  return true;
+}
+
+auto LogRecovery::UndoIndexRecord(LogRecord *log_record) -> bool {
+  // The index logs the pages it changes only while logging is on. Taking the entry out or putting it back a second
+  // time finds nothing to do, so a crash before the CLR below is logged does no harm.
+  bool logging = enable_logging;
+  enable_logging = true;
+  bool undone = false;
+  switch (log_record->index_key_.size()) {
+    case 4:
+      undone = UndoIndexChange<4>(log_record);
+      break;
+    case 8:
+      undone = UndoIndexChange<8>(log_record);
+      break;
+    case 16:
+      undone = UndoIndexChange<16>(log_record);
+      break;
+    case 32:
+      undone = UndoIndexChange<32>(log_record);
+      break;
+    case 64:
+      undone = UndoIndexChange<64>(log_record);
+      break;
+    default:
+      enable_logging = logging;
+      UNREACHABLE("Hash indexes only have generic keys of 4, 8, 16, 32 or 64 bytes.");
+  }
+  enable_logging = logging;
+  LogRecord no_change{std::vector<PageDelta>()};
+  LogRecord clr(log_record->txn_id_, active_txn_[log_record->txn_id_], log_record->prev_lsn_, no_change);
+  active_txn_[log_record->txn_id_] = log_manager_->AppendLogRecord(&clr);
+  return undone;
+}
+
+template <size_t KeySize>
+auto LogRecovery::UndoIndexChange(LogRecord *log_record) -> bool {
+  GenericKey<KeySize> key;
+  memcpy(key.data_, log_record->index_key_.data(), KeySize);
+  // Without its key schema the comparator compares the raw keys, which is all a hash index asks of it.
+  ExtendibleHashTable<GenericKey<KeySize>, RID, GenericComparator<KeySize>> index(
+      "", buffer_pool_manager_, GenericComparator<KeySize>(nullptr), HashFunction<GenericKey<KeySize>>(), log_manager_,
+      log_record->index_page_id_);
+  if (log_record->log_record_type_ == LogRecordType::INDEX_INSERT) {
+    return index.Remove(nullptr, key, log_record->index_rid_);
+  }
+  return index.Insert(nullptr, key, log_record->index_rid_);
+}
 
 }  // namespace bustub
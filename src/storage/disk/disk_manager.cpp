@@ -10,9 +10,15 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <mutex>  // NOLINT
 #include <string>
@@ -30,24 +36,11 @@ static char *buffer_used;
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
-  std::string::size_type n = file_name_.rfind('.');
-  if (n == std::string::npos) {
-    LOG_DEBUG("wrong file format");
+DiskManager::DiskManager(const std::string &db_file, int log_segment_size)
+    : file_name_(db_file), log_segment_size_(log_segment_size) {
+  if (!OpenLogFile()) {
     return;
   }
-  log_name_ = file_name_.substr(0, n) + ".log";
-
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::out | std::ios::in);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
-  }
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
@@ -63,6 +56,74 @@ DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
   buffer_used = nullptr;
 }
 
+DiskManager::~DiskManager() { CloseLogFiles(); }
+
+/**
+ * Open/create the log file that belongs to file_name_
+ * The log starts at the lowest segment found on disk and ends in the first segment that is not full. A recycled last
+ * segment is full of stale records, LogManager::ResumeLog finds the real end.
+ * @return: false if the database file name has no extension to derive the log file name from
+ */
+auto DiskManager::OpenLogFile() -> bool {
+  std::string::size_type n = file_name_.rfind('.');
+  if (n == std::string::npos) {
+    LOG_DEBUG("wrong file format");
+    return false;
+  }
+  log_name_ = file_name_.substr(0, n) + ".log";
+  master_name_ = file_name_.substr(0, n) + ".master";
+
+  std::scoped_lock log_guard(log_io_latch_);
+  std::filesystem::path log_path(log_name_);
+  std::string base_name = log_path.filename().string();
+  std::string free_prefix = base_name + ".free.";
+  int first_segment = -1;
+  std::error_code error;
+  auto parent = log_path.has_parent_path() ? log_path.parent_path() : std::filesystem::path(".");
+  // a missing directory is reported below, when the segment cannot be created
+  for (const auto &entry : std::filesystem::directory_iterator(parent, error)) {
+    std::string name = entry.path().filename().string();
+    auto is_number = [](const std::string &str) {
+      return !str.empty() && std::all_of(str.begin(), str.end(), [](char c) { return std::isdigit(c) != 0; });
+    };
+    if (name == base_name) {
+      first_segment = 0;
+    } else if (name.compare(0, free_prefix.size(), free_prefix) == 0 && is_number(name.substr(free_prefix.size()))) {
+      free_log_segments_.push_back(std::stoi(name.substr(free_prefix.size())));
+    } else if (name.compare(0, base_name.size() + 1, base_name + ".") == 0 &&
+               is_number(name.substr(base_name.size() + 1))) {
+      int segment = std::stoi(name.substr(base_name.size() + 1));
+      first_segment = first_segment < 0 ? segment : std::min(first_segment, segment);
+    }
+  }
+
+  int segment = std::max(first_segment, 0);
+  log_start_offset_ = static_cast<int64_t>(segment) * log_segment_size_;
+  while (GetFileSize(GetLogSegmentName(segment)) == log_segment_size_) {
+    segment++;
+  }
+  int size = GetFileSize(GetLogSegmentName(segment));
+  log_end_offset_ = static_cast<int64_t>(segment) * log_segment_size_ + std::max(size, 0);
+  log_fd_ = size < 0 ? CreateLogSegment(segment) : open(GetLogSegmentName(segment).c_str(), O_RDWR);
+  if (log_fd_ < 0) {
+    throw Exception("can't open dblog file");
+  }
+  return true;
+}
+
+void DiskManager::CloseLogFiles() {
+  std::scoped_lock log_guard(log_io_latch_);
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+    log_fd_ = -1;
+  }
+  if (log_read_fd_ >= 0) {
+    close(log_read_fd_);
+    log_read_fd_ = -1;
+    log_read_segment_ = -1;
+  }
+}
+
 /**
  * Close all file streams
  */
@@ -71,7 +132,7 @@ void DiskManager::ShutDown() {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
   }
-  log_io_.close();
+  CloseLogFiles();
 }
 
 /**
@@ -143,45 +204,197 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
-  // sequence write
-  log_io_.write(log_data, size);
-
-  // check for I/O error
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while writing log");
-    return;
+  // sequence write, a write that crosses the end of a segment continues in the next one
+  std::scoped_lock log_guard(log_io_latch_);
+  while (size > 0) {
+    if (log_fd_ < 0) {
+      log_fd_ = CreateLogSegment(static_cast<int>(log_end_offset_ / log_segment_size_));
+      if (log_fd_ < 0) {
+        LOG_DEBUG("I/O error while creating log segment");
+        return;
+      }
+    }
+    auto segment_offset = static_cast<int>(log_end_offset_ % log_segment_size_);
+    int write_size = std::min(size, log_segment_size_ - segment_offset);
+    // check for I/O error
+    if (pwrite(log_fd_, log_data, write_size, segment_offset) != write_size) {
+      LOG_DEBUG("I/O error while writing log");
+      return;
+    }
+    log_data += write_size;
+    size -= write_size;
+    log_end_offset_ += write_size;
+    if (log_end_offset_ % log_segment_size_ == 0) {
+      close(log_fd_);
+      log_fd_ = -1;
+    }
   }
-  // needs to flush to keep disk file in sync
-  log_io_.flush();
   flush_log_ = false;
 }
 
 /**
  * Read the contents of the log into the given memory area
- * Always read from the beginning and perform sequence read
- * @return: false means already reach the end
+ * Perform sequence read from offset, across segment boundaries
+ * @return: false means already reach the end, or the offset was truncated
  */
-auto DiskManager::ReadLog(char *log_data, int size, int offset) -> bool {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
+auto DiskManager::ReadLog(char *log_data, int size, int64_t offset) -> bool {
+  std::scoped_lock log_guard(log_io_latch_);
+  if (offset < log_start_offset_ || offset >= log_end_offset_) {
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
+  int read_count = 0;
+  while (read_count < size && offset + read_count < log_end_offset_) {
+    int64_t position = offset + read_count;
+    auto segment = static_cast<int>(position / log_segment_size_);
+    if (segment != log_read_segment_) {
+      if (log_read_fd_ >= 0) {
+        close(log_read_fd_);
+      }
+      log_read_fd_ = open(GetLogSegmentName(segment).c_str(), O_RDONLY);
+      log_read_segment_ = log_read_fd_ < 0 ? -1 : segment;
+      if (log_read_fd_ < 0) {
+        LOG_DEBUG("I/O error while opening log segment");
+        return false;
+      }
+    }
+    auto segment_offset = static_cast<int>(position % log_segment_size_);
+    auto chunk = static_cast<int>(std::min<int64_t>(
+        {size - read_count, log_segment_size_ - segment_offset, log_end_offset_ - position}));
+    ssize_t count = pread(log_read_fd_, log_data + read_count, chunk, segment_offset);
+    if (count <= 0) {
+      LOG_DEBUG("I/O error while reading log");
+      return false;
+    }
+    read_count += static_cast<int>(count);
+  }
+  // if log file ends before reading "size"
+  memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
+
+/**
+ * Recycle every segment that ends at or before offset
+ */
+void DiskManager::TruncateLog(int64_t offset) {
+  std::scoped_lock log_guard(log_io_latch_);
+  if (log_name_.empty()) {
+    return;
+  }
+  auto end_segment = static_cast<int>(std::min(offset, log_end_offset_) / log_segment_size_);
+  for (auto segment = static_cast<int>(log_start_offset_ / log_segment_size_); segment < end_segment; segment++) {
+    if (log_read_segment_ == segment) {
+      close(log_read_fd_);
+      log_read_fd_ = -1;
+      log_read_segment_ = -1;
+    }
+    if (free_log_segments_.size() < MAX_FREE_LOG_SEGMENTS &&
+        std::rename(GetLogSegmentName(segment).c_str(), GetFreeLogSegmentName(segment).c_str()) == 0) {
+      free_log_segments_.push_back(segment);
+    } else {
+      std::remove(GetLogSegmentName(segment).c_str());
+    }
+  }
+  log_start_offset_ = std::max(log_start_offset_, static_cast<int64_t>(end_segment) * log_segment_size_);
+}
+
+/**
+ * Remove the segments behind offset and cut the segment it lies in back to it
+ */
+void DiskManager::SetLogEndOffset(int64_t offset) {
+  std::scoped_lock log_guard(log_io_latch_);
+  if (log_name_.empty() || offset >= log_end_offset_) {
+    return;
+  }
+  offset = std::max(offset, log_start_offset_);
+  auto segment = static_cast<int>(offset / log_segment_size_);
+  for (auto last = static_cast<int>((log_end_offset_ - 1) / log_segment_size_); last >= segment; last--) {
+    if (log_read_segment_ == last) {
+      close(log_read_fd_);
+      log_read_fd_ = -1;
+      log_read_segment_ = -1;
+    }
+    if (last > segment) {
+      std::remove(GetLogSegmentName(last).c_str());
+    }
+  }
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+  }
+  log_fd_ = open(GetLogSegmentName(segment).c_str(), O_RDWR);
+  if (log_fd_ < 0 || ftruncate(log_fd_, offset % log_segment_size_) != 0) {
+    LOG_DEBUG("I/O error while cutting back the log");
+  }
+  log_end_offset_ = offset;
+}
+
+auto DiskManager::GetLogStartOffset() -> int64_t {
+  std::scoped_lock log_guard(log_io_latch_);
+  return log_start_offset_;
+}
+
+auto DiskManager::GetLogEndOffset() -> int64_t {
+  std::scoped_lock log_guard(log_io_latch_);
+  return log_end_offset_;
+}
+
+/**
+ * Write the master record to a temporary file and rename it over the old one, so that a crash leaves either the old or
+ * the new master record behind. The file is synced before the rename and the directory after it, only then is the new
+ * master record durable
+ */
+void DiskManager::WriteMasterRecord(const MasterRecord &master_record) {
+  if (master_name_.empty()) {
+    return;
+  }
+  std::string tmp_name = master_name_ + ".tmp";
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG_DEBUG("I/O error while creating master record");
+    return;
+  }
+  bool written = write(fd, &master_record, sizeof(MasterRecord)) == sizeof(MasterRecord) && fsync(fd) == 0;
+  close(fd);
+  if (!written) {
+    LOG_DEBUG("I/O error while writing master record");
+    return;
+  }
+  if (std::rename(tmp_name.c_str(), master_name_.c_str()) != 0) {
+    LOG_DEBUG("I/O error while replacing master record");
+    return;
+  }
+  std::filesystem::path master_path(master_name_);
+  auto parent = master_path.has_parent_path() ? master_path.parent_path() : std::filesystem::path(".");
+  int dir_fd = open(parent.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dir_fd < 0 || fsync(dir_fd) != 0) {
+    LOG_DEBUG("I/O error while syncing the directory of the master record");
+  }
+  if (dir_fd >= 0) {
+    close(dir_fd);
+  }
+}
 
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
+/**
+ * Read the master record
+ * @return: false if there is no (complete) master record
+ */
+auto DiskManager::ReadMasterRecord(MasterRecord *master_record) -> bool {
+  if (master_name_.empty()) {
     return false;
   }
-  // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
-  if (read_count < size) {
-    log_io_.clear();
-    memset(log_data + read_count, 0, size - read_count);
+  std::ifstream master_io(master_name_, std::ios::binary);
+  if (!master_io.is_open()) {
+    return false;
   }
+  master_io.read(reinterpret_cast<char *>(master_record), sizeof(MasterRecord));
+  return master_io.gcount() == sizeof(MasterRecord);
+}
 
-  return true;
+/**
+ * Returns the number of pages in the db file, a partly written last page included
+ */
+auto DiskManager::GetNumPages() const -> page_id_t {
+  int size = GetFileSize(file_name_);
+  return size <= 0 ? 0 : (size + PAGE_SIZE - 1) / PAGE_SIZE;
 }
 
 /**
@@ -199,10 +412,52 @@ auto DiskManager::GetNumWrites() const -> int { return num_writes_; }
  */
 auto DiskManager::GetFlushState() const -> bool { return flush_log_; }
 
+auto DiskManager::GetLogSegmentName(int segment) const -> std::string {
+  return segment == 0 ? log_name_ : log_name_ + "." + std::to_string(segment);
+}
+
+auto DiskManager::GetFreeLogSegmentName(int segment) const -> std::string {
+  return log_name_ + ".free." + std::to_string(segment);
+}
+
+/**
+ * Private helper function to start a new log segment
+ * A recycled file is renamed into place and kept as it is: its blocks are allocated already, and its old records are
+ * overwritten as the log grows. A new file is empty, its space is reserved up front where the file system supports it.
+ */
+auto DiskManager::CreateLogSegment(int segment) -> int {
+  std::string name = GetLogSegmentName(segment);
+  bool reused = false;
+  if (!free_log_segments_.empty()) {
+    std::string free_name = GetFreeLogSegmentName(free_log_segments_.back());
+    free_log_segments_.pop_back();
+    reused = std::rename(free_name.c_str(), name.c_str()) == 0;
+    if (!reused) {
+      LOG_DEBUG("can't reuse free log segment");
+    }
+  }
+  // a reader may still hold a file that used to have this name
+  if (log_read_segment_ == segment) {
+    close(log_read_fd_);
+    log_read_fd_ = -1;
+    log_read_segment_ = -1;
+  }
+  if (reused) {
+    return open(name.c_str(), O_RDWR);
+  }
+  int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#ifdef __linux__
+  if (fd >= 0) {
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, log_segment_size_);
+  }
+#endif
+  return fd;
+}
+
 /**
  * Private helper function to get disk file size
  */
-auto DiskManager::GetFileSize(const std::string &file_name) -> int {
+auto DiskManager::GetFileSize(const std::string &file_name) const -> int {
   struct stat stat_buf;
   int rc = stat(file_name.c_str(), &stat_buf);
   return rc == 0 ? static_cast<int>(stat_buf.st_size) : -1;
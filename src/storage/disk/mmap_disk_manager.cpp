@@ -0,0 +1,110 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// mmap_disk_manager.cpp
+//
+// Identification: src/storage/disk/mmap_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "storage/disk/mmap_disk_manager.h"
+
+namespace bustub {
+
+MmapDiskManager::MmapDiskManager(const std::string &db_file) {
+  file_name_ = db_file;
+  fd_ = open(db_file.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    throw Exception("can't open db file");
+  }
+  struct stat stat_buf;
+  if (fstat(fd_, &stat_buf) != 0) {
+    close(fd_);
+    throw Exception("can't stat db file");
+  }
+  file_size_ = static_cast<size_t>(stat_buf.st_size);
+  // An empty file cannot be mapped, every read will simply come back zeroed.
+  if (file_size_ > 0) {
+    void *addr = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED) {
+      close(fd_);
+      throw Exception("can't mmap db file");
+    }
+    data_ = static_cast<char *>(addr);
+  }
+}
+
+MmapDiskManager::~MmapDiskManager() { ShutDown(); }
+
+void MmapDiskManager::ShutDown() {
+  if (data_ != nullptr) {
+    munmap(data_, file_size_);
+    data_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void MmapDiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  throw Exception("can't write page to a read-only database");
+}
+
+/**
+ * Copy the page out of the mapping. When the caller walks the file page by page, keep the kernel one readahead
+ * window ahead of it.
+ */
+void MmapDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  const char *view = GetPageView(page_id);
+  if (view == nullptr) {
+    LOG_DEBUG("I/O error reading past end of file");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  if (last_read_page_id_.exchange(page_id) == page_id - 1 &&
+      page_id + READAHEAD_PAGES / 2 >= prefetched_until_.load()) {
+    page_id_t window_start = std::max(page_id + 1, prefetched_until_.load());
+    prefetched_until_ = page_id + 1 + READAHEAD_PAGES;
+    Prefetch(window_start, page_id + 1 + READAHEAD_PAGES - window_start);
+  }
+  memcpy(page_data, view, PAGE_SIZE);
+}
+
+void MmapDiskManager::WriteLog(char *log_data, int size) {
+  throw Exception("can't write log to a read-only database");
+}
+
+auto MmapDiskManager::ReadLog(char *log_data, int size, int64_t offset) -> bool { return false; }
+
+auto MmapDiskManager::GetPageView(page_id_t page_id) const -> const char * {
+  if (data_ == nullptr || page_id < 0 || page_id >= GetNumPages()) {
+    return nullptr;
+  }
+  return data_ + static_cast<size_t>(page_id) * PAGE_SIZE;
+}
+
+void MmapDiskManager::Prefetch(page_id_t first_page_id, int num_pages) {
+  page_id_t last_page_id = std::min(first_page_id + num_pages, GetNumPages());
+  if (data_ == nullptr || first_page_id < 0 || first_page_id >= last_page_id) {
+    return;
+  }
+  // Page boundaries are multiples of PAGE_SIZE and therefore of the OS page size as well.
+  madvise(data_ + static_cast<size_t>(first_page_id) * PAGE_SIZE,
+          static_cast<size_t>(last_page_id - first_page_id) * PAGE_SIZE, MADV_WILLNEED);
+}
+
+}  // namespace bustub
@@ -0,0 +1,125 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// segmented_disk_manager.cpp
+//
+// Identification: src/storage/disk/segmented_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "common/macros.h"
+#include "storage/disk/segmented_disk_manager.h"
+
+namespace bustub {
+
+SegmentedDiskManager::SegmentedDiskManager(const std::string &db_file, std::vector<std::string> directories,
+                                           int pages_per_segment)
+    : directories_(std::move(directories)), pages_per_segment_(pages_per_segment) {
+  BUSTUB_ASSERT(pages_per_segment_ > 0, "A segment must hold at least one page.");
+  file_name_ = db_file;
+  OpenLogFile();
+  // Make sure the first segment can actually be created, so that a bad path fails right away.
+  GetSegmentFd(0);
+}
+
+SegmentedDiskManager::~SegmentedDiskManager() { ShutDown(); }
+
+void SegmentedDiskManager::ShutDown() {
+  {
+    std::unique_lock segment_guard(segment_latch_);
+    for (auto &fd : segment_fds_) {
+      if (fd >= 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+  }
+  CloseLogFiles();
+}
+
+/**
+ * Write the contents of the specified page into its segment file
+ */
+void SegmentedDiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  int fd = GetSegmentFd(page_id / pages_per_segment_);
+  off_t offset = static_cast<off_t>(page_id % pages_per_segment_) * PAGE_SIZE;
+  num_writes_ += 1;
+  if (pwrite(fd, page_data, PAGE_SIZE, offset) != PAGE_SIZE) {
+    LOG_DEBUG("I/O error while writing");
+  }
+}
+
+/**
+ * Read the contents of the specified page into the given memory area
+ */
+void SegmentedDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  int fd = GetSegmentFd(page_id / pages_per_segment_);
+  off_t offset = static_cast<off_t>(page_id % pages_per_segment_) * PAGE_SIZE;
+  ssize_t read_count = pread(fd, page_data, PAGE_SIZE, offset);
+  if (read_count < 0) {
+    LOG_DEBUG("I/O error while reading");
+    return;
+  }
+  // if the segment ends before reading PAGE_SIZE
+  if (read_count < PAGE_SIZE) {
+    LOG_DEBUG("Read less than a page");
+    memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+  }
+}
+
+auto SegmentedDiskManager::GetNumPages() const -> page_id_t {
+  const int segment_size = pages_per_segment_ * PAGE_SIZE;
+  size_t segment_id = 0;
+  while (GetFileSize(GetSegmentFileName(segment_id)) >= segment_size) {
+    segment_id++;
+  }
+  int size = GetFileSize(GetSegmentFileName(segment_id));
+  page_id_t num_pages = size <= 0 ? 0 : (size + PAGE_SIZE - 1) / PAGE_SIZE;
+  return static_cast<page_id_t>(segment_id) * pages_per_segment_ + num_pages;
+}
+
+auto SegmentedDiskManager::GetSegmentFileName(size_t segment_id) const -> std::string {
+  if (directories_.empty()) {
+    return file_name_ + "." + std::to_string(segment_id);
+  }
+  std::string::size_type n = file_name_.rfind('/');
+  std::string base_name = n == std::string::npos ? file_name_ : file_name_.substr(n + 1);
+  return directories_[segment_id % directories_.size()] + "/" + base_name + "." + std::to_string(segment_id);
+}
+
+auto SegmentedDiskManager::GetSegmentFd(size_t segment_id) -> int {
+  {
+    std::shared_lock segment_guard(segment_latch_);
+    if (segment_id < segment_fds_.size() && segment_fds_[segment_id] >= 0) {
+      return segment_fds_[segment_id];
+    }
+  }
+  std::unique_lock segment_guard(segment_latch_);
+  if (segment_id >= segment_fds_.size()) {
+    segment_fds_.resize(segment_id + 1, -1);
+  }
+  // Somebody else may have opened it while we were waiting for the latch.
+  if (segment_fds_[segment_id] < 0) {
+    int fd = open(GetSegmentFileName(segment_id).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw Exception("can't open db segment file");
+    }
+    segment_fds_[segment_id] = fd;
+  }
+  return segment_fds_[segment_id];
+}
+
+}  // namespace bustub
@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// simulated_disk_manager.cpp
+//
+// Identification: src/storage/disk/simulated_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "storage/disk/simulated_disk_manager.h"
+
+namespace bustub {
+
+SimulatedDiskManager::SimulatedDiskManager(const SimulatedDiskOptions &options)
+    : options_(options), start_time_(std::chrono::steady_clock::now()), rng_(options.seed_) {}
+
+void SimulatedDiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  SimulateIo(IoTraceEntry::Op::WRITE_PAGE, page_id, PAGE_SIZE);
+  std::scoped_lock data_guard(data_latch_);
+  auto &page = pages_[page_id];
+  if (page == nullptr) {
+    page = std::make_unique<char[]>(PAGE_SIZE);
+  }
+  num_writes_ += 1;
+  memcpy(page.get(), page_data, PAGE_SIZE);
+}
+
+void SimulatedDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  SimulateIo(IoTraceEntry::Op::READ_PAGE, page_id, PAGE_SIZE);
+  std::scoped_lock data_guard(data_latch_);
+  auto it = pages_.find(page_id);
+  if (it == pages_.end()) {
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  memcpy(page_data, it->second.get(), PAGE_SIZE);
+}
+
+void SimulatedDiskManager::WriteLog(char *log_data, int size) {
+  if (size == 0) {  // no effect on num_flushes_ if log buffer is empty
+    return;
+  }
+  flush_log_ = true;
+  SimulateIo(IoTraceEntry::Op::WRITE_LOG, INVALID_PAGE_ID, size);
+  {
+    std::scoped_lock data_guard(data_latch_);
+    log_.insert(log_.end(), log_data, log_data + size);
+  }
+  num_flushes_ += 1;
+  flush_log_ = false;
+}
+
+auto SimulatedDiskManager::ReadLog(char *log_data, int size, int64_t offset) -> bool {
+  std::unique_lock data_guard(data_latch_);
+  if (offset >= static_cast<int64_t>(log_.size())) {
+    return false;
+  }
+  auto read_count = static_cast<int>(std::min<int64_t>(size, static_cast<int64_t>(log_.size()) - offset));
+  memcpy(log_data, log_.data() + offset, read_count);
+  data_guard.unlock();
+  // if the log ends before reading "size"
+  memset(log_data + read_count, 0, size - read_count);
+  SimulateIo(IoTraceEntry::Op::READ_LOG, INVALID_PAGE_ID, read_count);
+  return true;
+}
+
+void SimulatedDiskManager::SetLogEndOffset(int64_t offset) {
+  std::scoped_lock data_guard(data_latch_);
+  if (offset < static_cast<int64_t>(log_.size())) {
+    log_.resize(offset);
+  }
+}
+
+auto SimulatedDiskManager::GetLogEndOffset() -> int64_t {
+  std::scoped_lock data_guard(data_latch_);
+  return static_cast<int64_t>(log_.size());
+}
+
+void SimulatedDiskManager::WriteMasterRecord(const MasterRecord &master_record) {
+  SimulateIo(IoTraceEntry::Op::WRITE_LOG, INVALID_PAGE_ID, sizeof(MasterRecord));
+  std::scoped_lock data_guard(data_latch_);
+  master_record_ = master_record;
+  has_master_record_ = true;
+}
+
+auto SimulatedDiskManager::ReadMasterRecord(MasterRecord *master_record) -> bool {
+  std::scoped_lock data_guard(data_latch_);
+  *master_record = master_record_;
+  return has_master_record_;
+}
+
+auto SimulatedDiskManager::GetNumPages() const -> page_id_t {
+  std::scoped_lock data_guard(data_latch_);
+  page_id_t num_pages = 0;
+  for (const auto &[page_id, page] : pages_) {
+    num_pages = std::max(num_pages, page_id + 1);
+  }
+  return num_pages;
+}
+
+auto SimulatedDiskManager::GetTrace() -> std::vector<IoTraceEntry> {
+  std::scoped_lock io_guard(io_latch_);
+  return trace_;
+}
+
+void SimulatedDiskManager::ClearTrace() {
+  std::scoped_lock io_guard(io_latch_);
+  trace_.clear();
+}
+
+auto SimulatedDiskManager::GetSimulatedTime() -> std::chrono::microseconds {
+  std::scoped_lock io_guard(io_latch_);
+  return simulated_time_;
+}
+
+void SimulatedDiskManager::SimulateIo(IoTraceEntry::Op op, page_id_t page_id, int size) {
+  std::unique_lock io_guard(io_latch_);
+  // Wait for a free slot in the device queue.
+  queue_cv_.wait(io_guard, [&] { return options_.queue_depth_ == 0 || in_flight_ < options_.queue_depth_; });
+  in_flight_++;
+
+  bool is_read = op == IoTraceEntry::Op::READ_PAGE || op == IoTraceEntry::Op::READ_LOG;
+  auto latency = DrawLatency(is_read ? options_.read_latency_ : options_.write_latency_);
+  std::chrono::microseconds now;
+  if (options_.sleep_) {
+    now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time_);
+  } else {
+    // Issued right after the previous I/O, or once the earliest I/O in flight is done if the queue is full.
+    while (!completions_.empty() && completions_.top() <= clock_) {
+      completions_.pop();
+    }
+    if (options_.queue_depth_ > 0 && completions_.size() >= options_.queue_depth_) {
+      clock_ = completions_.top();
+      completions_.pop();
+    }
+    now = clock_;
+  }
+  // The transfer itself is serialized on the channel, which is what enforces the bandwidth cap.
+  auto transfer_start = std::max(now + latency, channel_free_time_);
+  std::chrono::microseconds transfer_time{0};
+  if (options_.bandwidth_bytes_per_sec_ > 0) {
+    transfer_time = std::chrono::microseconds(static_cast<int64_t>(size) * 1000000 /
+                                              static_cast<int64_t>(options_.bandwidth_bytes_per_sec_));
+  }
+  channel_free_time_ = transfer_start + transfer_time;
+  auto total = channel_free_time_ - now;
+  simulated_time_ += total;
+  if (!options_.sleep_ && options_.queue_depth_ > 0) {
+    completions_.push(channel_free_time_);
+  }
+  if (options_.trace_) {
+    trace_.push_back({op, page_id, size, now, total});
+  }
+
+  if (options_.sleep_) {
+    io_guard.unlock();
+    std::this_thread::sleep_for(total);
+    io_guard.lock();
+  }
+  in_flight_--;
+  queue_cv_.notify_one();
+}
+
+auto SimulatedDiskManager::DrawLatency(const LatencyDistribution &distribution) -> std::chrono::microseconds {
+  switch (distribution.kind_) {
+    case LatencyDistribution::Kind::CONSTANT:
+      return distribution.mean_;
+    case LatencyDistribution::Kind::UNIFORM: {
+      std::uniform_int_distribution<int64_t> uniform(
+          std::max<int64_t>(0, (distribution.mean_ - distribution.spread_).count()),
+          (distribution.mean_ + distribution.spread_).count());
+      return std::chrono::microseconds(uniform(rng_));
+    }
+    case LatencyDistribution::Kind::EXPONENTIAL: {
+      if (distribution.mean_.count() == 0) {
+        return distribution.mean_;
+      }
+      std::exponential_distribution<double> exponential(1.0 / static_cast<double>(distribution.mean_.count()));
+      return std::chrono::microseconds(static_cast<int64_t>(exponential(rng_)));
+    }
+  }
+  return distribution.mean_;
+}
+
+}  // namespace bustub
@@ -9,10 +9,13 @@ namespace bustub {
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_INDEX_TYPE::ExtendibleHashTableIndex(std::unique_ptr<IndexMetadata> &&metadata,
                                                 BufferPoolManager *buffer_pool_manager,
-                                                const HashFunction<KeyType> &hash_fn)
+                                                const HashFunction<KeyType> &hash_fn, LogManager *log_manager,
+                                                LockManager *lock_manager, index_oid_t index_oid)
     : Index(std::move(metadata)),
       comparator_(GetMetadata()->GetKeySchema()),
-      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_, hash_fn) {}
+      lock_manager_(lock_manager),
+      index_oid_(index_oid),
+      container_(GetMetadata()->GetName(), buffer_pool_manager, comparator_, hash_fn, log_manager) {}
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_INDEX_TYPE::InsertEntry(const Tuple &key, RID rid, Transaction *transaction) {
@@ -34,6 +37,15 @@ void HASH_TABLE_INDEX_TYPE::DeleteEntry(const Tuple &key, RID rid, Transaction *
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) {
+  // keep writers from adding or removing entries under the key until a repeatable read finishes
+  if (lock_manager_ != nullptr && transaction != nullptr) {
+    auto reason = transaction->GetState() == TransactionState::SHRINKING ? AbortReason::LOCK_ON_SHRINKING
+                                                                         : AbortReason::DEADLOCK;
+    if (!lock_manager_->LockIndexKey(transaction, index_oid_, key, LockMode::SHARED)) {
+      throw TransactionAbortException(transaction->GetTransactionId(), reason);
+    }
+  }
+
   // construct scan index key
   KeyType index_key;
   index_key.SetFromKey(key);
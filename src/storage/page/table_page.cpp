@@ -266,6 +266,35 @@ void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log
   }
 }
 
+void TablePage::ApplyTupleDelta(const RID &rid, const std::vector<std::pair<uint32_t, uint32_t>> &ranges,
+                                const char *data) {
+  uint32_t slot_num = rid.GetSlotNum();
+  BUSTUB_ASSERT(slot_num < GetTupleCount(), "We can't have more slots than tuples.");
+  uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
+  for (const auto &[offset, length] : ranges) {
+    BUSTUB_ASSERT(offset + length <= UnsetDeletedFlag(GetTupleSize(slot_num)), "The delta must lie within the tuple.");
+    memcpy(GetData() + tuple_offset + offset, data, length);
+    data += length;
+  }
+}
+
+void TablePage::RestoreTuple(const RID &rid, const Tuple &tuple) {
+  uint32_t slot_num = rid.GetSlotNum();
+  BUSTUB_ASSERT(slot_num <= GetTupleCount(), "We can't skip slots.");
+  bool new_slot = slot_num == GetTupleCount();
+  BUSTUB_ASSERT(new_slot || GetTupleSize(slot_num) == 0, "The slot of the tuple must be empty.");
+  BUSTUB_ASSERT(GetFreeSpaceRemaining() >= tuple.size_ + (new_slot ? SIZE_TUPLE : 0), "The tuple must fit.");
+
+  // Claim the free space like an insert, only the slot is given.
+  SetFreeSpacePointer(GetFreeSpacePointer() - tuple.size_);
+  memcpy(GetData() + GetFreeSpacePointer(), tuple.data_, tuple.size_);
+  SetTupleOffsetAtSlot(slot_num, GetFreeSpacePointer());
+  SetTupleSize(slot_num, tuple.size_);
+  if (new_slot) {
+    SetTupleCount(GetTupleCount() + 1);
+  }
+}
+
 auto TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) -> bool {
   // Get the current slot number.
   uint32_t slot_num = rid.GetSlotNum();
@@ -294,6 +323,18 @@ auto TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   }
 
   // At this point, we have at least a shared lock on the RID. Copy the tuple data into our result.
+  return ReadTuple(rid, tuple);
+}
+
+auto TablePage::ReadTuple(const RID &rid, Tuple *tuple) -> bool {
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= GetTupleCount()) {
+    return false;
+  }
+  uint32_t tuple_size = GetTupleSize(slot_num);
+  if (IsDeleted(tuple_size)) {
+    return false;
+  }
   uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
   tuple->size_ = tuple_size;
   if (tuple->allocated_) {
@@ -83,6 +83,12 @@ auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> b
   }
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
+  if (enable_mvcc) {
+    versions_.SaveVersion(*rid, txn, nullptr);
+  }
+  if (enable_occ) {
+    tuple_versions_.Write(*rid, txn);
+  }
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -91,6 +97,10 @@ auto TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) -> b
 }
 
 auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
+  if (IsBuffering(txn)) {
+    txn->GetBufferedWriteSet()->insert_or_assign(rid, TableWriteRecord(rid, WType::DELETE, Tuple{}, this));
+    return true;
+  }
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -101,7 +111,22 @@ auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  if (enable_mvcc && !versions_.CanWrite(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  Tuple old_tuple;
+  bool has_old = enable_mvcc && page->ReadTuple(rid, &old_tuple);
+  if (page->MarkDelete(rid, txn, lock_manager_, log_manager_)) {
+    if (has_old) {
+      versions_.SaveVersion(rid, txn, &old_tuple);
+    }
+    if (enable_occ) {
+      tuple_versions_.Write(rid, txn);
+    }
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +135,15 @@ auto TableHeap::MarkDelete(const RID &rid, Transaction *txn) -> bool {
 }
 
 auto TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) -> bool {
+  if (IsBuffering(txn)) {
+    auto buffered = txn->GetBufferedWriteSet();
+    auto it = buffered->find(rid);
+    if (it != buffered->end() && it->second.wtype_ == WType::DELETE) {
+      return false;
+    }
+    buffered->insert_or_assign(rid, TableWriteRecord(rid, WType::UPDATE, tuple, this));
+    return true;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,7 +154,19 @@ auto TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
+  if (enable_mvcc && !versions_.CanWrite(rid, txn)) {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
   bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (is_updated && enable_mvcc) {
+    versions_.SaveVersion(rid, txn, &old_tuple);
+  }
+  if (is_updated && enable_occ) {
+    tuple_versions_.Write(rid, txn);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
@@ -153,7 +199,47 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+void TableHeap::ApplyDeletes(page_id_t page_id, const std::vector<RID> &rids, Transaction *txn) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  page->WLatch();
+  for (const auto &rid : rids) {
+    page->ApplyDelete(rid, txn, log_manager_);
+    lock_manager_->Unlock(txn, rid);
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
+void TableHeap::RollbackWrites(page_id_t page_id, const std::vector<const TableWriteRecord *> &records,
+                               Transaction *txn) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+  page->WLatch();
+  // Undone newest first, the page goes back through the states it went through.
+  for (const auto *record : records) {
+    if (record->wtype_ == WType::DELETE) {
+      page->RollbackDelete(record->rid_, txn, log_manager_);
+    } else if (record->wtype_ == WType::INSERT) {
+      page->ApplyDelete(record->rid_, txn, log_manager_);
+      lock_manager_->Unlock(txn, record->rid_);
+    } else if (record->wtype_ == WType::UPDATE) {
+      // The saved version and the writer mark of the tuple are those of txn already.
+      Tuple new_tuple;
+      page->UpdateTuple(record->tuple_, &new_tuple, record->rid_, txn, lock_manager_, log_manager_);
+    }
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
+
 auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+  if (txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC) {
+    return GetOptimisticTuple(rid, tuple, txn);
+  }
+  if (txn->IsReadOnly()) {
+    return GetSnapshotTuple(rid, tuple, txn);
+  }
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -169,6 +255,87 @@ auto TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool
   return res;
 }
 
+auto TableHeap::GetOptimisticTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+  // The transaction sees its own writes.
+  auto buffered = txn->GetBufferedWriteSet()->find(rid);
+  if (buffered != txn->GetBufferedWriteSet()->end()) {
+    if (buffered->second.wtype_ == WType::DELETE) {
+      return false;
+    }
+    *tuple = buffered->second.tuple_;
+    tuple->rid_ = rid;
+    return true;
+  }
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // Writers mark the tuple under the page latch, so the version read goes with the tuple read.
+  page->RLatch();
+  uint64_t version;
+  bool readable = tuple_versions_.Read(rid, txn, &version);
+  bool res = readable && page->ReadTuple(rid, tuple);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  if (!readable) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // An empty slot is read too, so that a later insert into it fails the validation.
+  txn->GetReadSet()->emplace_back(rid, this, version);
+  return res;
+}
+
+auto TableHeap::GetSnapshotTuple(const RID &rid, Tuple *tuple, Transaction *txn) -> bool {
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // The page latch keeps writers from changing the heap between resolving the version and copying it.
+  page->RLatch();
+  bool res = false;
+  switch (versions_.Resolve(rid, txn, tuple)) {
+    case VersionStore::Visibility::HEAP:
+      res = page->ReadTuple(rid, tuple);
+      break;
+    case VersionStore::Visibility::VERSION:
+      tuple->rid_ = rid;
+      res = true;
+      break;
+    case VersionStore::Visibility::NONE:
+      break;
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  return res;
+}
+
+auto TableHeap::NextSlot(RID *rid) -> bool {
+  auto page_id = rid->GetPageId();
+  uint32_t slot = rid->GetSlotNum() + 1;
+  if (page_id == INVALID_PAGE_ID) {
+    page_id = first_page_id_;
+    slot = 0;
+  }
+  while (page_id != INVALID_PAGE_ID) {
+    auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    page->RLatch();
+    uint32_t tuple_count = page->GetTupleCount();
+    auto next_page_id = page->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    if (slot < tuple_count) {
+      rid->Set(page_id, slot);
+      return true;
+    }
+    page_id = next_page_id;
+    slot = 0;
+  }
+  return false;
+}
+
 auto TableHeap::Begin(Transaction *txn) -> TableIterator {
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
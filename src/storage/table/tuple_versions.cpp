@@ -0,0 +1,85 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_versions.cpp
+//
+// Identification: src/storage/table/tuple_versions.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/tuple_versions.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+auto TupleVersions::Read(const RID &rid, Transaction *txn, uint64_t *version) -> bool {
+  auto &partition = GetPartition(rid);
+  std::scoped_lock guard(partition.latch_);
+  auto it = partition.entries_.find(rid);
+  if (it == partition.entries_.end()) {
+    *version = 0;
+    return true;
+  }
+  *version = it->second.version_;
+  return it->second.writer_ == INVALID_TXN_ID || it->second.writer_ == txn->GetTransactionId();
+}
+
+void TupleVersions::Write(const RID &rid, Transaction *txn) {
+  auto &partition = GetPartition(rid);
+  std::scoped_lock guard(partition.latch_);
+  partition.entries_[rid].writer_ = txn->GetTransactionId();
+}
+
+void TupleVersions::Release(const RID &rid, Transaction *txn, timestamp_t ts) {
+  auto &partition = GetPartition(rid);
+  std::scoped_lock guard(partition.latch_);
+  auto it = partition.entries_.find(rid);
+  if (it == partition.entries_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  it->second.writer_ = INVALID_TXN_ID;
+  it->second.version_ = ++last_version_;
+  it->second.ts_ = std::max(it->second.ts_, ts);
+  partition.released_.emplace_back(ts, rid);
+}
+
+auto TupleVersions::Validate(const RID &rid, Transaction *txn, uint64_t version) -> bool {
+  auto &partition = GetPartition(rid);
+  std::scoped_lock guard(partition.latch_);
+  auto it = partition.entries_.find(rid);
+  // Dropped, so nothing changed the slot since the transaction began.
+  if (it == partition.entries_.end()) {
+    return true;
+  }
+  return (it->second.writer_ == INVALID_TXN_ID || it->second.writer_ == txn->GetTransactionId()) &&
+         it->second.version_ == version;
+}
+
+void TupleVersions::Collect(timestamp_t watermark) {
+  for (auto &partition : partitions_) {
+    std::scoped_lock guard(partition.latch_);
+    while (!partition.released_.empty() && partition.released_.front().first <= watermark) {
+      auto it = partition.entries_.find(partition.released_.front().second);
+      // A slot changed again since keeps its entry until that change is old enough too.
+      if (it != partition.entries_.end() && it->second.writer_ == INVALID_TXN_ID && it->second.ts_ <= watermark) {
+        partition.entries_.erase(it);
+      }
+      partition.released_.pop_front();
+    }
+  }
+}
+
+auto TupleVersions::Size() -> size_t {
+  size_t size = 0;
+  for (auto &partition : partitions_) {
+    std::scoped_lock guard(partition.latch_);
+    size += partition.entries_.size();
+  }
+  return size;
+}
+
+}  // namespace bustub
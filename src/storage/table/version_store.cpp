@@ -0,0 +1,103 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/storage/table/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/table/version_store.h"
+
+namespace bustub {
+
+auto VersionStore::CanWrite(const RID &rid, Transaction *txn) -> bool {
+  if (txn->GetIsolationLevel() != IsolationLevel::SNAPSHOT_ISOLATION) {
+    return true;
+  }
+  std::scoped_lock guard(latch_);
+  auto it = chains_.find(rid);
+  // The first committer wins, a later snapshot has to start over.
+  return it == chains_.end() || it->second.writer_ != INVALID_TXN_ID || it->second.ts_ <= txn->GetReadTs();
+}
+
+void VersionStore::SaveVersion(const RID &rid, Transaction *txn, const Tuple *old) {
+  std::scoped_lock guard(latch_);
+  auto &chain = chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    return;
+  }
+  chain.versions_.push_back({chain.ts_, old != nullptr, old != nullptr ? *old : Tuple{}});
+  chain.writer_ = txn->GetTransactionId();
+}
+
+void VersionStore::Commit(const RID &rid, Transaction *txn, timestamp_t commit_ts) {
+  std::scoped_lock guard(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  it->second.writer_ = INVALID_TXN_ID;
+  it->second.ts_ = commit_ts;
+  committed_.emplace_back(commit_ts, rid);
+}
+
+void VersionStore::Rollback(const RID &rid, Transaction *txn) {
+  std::scoped_lock guard(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  auto &chain = it->second;
+  chain.writer_ = INVALID_TXN_ID;
+  chain.ts_ = chain.versions_.back().ts_;
+  chain.versions_.pop_back();
+  if (chain.versions_.empty()) {
+    chains_.erase(it);
+  }
+}
+
+auto VersionStore::Resolve(const RID &rid, Transaction *txn, Tuple *tuple) -> Visibility {
+  std::scoped_lock guard(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end()) {
+    return Visibility::HEAP;
+  }
+  const auto &chain = it->second;
+  if (chain.writer_ == txn->GetTransactionId() ||
+      (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= txn->GetReadTs())) {
+    return Visibility::HEAP;
+  }
+  for (auto version = chain.versions_.rbegin(); version != chain.versions_.rend(); ++version) {
+    if (version->ts_ <= txn->GetReadTs()) {
+      if (!version->exists_) {
+        return Visibility::NONE;
+      }
+      *tuple = version->tuple_;
+      return Visibility::VERSION;
+    }
+  }
+  return Visibility::NONE;
+}
+
+void VersionStore::Collect(timestamp_t watermark) {
+  std::scoped_lock guard(latch_);
+  while (!committed_.empty() && committed_.front().first <= watermark) {
+    auto it = chains_.find(committed_.front().second);
+    // A tuple changed again since keeps its chain until that change is old enough too.
+    if (it != chains_.end() && it->second.writer_ == INVALID_TXN_ID && it->second.ts_ <= watermark) {
+      chains_.erase(it);
+    }
+    committed_.pop_front();
+  }
+}
+
+auto VersionStore::Size() -> size_t {
+  std::scoped_lock guard(latch_);
+  return chains_.size();
+}
+
+}  // namespace bustub
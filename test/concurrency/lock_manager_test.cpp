@@ -2,13 +2,21 @@
  * lock_manager_test.cpp
  */
 
+#include <array>
+#include <atomic>
+#include <future>  // NOLINT
+#include <numeric>
 #include <random>
+#include <string>
 #include <thread>  // NOLINT
+#include <vector>
 
+#include "catalog/schema.h"
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -204,4 +212,556 @@ void WoundWaitBasicTest() {
 }
 TEST(LockManagerTest, WoundWaitBasicTest) { WoundWaitBasicTest(); }
 
+// Transactions locking different records in different partitions of the lock table
+void PartitionTest() {
+  LockManager lock_mgr{4};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID shared_rid{100, 0};
+
+  const int num_txns = 8;
+  const int num_rids = 100;
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < num_txns; i++) {
+    txns.push_back(txn_mgr.Begin());
+  }
+  auto task = [&](int txn_id) {
+    Transaction *txn = txns[txn_id];
+    // Everybody shares one record, the others belong to this transaction alone.
+    EXPECT_TRUE(lock_mgr.LockShared(txn, shared_rid));
+    for (int i = 0; i < num_rids; i++) {
+      EXPECT_TRUE(lock_mgr.LockExclusive(txn, RID{i, static_cast<uint32_t>(txn_id)}));
+    }
+    CheckGrowing(txn);
+    CheckTxnLockSize(txn, 1, num_rids);
+    txn_mgr.Commit(txn);
+    CheckCommitted(txn);
+    CheckTxnLockSize(txn, 0, 0);
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_txns; i++) {
+    threads.emplace_back(task, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // The released records can be locked again.
+  Transaction *txn = txn_mgr.Begin();
+  for (int i = 0; i < num_txns; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(txn, RID{0, static_cast<uint32_t>(i)}));
+  }
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn, shared_rid));
+  txn_mgr.Commit(txn);
+  delete txn;
+  for (auto *committed : txns) {
+    delete committed;
+  }
+}
+TEST(LockManagerTest, PartitionTest) { PartitionTest(); }
+
+// Table locks in the intention modes next to the record locks underneath
+void TableLockTest() {
+  using LockMode = LockManager::LockMode;
+  // Compatibility matrix, in the order IS, IX, S, SIX, X.
+  std::vector<LockMode> modes{LockMode::INTENTION_SHARED, LockMode::INTENTION_EXCLUSIVE, LockMode::SHARED,
+                              LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::EXCLUSIVE};
+  std::vector<std::vector<bool>> compatible{{true, true, true, true, false},
+                                            {true, true, false, false, false},
+                                            {true, false, true, false, false},
+                                            {true, false, false, false, false},
+                                            {false, false, false, false, false}};
+  for (size_t i = 0; i < modes.size(); i++) {
+    for (size_t j = 0; j < modes.size(); j++) {
+      EXPECT_EQ(compatible[i][j], LockManager::AreCompatible(modes[i], modes[j]));
+    }
+  }
+  EXPECT_EQ(LockMode::SHARED, LockManager::CombineModes(LockMode::INTENTION_SHARED, LockMode::SHARED));
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE,
+            LockManager::CombineModes(LockMode::SHARED, LockMode::INTENTION_EXCLUSIVE));
+  EXPECT_EQ(LockMode::SHARED_INTENTION_EXCLUSIVE,
+            LockManager::CombineModes(LockMode::SHARED_INTENTION_EXCLUSIVE, LockMode::INTENTION_SHARED));
+  EXPECT_EQ(LockMode::EXCLUSIVE, LockManager::CombineModes(LockMode::INTENTION_EXCLUSIVE, LockMode::EXCLUSIVE));
+
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+  RID rid{0, 0};
+
+  Transaction *writer = txn_mgr.Begin();
+  Transaction *reader = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(writer, LockMode::INTENTION_EXCLUSIVE, oid));
+  EXPECT_TRUE(lock_mgr.LockExclusive(writer, rid));
+  // Intention locks get along, the reader only waits for the record.
+  EXPECT_TRUE(lock_mgr.LockTable(reader, LockMode::INTENTION_SHARED, oid));
+  EXPECT_FALSE(reader->IsTableSharedLocked(oid));
+
+  // Reading the whole table waits for the writer to finish.
+  std::promise<void> locked;
+  std::thread reader_thread([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(reader, LockMode::SHARED, oid));
+    locked.set_value();
+  });
+  auto locked_future = locked.get_future();
+  EXPECT_EQ(std::future_status::timeout, locked_future.wait_for(std::chrono::milliseconds(100)));
+  txn_mgr.Commit(writer);
+  locked_future.wait();
+  reader_thread.join();
+  CheckGrowing(reader);
+  EXPECT_TRUE(reader->IsTableSharedLocked(oid));
+  EXPECT_FALSE(reader->IsTableExclusiveLocked(oid));
+
+  // An older transaction asking for the whole table wounds the younger reader.
+  txn_mgr.Commit(reader);
+  Transaction *older = txn_mgr.Begin();
+  Transaction *younger = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockTable(younger, LockMode::SHARED, oid));
+  EXPECT_TRUE(lock_mgr.LockTable(older, LockMode::INTENTION_SHARED, oid));
+  EXPECT_TRUE(lock_mgr.LockTable(older, LockMode::EXCLUSIVE, oid));
+  CheckGrowing(older);
+  CheckAborted(younger);
+  EXPECT_TRUE(older->IsTableExclusiveLocked(oid));
+  txn_mgr.Commit(older);
+  EXPECT_TRUE(older->GetTableLockSet()->empty());
+  txn_mgr.Abort(younger);
+  EXPECT_TRUE(younger->GetTableLockSet()->empty());
+
+  delete writer;
+  delete reader;
+  delete older;
+  delete younger;
+}
+TEST(LockManagerTest, TableLockTest) { TableLockTest(); }
+
+// Many record locks on one table get traded for a table lock, unless somebody else uses the table
+void EscalationTest() {
+  const size_t threshold = 10;
+  LockManager lock_mgr{4, threshold};
+  TransactionManager txn_mgr{&lock_mgr};
+  table_oid_t oid = 0;
+
+  Transaction *reader = txn_mgr.Begin();
+  Transaction *writer = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(reader, oid, RID{100, 0}));
+  EXPECT_EQ(LockManager::LockMode::INTENTION_SHARED, reader->GetTableLockSet()->at(oid));
+
+  // The reader's intention lock is in the way, the writer keeps its record locks.
+  for (size_t i = 0; i <= threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, oid, RID{0, static_cast<uint32_t>(i)}));
+  }
+  CheckGrowing(writer);
+  CheckTxnLockSize(writer, 0, threshold + 1);
+  EXPECT_EQ(LockManager::LockMode::INTENTION_EXCLUSIVE, writer->GetTableLockSet()->at(oid));
+
+  // Once the reader is gone, the next attempt succeeds.
+  txn_mgr.Commit(reader);
+  for (size_t i = threshold + 1; i <= 2 * threshold; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(writer, oid, RID{0, static_cast<uint32_t>(i)}));
+  }
+  CheckGrowing(writer);
+  CheckTxnLockSize(writer, 0, 0);
+  EXPECT_TRUE(writer->IsTableExclusiveLocked(oid));
+  EXPECT_TRUE(writer->GetTableRowLockSet()->at(oid).empty());
+  // Covered by the table lock now.
+  EXPECT_TRUE(lock_mgr.LockExclusive(writer, oid, RID{1, 0}));
+  CheckTxnLockSize(writer, 0, 0);
+
+  // The records were released, another transaction can lock them once the table is free.
+  txn_mgr.Commit(writer);
+  Transaction *txn = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn, oid, RID{0, 0}));
+  CheckTxnLockSize(txn, 0, 1);
+  txn_mgr.Commit(txn);
+  CheckTxnLockSize(txn, 0, 0);
+  EXPECT_TRUE(txn->GetTableLockSet()->empty());
+
+  delete reader;
+  delete writer;
+  delete txn;
+}
+TEST(LockManagerTest, EscalationTest) { EscalationTest(); }
+
+// Record locks on the lock words, and the lock table taking over once a word is shared
+void FastPathTest() {
+  // With a single partition, records whose slots are LOCK_WORDS_PER_PARTITION apart share a lock word.
+  LockManager lock_mgr{1};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto same_word = [](size_t i) { return RID{0, static_cast<uint32_t>(i * LOCK_WORDS_PER_PARTITION)}; };
+
+  // More locks than a word holds, and an upgrade, all by one transaction.
+  Transaction *txn = txn_mgr.Begin();
+  const size_t num_rids = 8;
+  for (size_t i = 0; i < num_rids; i++) {
+    EXPECT_TRUE(lock_mgr.LockShared(txn, same_word(i)));
+  }
+  EXPECT_TRUE(lock_mgr.LockUpgrade(txn, same_word(0)));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn, same_word(num_rids - 1)));
+  CheckGrowing(txn);
+  CheckTxnLockSize(txn, num_rids - 2, 2);
+  txn_mgr.Commit(txn);
+  CheckTxnLockSize(txn, 0, 0);
+
+  // An older transaction shares a record with a younger one on the same word, and wounds it on the other record.
+  Transaction *older = txn_mgr.Begin();
+  Transaction *younger = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(younger, same_word(0)));
+  EXPECT_TRUE(lock_mgr.LockShared(younger, same_word(1)));
+  EXPECT_TRUE(lock_mgr.LockShared(older, same_word(1)));
+  CheckGrowing(younger);
+  EXPECT_TRUE(lock_mgr.LockExclusive(older, same_word(0)));
+  CheckAborted(younger);
+  txn_mgr.Abort(younger);
+  CheckTxnLockSize(younger, 0, 0);
+
+  // A younger transaction waits for the older one, which took its locks through the lock table.
+  Transaction *waiter = txn_mgr.Begin();
+  std::atomic<bool> granted{false};
+  std::thread wait_thread{[&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(waiter, same_word(1)));
+    granted = true;
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(older);
+  wait_thread.join();
+  EXPECT_TRUE(granted);
+  CheckGrowing(waiter);
+  txn_mgr.Commit(waiter);
+
+  // Once the lock table is empty, the word takes locks again.
+  Transaction *last = txn_mgr.Begin();
+  for (size_t i = 0; i < num_rids; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(last, same_word(i)));
+  }
+  CheckTxnLockSize(last, 0, num_rids);
+  txn_mgr.Commit(last);
+  CheckCommitted(last);
+  CheckTxnLockSize(last, 0, 0);
+
+  delete txn;
+  delete older;
+  delete younger;
+  delete waiter;
+  delete last;
+}
+TEST(LockManagerTest, FastPathTest) { FastPathTest(); }
+
+void ConcurrentFastPathTest() {
+  // Transactions race for the records of four lock words, which keep going from free to full and inflating. Deadlock
+  // detection rather than wound-wait, so that a lock once granted stays until its transaction releases it.
+  auto interval = cycle_detection_interval;
+  cycle_detection_interval = std::chrono::milliseconds(10);
+  LockManager lock_mgr{1, LOCK_ESCALATION_THRESHOLD, DeadlockPolicy::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  const size_t num_rids = 16;
+  auto rid_of = [](size_t i) { return RID{0, static_cast<uint32_t>(i % 4 * LOCK_WORDS_PER_PARTITION + i / 4)}; };
+  // The holders of each record: the number of shared locks, or -1 for an exclusive one.
+  std::array<std::atomic<int>, num_rids> holders{};
+
+  auto task = [&](uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (int round = 0; round < 1000; round++) {
+      Transaction *txn = txn_mgr.Begin();
+      std::vector<size_t> shared;
+      std::vector<size_t> exclusive;
+      // In record order, so that only upgrades can deadlock.
+      for (size_t i = 0; i < num_rids && txn->GetState() == TransactionState::GROWING; i++) {
+        auto choice = rng() % 8;
+        if (choice > 3 || choice == 0) {
+          continue;
+        }
+        if (choice == 1) {
+          if (lock_mgr.LockExclusive(txn, rid_of(i))) {
+            int free = 0;
+            EXPECT_TRUE(holders[i].compare_exchange_strong(free, -1));
+            exclusive.push_back(i);
+          }
+          continue;
+        }
+        if (!lock_mgr.LockShared(txn, rid_of(i))) {
+          continue;
+        }
+        EXPECT_GE(holders[i]++, 0);
+        if (choice == 2) {
+          shared.push_back(i);
+          continue;
+        }
+        // An upgrade that has to wait gives up the shared lock first.
+        holders[i]--;
+        if (lock_mgr.LockUpgrade(txn, rid_of(i))) {
+          int free = 0;
+          EXPECT_TRUE(holders[i].compare_exchange_strong(free, -1));
+          exclusive.push_back(i);
+        } else if (txn->IsSharedLocked(rid_of(i))) {
+          holders[i]++;
+          shared.push_back(i);
+        }
+      }
+      for (auto i : shared) {
+        holders[i]--;
+      }
+      for (auto i : exclusive) {
+        holders[i] = 0;
+      }
+      if (txn->GetState() == TransactionState::ABORTED) {
+        txn_mgr.Abort(txn);
+      } else {
+        txn_mgr.Commit(txn);
+      }
+      CheckTxnLockSize(txn, 0, 0);
+      delete txn;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 8; i++) {
+    threads.emplace_back(task, i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  cycle_detection_interval = interval;
+}
+TEST(LockManagerTest, ConcurrentFastPathTest) { ConcurrentFastPathTest(); }
+
+// Finished transactions leave the registry, once nobody can still be using them
+void RegistryTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto &registry = TransactionManager::txn_registry;
+  auto size = registry.Size();
+
+  Transaction *committed = txn_mgr.Begin();
+  Transaction *aborted = txn_mgr.Begin();
+  EXPECT_EQ(size + 2, registry.Size());
+  EXPECT_EQ(committed, TransactionManager::GetTransaction(committed->GetTransactionId()));
+  txn_mgr.Commit(committed);
+  txn_mgr.Abort(aborted);
+  EXPECT_EQ(size, registry.Size());
+  EXPECT_EQ(nullptr, registry.Find(committed->GetTransactionId()));
+  EXPECT_EQ(nullptr, TransactionManager::GetTransaction(aborted->GetTransactionId()));
+
+  // A recycled transaction comes back from the next Begin of the thread as a new one.
+  auto aborted_id = aborted->GetTransactionId();
+  txn_mgr.Recycle(aborted);
+  Transaction *reused = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  EXPECT_EQ(aborted, reused);
+  EXPECT_NE(aborted_id, reused->GetTransactionId());
+  EXPECT_EQ(IsolationLevel::READ_COMMITTED, reused->GetIsolationLevel());
+  EXPECT_EQ(reused, TransactionManager::GetTransaction(reused->GetTransactionId()));
+  CheckGrowing(reused);
+  EXPECT_TRUE(lock_mgr.LockExclusive(reused, RID{0, 0}));
+  txn_mgr.Commit(reused);
+  CheckTxnLockSize(reused, 0, 0);
+
+  // A guard that found the transaction keeps it from being reclaimed.
+  Transaction *txn = txn_mgr.Begin();
+  std::atomic<bool> finished{false};
+  std::thread commit_thread;
+  {
+    TransactionRegistry::Guard guard(&registry);
+    EXPECT_EQ(txn, registry.Find(txn->GetTransactionId()));
+    commit_thread = std::thread([&] {
+      txn_mgr.Commit(txn);
+      finished = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(finished);
+    CheckCommitted(txn);
+  }
+  commit_thread.join();
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(size, registry.Size());
+
+  delete committed;
+  delete reused;
+  delete txn;
+}
+TEST(LockManagerTest, RegistryTest) { RegistryTest(); }
+
+// Repeatable reads lock the index buckets of the keys they look up, writers of those keys wait for them
+void IndexKeyLockTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  Schema schema({Column("a", TypeId::INTEGER)});
+  auto make_key = [&](int32_t a) { return Tuple({ValueFactory::GetIntegerValue(a)}, &schema); };
+  index_oid_t index = 0;
+  auto key = make_key(5);
+  auto other_key = make_key(6);
+  ASSERT_FALSE(LockManager::IndexBucketRid(index, key) == LockManager::IndexBucketRid(index, other_key));
+
+  Transaction *reader = txn_mgr.Begin();
+  Transaction *committed_reader = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  Transaction *writer = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockIndexKey(reader, index, key, LockManager::LockMode::SHARED));
+  EXPECT_TRUE(reader->IsSharedLocked(LockManager::IndexBucketRid(index, key)));
+  // A read committed does not mind phantoms.
+  EXPECT_TRUE(lock_mgr.LockIndexKey(committed_reader, index, key, LockManager::LockMode::SHARED));
+  CheckTxnLockSize(committed_reader, 0, 0);
+
+  // Other buckets, and the same key in another index, are free.
+  EXPECT_TRUE(lock_mgr.LockIndexKey(writer, index, other_key, LockManager::LockMode::EXCLUSIVE));
+  EXPECT_TRUE(lock_mgr.LockIndexKey(writer, index + 1, key, LockManager::LockMode::EXCLUSIVE));
+  CheckTxnLockSize(writer, 0, 2);
+
+  std::atomic<bool> granted{false};
+  std::thread write_thread{[&] {
+    EXPECT_TRUE(lock_mgr.LockIndexKey(writer, index, key, LockManager::LockMode::EXCLUSIVE));
+    granted = true;
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(reader);
+  write_thread.join();
+  EXPECT_TRUE(granted);
+  CheckGrowing(writer);
+  CheckTxnLockSize(writer, 0, 3);
+  txn_mgr.Commit(writer);
+  txn_mgr.Commit(committed_reader);
+  CheckTxnLockSize(writer, 0, 0);
+
+  delete reader;
+  delete committed_reader;
+  delete writer;
+}
+TEST(LockManagerTest, IndexKeyLockTest) { IndexKeyLockTest(); }
+
+// The least frequent key gives up its counter to a new one
+void SpaceSavingTest() {
+  SpaceSaving<int> sketch(2);
+  for (int key : {1, 1, 2, 3}) {
+    sketch.Add(key);
+  }
+  // 3 takes over the counter of 2, the least frequent one.
+  auto top = sketch.Top();
+  ASSERT_EQ(2, top.size());
+  EXPECT_EQ(1, top[0].key_);
+  EXPECT_EQ(2, top[0].count_);
+  EXPECT_EQ(3, top[1].key_);
+  EXPECT_EQ(2, top[1].count_);
+  EXPECT_EQ(1, top[1].error_);
+
+  sketch.Clear();
+  EXPECT_TRUE(sketch.Top().empty());
+}
+TEST(LockManagerTest, SpaceSavingTest) { SpaceSavingTest(); }
+
+// Waits are timed per mode and counted against the record waited for, wounds and upgrades are counted as well
+void ProfilerTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  auto profiler = lock_mgr.GetProfiler();
+  RID rid{0, 0};
+  Transaction *oldest = txn_mgr.Begin();
+  Transaction *older = txn_mgr.Begin();
+  Transaction *younger = txn_mgr.Begin();
+
+  EXPECT_TRUE(lock_mgr.LockExclusive(older, rid));
+  std::thread waiter([&] { EXPECT_TRUE(lock_mgr.LockShared(younger, rid)); });
+  while (profiler->GetWaiting() == 0) {
+    std::this_thread::yield();
+  }
+  txn_mgr.Commit(older);
+  waiter.join();
+  EXPECT_EQ(0, profiler->GetWaiting());
+  auto shared_waits = profiler->GetWaitHistogram(LockManager::LockMode::SHARED);
+  EXPECT_EQ(1, std::accumulate(shared_waits.begin(), shared_waits.end(), uint64_t{0}));
+  auto exclusive_waits = profiler->GetWaitHistogram(LockManager::LockMode::EXCLUSIVE);
+  EXPECT_EQ(0, std::accumulate(exclusive_waits.begin(), exclusive_waits.end(), uint64_t{0}));
+  auto hot = profiler->GetHotRecords();
+  ASSERT_EQ(1, hot.size());
+  EXPECT_EQ(rid, hot[0].key_);
+  EXPECT_EQ(1, hot[0].count_);
+
+  // The oldest wounds the younger after its upgrade, nobody waits.
+  EXPECT_TRUE(lock_mgr.LockUpgrade(younger, rid));
+  EXPECT_TRUE(lock_mgr.LockShared(oldest, rid));
+  CheckAborted(younger);
+  EXPECT_EQ(1, profiler->GetUpgrades());
+  EXPECT_EQ(1, profiler->GetWounds());
+  EXPECT_EQ(0, profiler->GetDeadlockVictims());
+  EXPECT_EQ(1, profiler->GetHotRecords()[0].count_);
+  auto dump = profiler->ToString();
+  EXPECT_NE(std::string::npos, dump.find("wounds: 1, deadlock victims: 0, upgrades: 1"));
+  EXPECT_NE(std::string::npos, dump.find(rid.ToString()));
+  txn_mgr.Abort(younger);
+  txn_mgr.Commit(oldest);
+
+  profiler->Reset();
+  EXPECT_EQ(0, profiler->GetWounds());
+  EXPECT_TRUE(profiler->GetHotRecords().empty());
+  shared_waits = profiler->GetWaitHistogram(LockManager::LockMode::SHARED);
+  EXPECT_EQ(0, std::accumulate(shared_waits.begin(), shared_waits.end(), uint64_t{0}));
+
+  delete oldest;
+  delete older;
+  delete younger;
+}
+TEST(LockManagerTest, ProfilerTest) { ProfilerTest(); }
+
+void GraphTest() {
+  LockManager lock_mgr{};
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  lock_mgr.AddEdge(1, 2);
+  EXPECT_EQ(2, lock_mgr.GetEdgeList().size());
+  txn_id_t victim = INVALID_TXN_ID;
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+
+  // 0 -> 1 -> 2 -> 0 and 3 -> 4 -> 3, the youngest of the first cycle found goes.
+  lock_mgr.AddEdge(2, 0);
+  lock_mgr.AddEdge(3, 4);
+  lock_mgr.AddEdge(4, 3);
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(2, victim);
+  lock_mgr.RemoveEdge(2, 0);
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(4, victim);
+  lock_mgr.RemoveEdge(4, 3);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(3, lock_mgr.GetEdgeList().size());
+}
+TEST(LockManagerTest, GraphTest) { GraphTest(); }
+
+// With deadlock detection an older transaction waits for a younger one, only a cycle gets somebody aborted
+void DeadlockDetectionTest() {
+  auto interval = cycle_detection_interval;
+  cycle_detection_interval = std::chrono::milliseconds(10);
+  LockManager lock_mgr{LOCK_TABLE_PARTITIONS, LOCK_ESCALATION_THRESHOLD, DeadlockPolicy::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0{0, 0};
+  RID rid1{1, 1};
+
+  // No cycle: the older transaction simply waits.
+  Transaction *older = txn_mgr.Begin();
+  Transaction *younger = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(younger, rid0));
+  auto waiter = std::async(std::launch::async, [&] { return lock_mgr.LockExclusive(older, rid0); });
+  EXPECT_EQ(std::future_status::timeout, waiter.wait_for(std::chrono::milliseconds(50)));
+  CheckGrowing(younger);
+  txn_mgr.Commit(younger);
+  EXPECT_TRUE(waiter.get());
+  txn_mgr.Commit(older);
+  delete older;
+  delete younger;
+
+  // older waits for younger on rid1 and younger for older on rid0: younger is the victim.
+  older = txn_mgr.Begin();
+  younger = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(older, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(younger, rid1));
+  auto younger_waiter = std::async(std::launch::async, [&] { return lock_mgr.LockShared(younger, rid0); });
+  EXPECT_EQ(std::future_status::timeout, younger_waiter.wait_for(std::chrono::milliseconds(50)));
+  auto older_waiter = std::async(std::launch::async, [&] { return lock_mgr.LockExclusive(older, rid1); });
+  EXPECT_FALSE(younger_waiter.get());
+  CheckAborted(younger);
+  CheckGrowing(older);
+  txn_mgr.Abort(younger);
+  EXPECT_TRUE(older_waiter.get());
+  CheckTxnLockSize(older, 0, 2);
+  txn_mgr.Commit(older);
+  delete older;
+  delete younger;
+  cycle_detection_interval = interval;
+}
+TEST(LockManagerTest, DeadlockDetectionTest) { DeadlockDetectionTest(); }
+
 }  // namespace bustub
@@ -84,6 +84,9 @@ class TransactionTest : public ::testing::Test {
     disk_manager_->ShutDown();
     remove("executor_test.db");
     delete txn_;
+    // Tests turn MVCC or OCC on as they need them, even a failed one must not leave them on for the next test.
+    enable_mvcc = false;
+    enable_occ = false;
   };
 
   /** @return the executor context in our test class */
@@ -548,4 +551,323 @@ TEST_F(TransactionTest, IntegratedTest) {
   delete txn2;
   delete txn3;
 }
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, SnapshotIsolationTest) {
+  // txn0: INSERT INTO empty_table2 VALUES (200, 20), (201, 21), (202, 22)
+  // txn1: SELECT * FROM empty_table2;
+  // txn2: UPDATE empty_table2 SET colA = colA+10
+  // txn2 commit
+  // txn1: SELECT * FROM empty_table2; sees its snapshot
+  // txn1: UPDATE empty_table2 SET colA = colA+10; aborts on the write-write conflict
+  enable_mvcc = true;
+  auto txn0 = GetTxnManager()->Begin();
+  auto exec_ctx0 = std::make_unique<ExecutorContext>(txn0, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<Value> val1{ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)};
+  std::vector<Value> val2{ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)};
+  std::vector<Value> val3{ValueFactory::GetIntegerValue(202), ValueFactory::GetIntegerValue(22)};
+  std::vector<std::vector<Value>> raw_vals{val1, val2, val3};
+  auto table_info = exec_ctx0->GetCatalog()->GetTable("empty_table2");
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn0, exec_ctx0.get());
+
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan_col_a = [&](Transaction *txn, ExecutorContext *exec_ctx) {
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx);
+    std::vector<int32_t> values;
+    for (const auto &tuple : result_set) {
+      values.push_back(tuple.GetValue(out_schema, out_schema->GetColIdx("colA")).GetAs<int32_t>());
+    }
+    return values;
+  };
+
+  // A snapshot taken before txn0 commits does not see its inserts.
+  auto txn_early = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx_early =
+      std::make_unique<ExecutorContext>(txn_early, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_TRUE(scan_col_a(txn_early, exec_ctx_early.get()).empty());
+  GetTxnManager()->Commit(txn0);
+  delete txn0;
+  EXPECT_TRUE(scan_col_a(txn_early, exec_ctx_early.get()).empty());
+  GetTxnManager()->Commit(txn_early);
+  delete txn_early;
+
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(scan_col_a(txn1, exec_ctx1.get()), (std::vector<int32_t>{200, 201, 202}));
+
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(0, UpdateInfo(UpdateType::Add, 10)));
+  UpdatePlanNode update_plan{&scan_plan, table_info->oid_, update_attrs};
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn2, exec_ctx2.get());
+  // A transaction sees its own changes, a concurrent snapshot does not.
+  EXPECT_EQ(scan_col_a(txn2, exec_ctx2.get()), (std::vector<int32_t>{210, 211, 212}));
+  EXPECT_EQ(scan_col_a(txn1, exec_ctx1.get()), (std::vector<int32_t>{200, 201, 202}));
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+  EXPECT_EQ(scan_col_a(txn1, exec_ctx1.get()), (std::vector<int32_t>{200, 201, 202}));
+
+  auto txn3 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx3 = std::make_unique<ExecutorContext>(txn3, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(scan_col_a(txn3, exec_ctx3.get()), (std::vector<int32_t>{210, 211, 212}));
+
+  // txn2 committed a change to the tuples after txn1 took its snapshot, so the first committer wins.
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn1, exec_ctx1.get());
+  CheckAborted(txn1);
+  GetTxnManager()->Abort(txn1);
+  delete txn1;
+
+  auto txn4 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx4 = std::make_unique<ExecutorContext>(txn4, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  DeletePlanNode delete_plan{&scan_plan, table_info->oid_};
+  GetExecutionEngine()->Execute(&delete_plan, nullptr, txn4, exec_ctx4.get());
+  GetTxnManager()->Commit(txn4);
+  delete txn4;
+  // The deleted tuples stay visible to the snapshot taken before the delete committed.
+  EXPECT_EQ(scan_col_a(txn3, exec_ctx3.get()), (std::vector<int32_t>{210, 211, 212}));
+  GetTxnManager()->Commit(txn3);
+  delete txn3;
+
+  auto txn5 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx5 = std::make_unique<ExecutorContext>(txn5, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_TRUE(scan_col_a(txn5, exec_ctx5.get()).empty());
+  GetTxnManager()->Commit(txn5);
+  delete txn5;
+}
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, OptimisticTest) {
+  // txn0: INSERT INTO empty_table2 VALUES (200, 20), (201, 21), (202, 22)
+  // txn1, txn2: SELECT * FROM empty_table2;
+  // txn1: UPDATE empty_table2 SET colA = colA+10
+  // txn1 commit, txn2 commit fails since what it read changed
+  enable_occ = true;
+  auto txn0 = GetTxnManager()->Begin();
+  auto exec_ctx0 = std::make_unique<ExecutorContext>(txn0, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<Value> val1{ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)};
+  std::vector<Value> val2{ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)};
+  std::vector<Value> val3{ValueFactory::GetIntegerValue(202), ValueFactory::GetIntegerValue(22)};
+  std::vector<std::vector<Value>> raw_vals{val1, val2, val3};
+  auto table_info = exec_ctx0->GetCatalog()->GetTable("empty_table2");
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn0, exec_ctx0.get());
+  EXPECT_TRUE(GetTxnManager()->Commit(txn0));
+  delete txn0;
+  // No optimistic transaction is running, nobody can validate against the versions of the inserts.
+  auto tuple_versions = table_info->table_->GetTupleVersions();
+  EXPECT_EQ(tuple_versions->Size(), 0);
+
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan_col_a = [&](Transaction *txn, ExecutorContext *exec_ctx) {
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx);
+    std::vector<int32_t> values;
+    for (const auto &tuple : result_set) {
+      values.push_back(tuple.GetValue(out_schema, out_schema->GetColIdx("colA")).GetAs<int32_t>());
+    }
+    return values;
+  };
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(0, UpdateInfo(UpdateType::Add, 10)));
+  UpdatePlanNode update_plan{&scan_plan, table_info->oid_, update_attrs};
+
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  auto txn2 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx2 = std::make_unique<ExecutorContext>(txn2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(scan_col_a(txn2, exec_ctx2.get()), (std::vector<int32_t>{200, 201, 202}));
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn1, exec_ctx1.get());
+  // The update is buffered: only txn1 sees it, and it holds no record lock.
+  EXPECT_EQ(scan_col_a(txn1, exec_ctx1.get()), (std::vector<int32_t>{210, 211, 212}));
+  EXPECT_EQ(scan_col_a(txn2, exec_ctx2.get()), (std::vector<int32_t>{200, 201, 202}));
+  CheckTxnLockSize(txn1, 0, 0);
+  EXPECT_TRUE(GetTxnManager()->Commit(txn1));
+  CheckCommitted(txn1);
+  // txn2 began before the update, its reads must still fail to validate.
+  EXPECT_EQ(tuple_versions->Size(), 3);
+  EXPECT_FALSE(GetTxnManager()->Commit(txn2));
+  CheckAborted(txn2);
+  delete txn1;
+  delete txn2;
+
+  // A read-only transaction commits as long as nobody wrote what it read.
+  auto txn3 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx3 = std::make_unique<ExecutorContext>(txn3, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(scan_col_a(txn3, exec_ctx3.get()), (std::vector<int32_t>{210, 211, 212}));
+  EXPECT_TRUE(GetTxnManager()->Commit(txn3));
+  delete txn3;
+
+  // A locking transaction writing a tuple makes an optimistic read of it fail right away.
+  auto txn4 = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  auto exec_ctx4 = std::make_unique<ExecutorContext>(txn4, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn4, exec_ctx4.get());
+  auto txn5 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx5 = std::make_unique<ExecutorContext>(txn5, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_TRUE(scan_col_a(txn5, exec_ctx5.get()).empty());
+  CheckAborted(txn5);
+  GetTxnManager()->Abort(txn5);
+  GetTxnManager()->Abort(txn4);
+  delete txn4;
+  delete txn5;
+
+  // A buffered delete is only applied at commit.
+  auto txn6 = GetTxnManager()->Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto exec_ctx6 = std::make_unique<ExecutorContext>(txn6, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  DeletePlanNode delete_plan{&scan_plan, table_info->oid_};
+  GetExecutionEngine()->Execute(&delete_plan, nullptr, txn6, exec_ctx6.get());
+  EXPECT_TRUE(scan_col_a(txn6, exec_ctx6.get()).empty());
+  auto txn7 = GetTxnManager()->Begin(nullptr, IsolationLevel::READ_COMMITTED);
+  auto exec_ctx7 = std::make_unique<ExecutorContext>(txn7, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(scan_col_a(txn7, exec_ctx7.get()), (std::vector<int32_t>{210, 211, 212}));
+  EXPECT_TRUE(GetTxnManager()->Commit(txn6));
+  EXPECT_EQ(tuple_versions->Size(), 0);
+  EXPECT_TRUE(scan_col_a(txn7, exec_ctx7.get()).empty());
+  EXPECT_TRUE(GetTxnManager()->Commit(txn7));
+  delete txn6;
+  delete txn7;
+}
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, ReadOnlyTest) {
+  // txn0: INSERT INTO empty_table2 VALUES (200, 20), (201, 21), (202, 22)
+  // ro1: SELECT * FROM empty_table2;
+  // txn1: UPDATE empty_table2 SET colA = colA+10, ro1 keeps seeing its snapshot
+  // ro2 reuses the object of ro1 and sees the update
+  enable_mvcc = true;
+  auto txn0 = GetTxnManager()->Begin();
+  auto exec_ctx0 = std::make_unique<ExecutorContext>(txn0, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::vector<Value> val1{ValueFactory::GetIntegerValue(200), ValueFactory::GetIntegerValue(20)};
+  std::vector<Value> val2{ValueFactory::GetIntegerValue(201), ValueFactory::GetIntegerValue(21)};
+  std::vector<Value> val3{ValueFactory::GetIntegerValue(202), ValueFactory::GetIntegerValue(22)};
+  std::vector<std::vector<Value>> raw_vals{val1, val2, val3};
+  auto table_info = exec_ctx0->GetCatalog()->GetTable("empty_table2");
+  InsertPlanNode insert_plan{std::move(raw_vals), table_info->oid_};
+  GetExecutionEngine()->Execute(&insert_plan, nullptr, txn0, exec_ctx0.get());
+  GetTxnManager()->Commit(txn0);
+  delete txn0;
+
+  auto &schema = table_info->schema_;
+  auto col_a = MakeColumnValueExpression(schema, 0, "colA");
+  auto col_b = MakeColumnValueExpression(schema, 0, "colB");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}, {"colB", col_b}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  auto scan_col_a = [&](Transaction *txn, ExecutorContext *exec_ctx) {
+    std::vector<Tuple> result_set;
+    GetExecutionEngine()->Execute(&scan_plan, &result_set, txn, exec_ctx);
+    std::vector<int32_t> values;
+    for (const auto &tuple : result_set) {
+      values.push_back(tuple.GetValue(out_schema, out_schema->GetColIdx("colA")).GetAs<int32_t>());
+    }
+    return values;
+  };
+
+  // A read-only transaction has no sets, and never shows up in the lock manager.
+  auto ro1 = GetTxnManager()->BeginReadOnly();
+  auto exec_ctx_ro1 = std::make_unique<ExecutorContext>(ro1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_TRUE(ro1->IsReadOnly());
+  EXPECT_EQ(nullptr, ro1->GetWriteSet());
+  EXPECT_EQ(nullptr, ro1->GetSharedLockSet());
+  EXPECT_EQ(scan_col_a(ro1, exec_ctx_ro1.get()), (std::vector<int32_t>{200, 201, 202}));
+  RID rid = table_info->table_->Begin(ro1)->GetRid();
+
+  auto txn1 = GetTxnManager()->Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto exec_ctx1 = std::make_unique<ExecutorContext>(txn1, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(0, UpdateInfo(UpdateType::Add, 10)));
+  UpdatePlanNode update_plan{&scan_plan, table_info->oid_, update_attrs};
+  GetExecutionEngine()->Execute(&update_plan, nullptr, txn1, exec_ctx1.get());
+  GetTxnManager()->Commit(txn1);
+  delete txn1;
+
+  // Point lookups and scans both read the snapshot.
+  Tuple tuple;
+  EXPECT_TRUE(table_info->table_->GetTuple(rid, &tuple, ro1));
+  EXPECT_EQ(200, tuple.GetValue(&schema, 0).GetAs<int32_t>());
+  EXPECT_EQ(scan_col_a(ro1, exec_ctx_ro1.get()), (std::vector<int32_t>{200, 201, 202}));
+  EXPECT_THROW(GetExecutionEngine()->Execute(&update_plan, nullptr, ro1, exec_ctx_ro1.get()), Exception);
+  auto ro1_id = ro1->GetTransactionId();
+  GetTxnManager()->Commit(ro1);
+
+  auto ro2 = GetTxnManager()->BeginReadOnly();
+  auto exec_ctx_ro2 = std::make_unique<ExecutorContext>(ro2, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager());
+  EXPECT_EQ(ro1, ro2);
+  EXPECT_NE(ro1_id, ro2->GetTransactionId());
+  CheckGrowing(ro2);
+  EXPECT_TRUE(table_info->table_->GetTuple(rid, &tuple, ro2));
+  EXPECT_EQ(210, tuple.GetValue(&schema, 0).GetAs<int32_t>());
+  EXPECT_EQ(scan_col_a(ro2, exec_ctx_ro2.get()), (std::vector<int32_t>{210, 211, 212}));
+  GetTxnManager()->Commit(ro2);
+}
+// NOLINTNEXTLINE
+TEST_F(TransactionTest, PageBatchedRollbackTest) {
+  // txn1: INSERT a tuple, UPDATE test_1 SET colA = colA+10000 on the odd tuples, DELETE the even ones; abort
+  // txn2: DELETE the even tuples again; commit
+  auto table_info = GetCatalog()->GetTable("test_1");
+  auto *table = table_info->table_.get();
+  auto &schema = table_info->schema_;
+  auto scan = [&](Transaction *txn) {
+    std::vector<std::pair<RID, std::vector<Value>>> tuples;
+    for (auto it = table->Begin(txn); it != table->End(); ++it) {
+      std::vector<Value> values;
+      for (uint32_t i = 0; i < schema.GetColumnCount(); i++) {
+        values.push_back(it->GetValue(&schema, i));
+      }
+      tuples.emplace_back(it->GetRid(), std::move(values));
+    }
+    return tuples;
+  };
+
+  auto txn1 = GetTxnManager()->Begin();
+  auto before = scan(txn1);
+  ASSERT_EQ(TEST1_SIZE, before.size());
+  // The writes have to be spread over several pages for the batching to matter.
+  ASSERT_NE(before.front().first.GetPageId(), before.back().first.GetPageId());
+  RID inserted;
+  ASSERT_TRUE(table->InsertTuple(Tuple(before.front().second, &schema), &inserted, txn1));
+  for (const auto &[rid, values] : before) {
+    if (values[0].GetAs<int32_t>() % 2 == 0) {
+      ASSERT_TRUE(table->MarkDelete(rid, txn1));
+    } else {
+      auto updated = values;
+      updated[0] = ValueFactory::GetIntegerValue(values[0].GetAs<int32_t>() + 10000);
+      ASSERT_TRUE(table->UpdateTuple(Tuple(updated, &schema), rid, txn1));
+    }
+  }
+  GetTxnManager()->Abort(txn1);
+  delete txn1;
+
+  auto txn2 = GetTxnManager()->Begin();
+  auto after = scan(txn2);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_EQ(before[i].first, after[i].first);
+    for (size_t col = 0; col < before[i].second.size(); col++) {
+      EXPECT_EQ(CmpBool::CmpTrue, before[i].second[col].CompareEquals(after[i].second[col]));
+    }
+  }
+  for (const auto &[rid, values] : after) {
+    if (values[0].GetAs<int32_t>() % 2 == 0) {
+      ASSERT_TRUE(table->MarkDelete(rid, txn2));
+    }
+  }
+  GetTxnManager()->Commit(txn2);
+  delete txn2;
+
+  auto txn3 = GetTxnManager()->Begin();
+  auto remaining = scan(txn3);
+  ASSERT_EQ(TEST1_SIZE / 2, remaining.size());
+  for (const auto &[rid, values] : remaining) {
+    EXPECT_EQ(1, values[0].GetAs<int32_t>() % 2);
+  }
+  GetTxnManager()->Commit(txn3);
+  delete txn3;
+}
 }  // namespace bustub
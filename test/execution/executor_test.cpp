@@ -10,9 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
 #include <memory>
 #include <numeric>
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -269,6 +271,48 @@ TEST_F(ExecutorTest, SimpleRawInsertWithIndexTest) {
   }
 }
 
+// A repeatable read looking a key up in an index keeps an insert of the key out until it finishes
+TEST_F(ExecutorTest, IndexKeyPhantomTest) {
+  auto table_info = GetExecutorContext()->GetCatalog()->GetTable("empty_table2");
+  auto key_schema = ParseCreateStatement("a bigint");
+  auto *index_info = GetExecutorContext()->GetCatalog()->CreateIndex<KeyType, ValueType, ComparatorType>(
+      GetTxn(), "index1", "empty_table2", table_info->schema_, *key_schema, {0}, 8, HashFunctionType{});
+  std::vector<Value> values{ValueFactory::GetIntegerValue(100), ValueFactory::GetIntegerValue(10)};
+  Tuple tuple{values, &table_info->schema_};
+  const auto index_key = tuple.KeyFromTuple(table_info->schema_, *index_info->index_->GetKeySchema(),
+                                            index_info->index_->GetKeyAttrs());
+
+  // The reader is older, so under wound-wait the writer waits for it.
+  Transaction *reader = GetTxnManager()->Begin();
+  Transaction *writer = GetTxnManager()->Begin();
+  std::vector<RID> rids{};
+  index_info->index_->ScanKey(index_key, &rids, reader);
+  EXPECT_TRUE(rids.empty());
+
+  std::atomic<bool> inserted{false};
+  std::thread insert_thread{[&] {
+    InsertPlanNode insert_plan{{values}, table_info->oid_};
+    ExecutorContext exec_ctx{writer, GetCatalog(), GetBPM(), GetTxnManager(), GetLockManager()};
+    GetExecutionEngine()->Execute(&insert_plan, nullptr, writer, &exec_ctx);
+    inserted = true;
+  }};
+  while (GetLockManager()->GetProfiler()->GetWaiting() == 0 && !inserted) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(inserted);
+  index_info->index_->ScanKey(index_key, &rids, reader);
+  EXPECT_TRUE(rids.empty());
+  GetTxnManager()->Commit(reader);
+  insert_thread.join();
+  EXPECT_TRUE(inserted);
+  index_info->index_->ScanKey(index_key, &rids, writer);
+  EXPECT_EQ(1, rids.size());
+  GetTxnManager()->Commit(writer);
+
+  delete reader;
+  delete writer;
+}
+
 // UPDATE test_3 SET colB = colB + 1;
 TEST_F(ExecutorTest, SimpleUpdateTest) {
   // Construct a sequential scan of the table
@@ -10,28 +10,67 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <sys/stat.h>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
+#include "buffer/buffer_pool_manager_instance.h"
 #include "common/bustub_instance.h"
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction_manager.h"
+#include "container/hash/extendible_hash_table.h"
 #include "gtest/gtest.h"
 #include "logging/common.h"
+#include "recovery/checkpoint_manager.h"
+#include "recovery/log_reader.h"
 #include "recovery/log_recovery.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
+/** Walks the log file and returns the lsn and type of every record in it. */
+static auto ReadLogHeaders(DiskManager *disk_manager) -> std::vector<std::pair<lsn_t, LogRecordType>> {
+  std::vector<std::pair<lsn_t, LogRecordType>> records;
+  auto *log_data = new char[LOG_BUFFER_SIZE];
+  int64_t offset = disk_manager->GetLogStartOffset();
+  while (disk_manager->ReadLog(log_data, LOG_BUFFER_SIZE, offset)) {
+    int pos = 0;
+    while (pos + 20 <= LOG_BUFFER_SIZE) {
+      int32_t size = *reinterpret_cast<int32_t *>(log_data + pos);
+      if (size <= 0 || pos + size > LOG_BUFFER_SIZE) {
+        break;
+      }
+      records.emplace_back(*reinterpret_cast<lsn_t *>(log_data + pos + 4),
+                           *reinterpret_cast<LogRecordType *>(log_data + pos + 16));
+      pos += size;
+    }
+    if (pos == 0) {
+      break;
+    }
+    offset += pos;
+  }
+  delete[] log_data;
+  return records;
+}
+
 class RecoveryTest : public ::testing::Test {
  protected:
   // This function is called before every test.
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.log.free.0");
+    for (int segment = 1; segment < 16; segment++) {
+      remove(("test.log." + std::to_string(segment)).c_str());
+      remove(("test.log.free." + std::to_string(segment)).c_str());
+    }
+    remove("test.master");
   }
 
   // This function is called after every test.
@@ -39,11 +78,17 @@ class RecoveryTest : public ::testing::Test {
     LOG_INFO("Tearing down the system..");
     remove("test.db");
     remove("test.log");
+    remove("test.log.free.0");
+    for (int segment = 1; segment < 16; segment++) {
+      remove(("test.log." + std::to_string(segment)).c_str());
+      remove(("test.log.free." + std::to_string(segment)).c_str());
+    }
+    remove("test.master");
   };
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -101,7 +146,8 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
   delete txn;
 
   LOG_INFO("Begin recovery");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -132,7 +178,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -185,7 +231,8 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
   delete txn;
 
   LOG_INFO("Recovery started..");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -211,7 +258,214 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, CompensationTest) {
+  Schema schema({Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}});
+  auto make_tuple = [&](int a, int b) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, &schema};
+  };
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  const int num_tuples = 20;
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  for (int i = 0; i < num_tuples; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i, i), &rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  // Two losers whose records interleave in the log.
+  Transaction *updater = txn_mgr.Begin();
+  Transaction *deleter = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    if (i % 2 == 0) {
+      ASSERT_TRUE(test_table->UpdateTuple(make_tuple(i, -1), rids[i], updater));
+    } else {
+      ASSERT_TRUE(test_table->MarkDelete(rids[i], deleter));
+    }
+  }
+  RID new_rid;
+  ASSERT_TRUE(test_table->InsertTuple(make_tuple(num_tuples, num_tuples), &new_rid, updater));
+  const int num_loser_changes = num_tuples + 1;
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash before the losers commit");
+  delete updater;
+  delete deleter;
+  delete test_table;
+  log_manager->StopFlushThread();
+  auto restart = [&] {
+    delete bpm;
+    delete log_manager;
+    disk_manager->ShutDown();
+    delete disk_manager;
+    disk_manager = new DiskManager("test.db");
+    log_manager = new LogManager(disk_manager);
+    bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  };
+  restart();
+  lsn_t first_clr_lsn = log_manager->GetNextLSN();
+  {
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, num_loser_changes);
+  }
+  // Every undone change is logged and the undone pages carry the lsn of its CLR.
+  Page *page = bpm->FetchPage(rids[0].GetPageId());
+  ASSERT_NE(page, nullptr);
+  EXPECT_GE(page->GetLSN(), first_clr_lsn);
+  bpm->UnpinPage(rids[0].GetPageId(), false);
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+  std::vector<int64_t> clr_ends;
+  {
+    LogReader reader(disk_manager, disk_manager->GetLogStartOffset());
+    while (reader.Next()) {
+      if (*reinterpret_cast<const LogRecordType *>(reader.GetRecord() + 16) == LogRecordType::CLR) {
+        clr_ends.push_back(reader.GetRecordOffset() + reader.GetRecordSize());
+      }
+    }
+  }
+  ASSERT_EQ(clr_ends.size(), num_loser_changes);
+
+  LOG_INFO("System crash halfway through undo");
+  disk_manager->SetLogEndOffset(clr_ends[num_loser_changes / 2 - 1]);
+  restart();
+  {
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    // The changes compensated before the crash are not undone again.
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, num_loser_changes - num_loser_changes / 2);
+  }
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+  restart();
+  {
+    // Both losers are rolled back completely.
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, 0);
+  }
+
+  test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn));
+    EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), i);
+    EXPECT_EQ(tuple.GetValue(&schema, 1).GetAs<int32_t>(), i);
+  }
+  Tuple tuple;
+  EXPECT_FALSE(test_table->GetTuple(new_rid, &tuple, txn));
+  txn_mgr.Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ApplyDeleteUndoTest) {
+  Schema schema({Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}});
+  auto make_tuple = [&](int a, int b) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, &schema};
+  };
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  const int num_tuples = 3;
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  for (int i = 0; i < num_tuples; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i, i), &rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  // Empty the first slot, an insert would take it.
+  txn = txn_mgr.Begin();
+  ASSERT_TRUE(test_table->MarkDelete(rids[0], txn));
+  txn_mgr.Commit(txn);
+  delete txn;
+  // A loser that got as far as applying its delete, as a commit does before it logs COMMIT.
+  Transaction *loser = txn_mgr.Begin();
+  ASSERT_TRUE(test_table->MarkDelete(rids[1], loser));
+  test_table->ApplyDelete(rids[1], loser);
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash before the loser commits");
+  delete loser;
+  delete test_table;
+  log_manager->StopFlushThread();
+  auto restart = [&] {
+    delete bpm;
+    delete log_manager;
+    disk_manager->ShutDown();
+    delete disk_manager;
+    disk_manager = new DiskManager("test.db");
+    log_manager = new LogManager(disk_manager);
+    bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  };
+  auto check = [&] {
+    test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+    txn = txn_mgr.Begin();
+    Tuple tuple;
+    EXPECT_FALSE(test_table->GetTuple(rids[0], &tuple, txn));
+    for (int i = 1; i < num_tuples; i++) {
+      ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn));
+      EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), i);
+    }
+    txn_mgr.Commit(txn);
+    delete txn;
+    delete test_table;
+  };
+  restart();
+  {
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, 2);
+  }
+  // The tuple is back in its own slot, not in the free one before it.
+  check();
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash before the undone page is written");
+  restart();
+  {
+    // Redoing the CLR puts the tuple into the same slot again.
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, 0);
+  }
+  check();
+
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, CheckpointTest) {
   auto *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -314,4 +568,821 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   LOG_INFO("Shutdown System");
   delete bustub_instance;
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, GroupCommitTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  // Only commits should make the flush thread write.
+  log_timeout = std::chrono::seconds(15);
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  const int num_threads = 4;
+  const int txns_per_thread = 25;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < txns_per_thread; j++) {
+        Transaction *writer = bustub_instance->transaction_manager_->Begin();
+        RID rid;
+        EXPECT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, writer));
+        bustub_instance->transaction_manager_->Commit(writer);
+        // The commit returns only once the commit record is durable.
+        EXPECT_LE(writer->GetPrevLSN(), bustub_instance->log_manager_->GetPersistentLSN());
+        delete writer;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const int num_commits = num_threads * txns_per_thread + 1;
+  // Concurrent commits share flushes.
+  EXPECT_LT(bustub_instance->disk_manager_->GetNumFlushes(), num_commits);
+  bustub_instance->log_manager_->StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+  EXPECT_EQ(next_lsn - 1, bustub_instance->log_manager_->GetPersistentLSN());
+
+  // Every record made it to the log file, in lsn order.
+  auto records = ReadLogHeaders(bustub_instance->disk_manager_);
+  ASSERT_EQ(next_lsn, static_cast<lsn_t>(records.size()));
+  int num_commit_records = 0;
+  for (size_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(static_cast<lsn_t>(i), records[i].first);
+    if (records[i].second == LogRecordType::COMMIT) {
+      num_commit_records++;
+    }
+  }
+  EXPECT_EQ(num_commits, num_commit_records);
+
+  log_timeout = std::chrono::seconds(1);
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, AsyncCommitTest) {
+  auto *bustub_instance = new BustubInstance("test.db");
+  // Without asynchronous commits the flush thread would only write after the timeout.
+  log_timeout = std::chrono::seconds(15);
+  async_commit_delay = std::chrono::milliseconds(200);
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_logging);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  Transaction *writer = bustub_instance->transaction_manager_->Begin();
+  writer->SetAsyncCommit(true);
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, writer));
+  auto start = std::chrono::steady_clock::now();
+  bustub_instance->transaction_manager_->Commit(writer);
+  lsn_t commit_lsn = writer->GetPrevLSN();
+  delete writer;
+  // The commit returned before its record was written.
+  EXPECT_LT(bustub_instance->log_manager_->GetPersistentLSN(), commit_lsn);
+
+  // The flush thread writes it within the delay, long before the timeout.
+  while (bustub_instance->log_manager_->GetPersistentLSN() < commit_lsn) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  EXPECT_EQ(bustub_instance->log_manager_->GetNextLSN() - 1, bustub_instance->log_manager_->GetPersistentLSN());
+
+  bustub_instance->log_manager_->StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+  log_timeout = std::chrono::seconds(1);
+  async_commit_delay = std::chrono::milliseconds(10);
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ConcurrentAppendTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  // Enough records to fill the log buffer several times while appenders race for it.
+  const int num_threads = 4;
+  const int records_per_thread = 5000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i] {
+      lsn_t last_lsn = INVALID_LSN;
+      for (int j = 0; j < records_per_thread; j++) {
+        LogRecord log_record(i, last_lsn, LogRecordType::BEGIN);
+        lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+        EXPECT_GT(lsn, last_lsn);
+        last_lsn = lsn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  log_manager->StopFlushThread();
+  EXPECT_EQ(num_threads * records_per_thread, log_manager->GetNextLSN());
+  EXPECT_EQ(num_threads * records_per_thread - 1, log_manager->GetPersistentLSN());
+
+  // No slice was lost or overwritten.
+  auto records = ReadLogHeaders(disk_manager);
+  ASSERT_EQ(num_threads * records_per_thread, static_cast<int>(records.size()));
+  for (size_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(static_cast<lsn_t>(i), records[i].first);
+    EXPECT_EQ(LogRecordType::BEGIN, records[i].second);
+  }
+
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LogReaderTest) {
+  // Small segments and a small read ahead, so that records cross both segment and chunk boundaries.
+  auto *disk_manager = new DiskManager("test.db", 4000);
+  auto *log_manager = new LogManager(disk_manager);
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const int num_records = 500;
+  std::vector<int32_t> sizes;
+  for (int i = 0; i < num_records; i++) {
+    if (i % 3 == 0) {
+      LogRecord log_record(i, INVALID_LSN, LogRecordType::BEGIN);
+      log_manager->AppendLogRecord(&log_record);
+      sizes.push_back(log_record.GetSize());
+    } else {
+      LogRecord log_record(i, INVALID_LSN, LogRecordType::INSERT, RID(i, i), ConstructTuple(&schema));
+      log_manager->AppendLogRecord(&log_record);
+      sizes.push_back(log_record.GetSize());
+    }
+  }
+  log_manager->WaitUntilPersistent(num_records - 1);
+  int64_t log_end = disk_manager->GetLogEndOffset();
+  // A torn record at the end of the log.
+  char torn[10] = {100};
+  disk_manager->WriteLog(torn, sizeof(torn));
+
+  std::vector<int64_t> offsets;
+  {
+    LogReader reader(disk_manager, disk_manager->GetLogStartOffset(), 333);
+    int64_t offset = disk_manager->GetLogStartOffset();
+    while (reader.Next()) {
+      ASSERT_LT(offsets.size(), sizes.size());
+      EXPECT_EQ(offset, reader.GetRecordOffset());
+      EXPECT_EQ(sizes[offsets.size()], reader.GetRecordSize());
+      EXPECT_EQ(static_cast<lsn_t>(offsets.size()), *reinterpret_cast<const lsn_t *>(reader.GetRecord() + 4));
+      offsets.push_back(offset);
+      offset += reader.GetRecordSize();
+    }
+    EXPECT_EQ(num_records, static_cast<int>(offsets.size()));
+    EXPECT_EQ(log_end, reader.GetRecordOffset());
+  }
+
+  // Reading can start at any record.
+  {
+    LogReader reader(disk_manager, offsets[num_records / 2], 333);
+    ASSERT_TRUE(reader.Next());
+    EXPECT_EQ(num_records / 2, *reinterpret_cast<const lsn_t *>(reader.GetRecord() + 4));
+  }
+
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ReopenLogTest) {
+  const int num_records = 300;
+  auto *disk_manager = new DiskManager("test.db", 4000);
+  auto *log_manager = new LogManager(disk_manager);
+  for (int i = 0; i < num_records; i++) {
+    LogRecord log_record(i, INVALID_LSN, LogRecordType::BEGIN);
+    log_manager->AppendLogRecord(&log_record);
+  }
+  log_manager->WaitUntilPersistent(num_records - 1);
+  int64_t log_end = disk_manager->GetLogEndOffset();
+  // A torn record at the end of the log.
+  char torn[10] = {100};
+  disk_manager->WriteLog(torn, sizeof(torn));
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  // The reopened log continues the lsns of the old one, right behind its last complete record.
+  disk_manager = new DiskManager("test.db", 4000);
+  log_manager = new LogManager(disk_manager);
+  EXPECT_EQ(log_end, disk_manager->GetLogEndOffset());
+  EXPECT_EQ(num_records, log_manager->GetNextLSN());
+  EXPECT_EQ(num_records - 1, log_manager->GetPersistentLSN());
+  for (int i = 0; i < num_records; i++) {
+    LogRecord log_record(i, INVALID_LSN, LogRecordType::COMMIT);
+    EXPECT_EQ(num_records + i, log_manager->AppendLogRecord(&log_record));
+  }
+  log_manager->WaitUntilPersistent(2 * num_records - 1);
+
+  auto records = ReadLogHeaders(disk_manager);
+  ASSERT_EQ(2 * num_records, static_cast<int>(records.size()));
+  for (size_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(static_cast<lsn_t>(i), records[i].first);
+    EXPECT_EQ(i < num_records ? LogRecordType::BEGIN : LogRecordType::COMMIT, records[i].second);
+  }
+
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, RecycledLogTest) {
+  const int segment_size = 4000;
+  const int num_records = 1000;
+  auto *disk_manager = new DiskManager("test.db", segment_size);
+  auto *log_manager = new LogManager(disk_manager);
+  for (int i = 0; i < num_records; i++) {
+    LogRecord log_record(i, INVALID_LSN, LogRecordType::BEGIN);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+    // The log can only be truncated at the start of a write.
+    if (i % 100 == 99) {
+      log_manager->WaitUntilPersistent(lsn);
+    }
+  }
+  // Recycle the segments before the last one, the next segment reuses one of them.
+  log_manager->TruncateLog(num_records - 1);
+  int64_t next_segment_end = (disk_manager->GetLogEndOffset() / segment_size + 1) * segment_size;
+  int num_more = 0;
+  while (disk_manager->GetLogEndOffset() <= next_segment_end - segment_size) {
+    LogRecord log_record(num_more, INVALID_LSN, LogRecordType::COMMIT);
+    log_manager->WaitUntilPersistent(log_manager->AppendLogRecord(&log_record));
+    num_more++;
+  }
+  int64_t log_end = disk_manager->GetLogEndOffset();
+  ASSERT_LT(log_end, next_segment_end);
+  struct stat stat_buf;
+  ASSERT_EQ(stat(("test.log." + std::to_string(log_end / segment_size)).c_str(), &stat_buf), 0);
+  EXPECT_EQ(stat_buf.st_size, segment_size);
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  // The stale records behind the end of the log do not continue its lsns, the reopened log ends before them.
+  disk_manager = new DiskManager("test.db", segment_size);
+  log_manager = new LogManager(disk_manager);
+  EXPECT_EQ(log_end, disk_manager->GetLogEndOffset());
+  EXPECT_EQ(num_records + num_more, log_manager->GetNextLSN());
+
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ParallelRedoTest) {
+  // A pool large enough to hold the whole table, so that nothing but the log reaches disk before the crash.
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+
+  const int num_tuples = 2000;
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < num_tuples; i++) {
+    tuples.emplace_back(ConstructTuple(&schema));
+    ASSERT_TRUE(test_table->InsertTuple(tuples.back(), &rids[i], txn));
+  }
+  // Delete every other tuple in a second transaction.
+  txn_mgr.Commit(txn);
+  delete txn;
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i += 2) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  page_id_t last_page_id = rids.back().GetPageId();
+  ASSERT_GT(last_page_id, 8);
+  delete test_table;
+
+  LOG_INFO("System crash after commit");
+  log_manager->StopFlushThread();
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LogRecovery log_recovery(disk_manager, bpm, log_manager, 4);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  // BEGIN, NEWPAGE, inserts, new pages, COMMIT, BEGIN, deletes, applied deletes, COMMIT.
+  const auto num_pages = static_cast<uint64_t>(last_page_id - first_page_id + 1);
+  const auto &stats = log_recovery.GetStatistics();
+  EXPECT_EQ(stats.num_records_, num_pages + num_tuples + num_tuples + 4);
+  // Nothing but the log survived, so every record touching a page was replayed.
+  EXPECT_EQ(stats.num_redone_, stats.num_records_ - 4);
+  EXPECT_EQ(stats.num_undone_, 0);
+  EXPECT_GT(stats.RedoThroughput(), 0);
+
+  test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_EQ(i % 2 == 1, test_table->GetTuple(rids[i], &tuple, txn));
+    if (i % 2 == 1) {
+      ASSERT_EQ(tuple.GetValue(&schema, 0).CompareEquals(tuples[i].GetValue(&schema, 0)), CmpBool::CmpTrue);
+      ASSERT_EQ(tuple.GetValue(&schema, 1).CompareEquals(tuples[i].GetValue(&schema, 1)), CmpBool::CmpTrue);
+    }
+  }
+  // The page chain was rebuilt as well.
+  int num_scanned = 0;
+  for (auto it = test_table->Begin(txn); it != test_table->End(); ++it) {
+    num_scanned++;
+  }
+  EXPECT_EQ(num_tuples / 2, num_scanned);
+  txn_mgr.Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, FuzzyCheckpointTest) {
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  CheckpointManager checkpoint_mgr(&txn_mgr, log_manager, bpm);
+  log_manager->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  auto insert = [&](TableHeap *table, Transaction *txn, int num_tuples, std::vector<RID> *rids) {
+    for (int i = 0; i < num_tuples; i++) {
+      RID rid;
+      ASSERT_TRUE(table->InsertTuple(ConstructTuple(&schema), &rid, txn));
+      rids->push_back(rid);
+    }
+  };
+
+  std::vector<RID> committed_rids;
+  std::vector<RID> loser_rids;
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  insert(test_table, txn, 500, &committed_rids);
+  txn_mgr.Commit(txn);
+  delete txn;
+  checkpoint_mgr.BeginCheckpoint();
+  checkpoint_mgr.EndCheckpoint();
+
+  // The checkpoint neither waits for nor blocks the running transaction.
+  Transaction *loser = txn_mgr.Begin();
+  insert(test_table, loser, 50, &loser_rids);
+  txn = txn_mgr.Begin();
+  insert(test_table, txn, 200, &committed_rids);
+  txn_mgr.Commit(txn);
+  delete txn;
+  checkpoint_mgr.BeginCheckpoint();
+  insert(test_table, loser, 50, &loser_rids);
+  checkpoint_mgr.EndCheckpoint();
+  lsn_t next_lsn = log_manager->GetNextLSN();
+
+  LOG_INFO("System crash before the loser commits");
+  delete loser;
+  delete test_table;
+  log_manager->StopFlushThread();
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LogRecovery log_recovery(disk_manager, bpm, log_manager);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  // Recovery skipped the part of the log before the loser began.
+  const auto &stats = log_recovery.GetStatistics();
+  EXPECT_GT(stats.start_offset_, 0);
+  EXPECT_LT(stats.num_records_, static_cast<uint64_t>(next_lsn));
+  EXPECT_EQ(stats.num_undone_, loser_rids.size());
+
+  test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+  txn = txn_mgr.Begin();
+  Tuple tuple;
+  for (const auto &rid : committed_rids) {
+    ASSERT_TRUE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  int num_scanned = 0;
+  for (auto it = test_table->Begin(txn); it != test_table->End(); ++it) {
+    num_scanned++;
+  }
+  EXPECT_EQ(committed_rids.size(), num_scanned);
+  txn_mgr.Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LargeCheckpointTest) {
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  CheckpointManager checkpoint_mgr(&txn_mgr, log_manager, bpm);
+  log_manager->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  txn_mgr.Commit(txn);
+  delete txn;
+
+  // More active transactions than one END_CHECKPOINT record may hold, a single record would not fit the log buffer.
+  const int num_losers = LOG_BUFFER_SIZE / 8 + 100;
+  std::vector<Transaction *> losers;
+  for (int i = 0; i < num_losers; i++) {
+    losers.push_back(txn_mgr.Begin());
+  }
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &loser_rid, losers.front()));
+  checkpoint_mgr.BeginCheckpoint();
+  checkpoint_mgr.EndCheckpoint();
+
+  LOG_INFO("System crash before the losers commit");
+  for (auto *loser : losers) {
+    delete loser;
+  }
+  delete test_table;
+  log_manager->StopFlushThread();
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  int num_end_records = 0;
+  for (const auto &[lsn, type] : ReadLogHeaders(disk_manager)) {
+    num_end_records += type == LogRecordType::END_CHECKPOINT ? 1 : 0;
+  }
+  EXPECT_GT(num_end_records, 1);
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  {
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, 1);
+  }
+
+  test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+  txn = txn_mgr.Begin();
+  Tuple tuple;
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, &tuple, txn));
+  txn_mgr.Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DeltaUpdateTest) {
+  Column col1{"a", TypeId::INTEGER};
+  Column col2{"b", TypeId::BIGINT};
+  Column col3{"c", TypeId::VARCHAR, 200};
+  std::vector<Column> cols{col1, col2, col3};
+  Schema schema{cols};
+  const std::string padding(180, 'x');
+  auto make_tuple = [&](int a, int64_t b) {
+    return Tuple{{ValueFactory::GetIntegerValue(a), ValueFactory::GetBigIntValue(b),
+                  ValueFactory::GetVarcharValue(padding)},
+                 &schema};
+  };
+
+  // Changing one 8 byte column of a 200 byte row logs a few bytes instead of both rows.
+  Tuple old_tuple = make_tuple(1, 1);
+  Tuple new_tuple = make_tuple(1, 2);
+  LogRecord delta_record(0, INVALID_LSN, LogRecordType::UPDATE, RID(0, 0), old_tuple, new_tuple);
+  EXPECT_EQ(delta_record.GetLogRecordType(), LogRecordType::UPDATE_DELTA);
+  EXPECT_EQ(delta_record.GetDeltaRanges().size(), 1);
+  EXPECT_LT(delta_record.GetSize(), 60);
+  // A tuple that changes its size is logged in full.
+  LogRecord full_record(0, INVALID_LSN, LogRecordType::UPDATE, RID(0, 0), old_tuple, ConstructTuple(&schema));
+  EXPECT_EQ(full_record.GetLogRecordType(), LogRecordType::UPDATE);
+
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  const int num_tuples = 100;
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_mgr.Begin();
+  auto *test_table = new TableHeap(bpm, &lock_manager, log_manager, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  for (int i = 0; i < num_tuples; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(make_tuple(i, 0), &rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(i, i * 10), rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  // The loser's updates reach the log but it never commits.
+  Transaction *loser = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    ASSERT_TRUE(test_table->UpdateTuple(make_tuple(i, -1), rids[i], loser));
+  }
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash before the loser commits");
+  delete loser;
+  delete test_table;
+  log_manager->StopFlushThread();
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  int num_delta_records = 0;
+  for (const auto &[lsn, type] : ReadLogHeaders(disk_manager)) {
+    EXPECT_NE(type, LogRecordType::UPDATE);
+    num_delta_records += type == LogRecordType::UPDATE_DELTA ? 1 : 0;
+  }
+  EXPECT_EQ(num_delta_records, 2 * num_tuples);
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LogRecovery log_recovery(disk_manager, bpm, log_manager);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  EXPECT_EQ(log_recovery.GetStatistics().num_undone_, num_tuples);
+
+  test_table = new TableHeap(bpm, &lock_manager, log_manager, first_page_id);
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn));
+    EXPECT_EQ(tuple.GetValue(&schema, 0).GetAs<int32_t>(), i);
+    EXPECT_EQ(tuple.GetValue(&schema, 1).GetAs<int64_t>(), i * 10);
+  }
+  txn_mgr.Commit(txn);
+
+  delete txn;
+  delete test_table;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, HashIndexRedoTest) {
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  // Enough keys for several splits, removing half of them merges buckets again.
+  const int num_keys = 5000;
+  page_id_t directory_page_id;
+  uint32_t global_depth;
+  {
+    ExtendibleHashTable<int, int, IntComparator> ht("index", bpm, IntComparator(), HashFunction<int>(), log_manager);
+    for (int i = 0; i < num_keys; i++) {
+      ASSERT_TRUE(ht.Insert(nullptr, i, i));
+    }
+    for (int i = 0; i < num_keys; i += 2) {
+      ASSERT_TRUE(ht.Remove(nullptr, i, i));
+    }
+    ht.VerifyIntegrity();
+    directory_page_id = ht.GetDirectoryPageId();
+    global_depth = ht.GetGlobalDepth();
+    ASSERT_GT(global_depth, 2);
+  }
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash before any index page reaches disk");
+  log_manager->StopFlushThread();
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager("test.db");
+  log_manager = new LogManager(disk_manager);
+  bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LogRecovery log_recovery(disk_manager, bpm, log_manager, 4);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  EXPECT_EQ(log_recovery.GetStatistics().num_redone_, log_recovery.GetStatistics().num_records_);
+
+  // The index is back without rebuilding it.
+  ExtendibleHashTable<int, int, IntComparator> ht("index", bpm, IntComparator(), HashFunction<int>(), log_manager,
+                                                  directory_page_id);
+  ht.VerifyIntegrity();
+  EXPECT_EQ(ht.GetGlobalDepth(), global_depth);
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<int> result;
+    ASSERT_EQ(i % 2 == 1, ht.GetValue(nullptr, i, &result)) << i;
+  }
+
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, IndexPageFlushTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(16, disk_manager, log_manager);
+  log_manager->RunFlushThread();
+  {
+    // The occupied bits of slots 32 to 39 sit where other pages keep their page LSN.
+    ExtendibleHashTable<int, int, IntComparator> ht("index", bpm, IntComparator(), HashFunction<int>(), log_manager);
+    for (int i = 0; i < 40; i++) {
+      ASSERT_TRUE(ht.Insert(nullptr, i, i));
+    }
+  }
+  // Without the flush thread the log is only written on request.
+  log_manager->StopFlushThread();
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+  lsn_t persistent_lsn = log_manager->GetPersistentLSN();
+  ASSERT_LT(persistent_lsn, 0xFF);
+
+  // The index pages only need their PAGE_DELTA records on disk, not the later records still in the buffer.
+  LogRecord log_record(0, INVALID_LSN, LogRecordType::BEGIN);
+  log_manager->AppendLogRecord(&log_record);
+  bpm->FlushAllPages();
+  EXPECT_EQ(log_manager->GetPersistentLSN(), persistent_lsn);
+
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, HashIndexUndoTest) {
+  Schema key_schema({Column{"a", TypeId::BIGINT}});
+  using HashIndex = ExtendibleHashTable<GenericKey<8>, RID, GenericComparator<8>>;
+  auto make_key = [](int64_t i) {
+    GenericKey<8> key;
+    key.SetFromInteger(i);
+    return key;
+  };
+  const size_t pool_size = 64;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  const int num_keys = 1000;
+  page_id_t directory_page_id;
+  {
+    HashIndex index("index", bpm, GenericComparator<8>(&key_schema), HashFunction<GenericKey<8>>(), log_manager);
+    directory_page_id = index.GetDirectoryPageId();
+    Transaction *txn = txn_mgr.Begin();
+    for (int i = 0; i < num_keys; i++) {
+      ASSERT_TRUE(index.Insert(txn, make_key(i), RID(i, i)));
+    }
+    txn_mgr.Commit(txn);
+    delete txn;
+    // The loser inserts enough keys to split buckets, and removes half of the committed ones.
+    Transaction *loser = txn_mgr.Begin();
+    for (int i = num_keys; i < 2 * num_keys; i++) {
+      ASSERT_TRUE(index.Insert(loser, make_key(i), RID(i, i)));
+    }
+    for (int i = 0; i < num_keys; i += 2) {
+      ASSERT_TRUE(index.Remove(loser, make_key(i), RID(i, i)));
+    }
+    // Both fail and change nothing, so neither is logged.
+    EXPECT_FALSE(index.Insert(loser, make_key(1), RID(1, 1)));
+    EXPECT_FALSE(index.Remove(loser, make_key(0), RID(0, 0)));
+    delete loser;
+  }
+  const int num_loser_changes = num_keys + num_keys / 2;
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash in the middle of the loser");
+  log_manager->StopFlushThread();
+  auto restart = [&] {
+    delete bpm;
+    delete log_manager;
+    disk_manager->ShutDown();
+    delete disk_manager;
+    disk_manager = new DiskManager("test.db");
+    log_manager = new LogManager(disk_manager);
+    bpm = new BufferPoolManagerInstance(pool_size, disk_manager, log_manager);
+  };
+  restart();
+  {
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, num_loser_changes);
+  }
+  log_manager->WaitUntilPersistent(log_manager->GetNextLSN() - 1);
+
+  LOG_INFO("System crash right after recovery");
+  restart();
+  {
+    // Undo of the index is logged as well, and the loser is not rolled back again.
+    LogRecovery log_recovery(disk_manager, bpm, log_manager);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetStatistics().num_undone_, 0);
+  }
+
+  HashIndex index("index", bpm, GenericComparator<8>(&key_schema), HashFunction<GenericKey<8>>(), log_manager,
+                  directory_page_id);
+  index.VerifyIntegrity();
+  for (int i = 0; i < 2 * num_keys; i++) {
+    std::vector<RID> result;
+    ASSERT_EQ(i < num_keys, index.GetValue(nullptr, make_key(i), &result)) << i;
+    if (i < num_keys) {
+      ASSERT_EQ(result.size(), 1);
+      EXPECT_EQ(result[0], RID(i, i));
+    }
+  }
+
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+}
 }  // namespace bustub
@@ -10,11 +10,17 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <sys/stat.h>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/mmap_disk_manager.h"
+#include "storage/disk/segmented_disk_manager.h"
+#include "storage/disk/simulated_disk_manager.h"
 
 namespace bustub {
 
@@ -23,14 +29,24 @@ class DiskManagerTest : public ::testing::Test {
   // This function is called before every test.
   void SetUp() override {
     remove("test.db");
-    remove("test.log");
+    RemoveLog();
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
-    remove("test.log");
+    RemoveLog();
   };
+
+  /** Removes the log segments and the recycled ones. */
+  static void RemoveLog() {
+    remove("test.log");
+    remove("test.log.free.0");
+    for (int segment = 1; segment < 64; segment++) {
+      remove(("test.log." + std::to_string(segment)).c_str());
+      remove(("test.log.free." + std::to_string(segment)).c_str());
+    }
+  }
 };
 
 // NOLINTNEXTLINE
@@ -72,6 +88,213 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  const int segment_size = 100;
+  char data[2][64];
+  char buf[256];
+  std::string db_file("test.db");
+  {
+    auto dm = DiskManager(db_file, segment_size);
+    // 10 writes of 64 bytes fill 6 segments and cross every segment boundary.
+    for (int i = 0; i < 10; i++) {
+      std::memset(data[i % 2], 'a' + i, sizeof(data[i % 2]));
+      dm.WriteLog(data[i % 2], sizeof(data[i % 2]));
+    }
+    EXPECT_EQ(dm.GetLogEndOffset(), 640);
+    struct stat stat_buf;
+    EXPECT_EQ(stat("test.log.6", &stat_buf), 0);
+    EXPECT_EQ(stat_buf.st_size, 40);
+
+    ASSERT_TRUE(dm.ReadLog(buf, sizeof(buf), 60));
+    for (int i = 0; i < 256; i++) {
+      EXPECT_EQ(buf[i], 'a' + (60 + i) / 64);
+    }
+    // Reading past the end of the log yields zeros.
+    ASSERT_TRUE(dm.ReadLog(buf, sizeof(buf), 600));
+    EXPECT_EQ(buf[39], 'j');
+    EXPECT_EQ(buf[40], 0);
+    EXPECT_FALSE(dm.ReadLog(buf, sizeof(buf), 640));
+
+    // Segments 0 to 2 end before offset 350, segment 3 still holds it.
+    dm.TruncateLog(350);
+    EXPECT_EQ(dm.GetLogStartOffset(), 300);
+    EXPECT_FALSE(dm.ReadLog(buf, sizeof(buf), 299));
+    ASSERT_TRUE(dm.ReadLog(buf, sizeof(buf), 350));
+    EXPECT_EQ(buf[0], 'f');
+    EXPECT_NE(stat("test.log", &stat_buf), 0);
+    EXPECT_EQ(stat("test.log.free.0", &stat_buf), 0);
+    EXPECT_EQ(stat("test.log.free.2", &stat_buf), 0);
+    dm.ShutDown();
+  }
+
+  // Reopening finds the start and the end of the log again, the next segment reuses a recycled file.
+  auto dm = DiskManager(db_file, segment_size);
+  EXPECT_EQ(dm.GetLogStartOffset(), 300);
+  EXPECT_EQ(dm.GetLogEndOffset(), 640);
+  std::memset(data[0], 'k', sizeof(data[0]));
+  dm.WriteLog(data[0], sizeof(data[0]));
+  ASSERT_TRUE(dm.ReadLog(buf, 64, 640));
+  EXPECT_EQ(buf[0], 'k');
+  EXPECT_EQ(buf[63], 'k');
+  struct stat stat_buf;
+  EXPECT_EQ(stat("test.log.7", &stat_buf), 0);
+  // The recycled file keeps its size, the old bytes behind the end of the log are only overwritten.
+  EXPECT_EQ(stat_buf.st_size, segment_size);
+  int num_free = 0;
+  for (int segment = 0; segment < 3; segment++) {
+    num_free += stat(("test.log.free." + std::to_string(segment)).c_str(), &stat_buf) == 0 ? 1 : 0;
+  }
+  EXPECT_EQ(num_free, 2);
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MmapReadOnlyTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  auto dm = DiskManager(db_file);
+  for (page_id_t page_id = 0; page_id < 100; page_id++) {
+    std::snprintf(data, sizeof(data), "Page %d", page_id);
+    dm.WritePage(page_id, data);
+  }
+  dm.ShutDown();
+
+  auto mdm = MmapDiskManager(db_file);
+  EXPECT_EQ(mdm.GetNumPages(), 100);
+  // Sequential reads go through the readahead path.
+  for (page_id_t page_id = 0; page_id < 100; page_id++) {
+    std::snprintf(data, sizeof(data), "Page %d", page_id);
+    mdm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  }
+
+  mdm.ReadPage(100, buf);  // tolerate reading past the end of the file
+  EXPECT_EQ(buf[0], 0);
+
+  EXPECT_THROW(mdm.WritePage(0, data), Exception);
+  EXPECT_FALSE(mdm.ReadLog(buf, sizeof(buf), 0));
+
+  mdm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, SegmentedReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::vector<std::string> dirs{"test_segments_a", "test_segments_b"};
+  for (const auto &dir : dirs) {
+    mkdir(dir.c_str(), 0755);
+  }
+  const int num_pages = 20;
+  const int pages_per_segment = 4;
+  {
+    auto dm = SegmentedDiskManager("test.db", dirs, pages_per_segment);
+    dm.ReadPage(0, buf);  // tolerate empty read
+    for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+      std::snprintf(data, sizeof(data), "Page %d", page_id);
+      dm.WritePage(page_id, data);
+    }
+    dm.ShutDown();
+  }
+
+  // Segments alternate between the two directories and the data survives a restart.
+  auto dm = SegmentedDiskManager("test.db", dirs, pages_per_segment);
+  EXPECT_EQ(dm.GetSegmentFileName(0), "test_segments_a/test.db.0");
+  EXPECT_EQ(dm.GetSegmentFileName(1), "test_segments_b/test.db.1");
+  for (page_id_t page_id = num_pages - 1; page_id >= 0; page_id--) {
+    std::snprintf(data, sizeof(data), "Page %d", page_id);
+    dm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  }
+  dm.ShutDown();
+
+  for (int segment_id = 0; segment_id < num_pages / pages_per_segment; segment_id++) {
+    struct stat stat_buf;
+    EXPECT_EQ(stat(dm.GetSegmentFileName(segment_id).c_str(), &stat_buf), 0);
+    EXPECT_EQ(stat_buf.st_size, pages_per_segment * PAGE_SIZE);
+    remove(dm.GetSegmentFileName(segment_id).c_str());
+  }
+  for (const auto &dir : dirs) {
+    rmdir(dir.c_str());
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, SimulatedDiskTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  SimulatedDiskOptions options;
+  options.read_latency_.mean_ = std::chrono::microseconds(100);
+  options.write_latency_.mean_ = std::chrono::microseconds(200);
+  options.bandwidth_bytes_per_sec_ = PAGE_SIZE * 1000;  // one page per millisecond
+  options.queue_depth_ = 1;
+  options.sleep_ = false;
+  auto dm = SimulatedDiskManager(options);
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  dm.ReadPage(0, buf);  // tolerate empty read
+  dm.WritePage(5, data);
+  dm.ReadPage(5, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+
+  dm.WriteLog(data, 16);
+  EXPECT_TRUE(dm.ReadLog(buf, 16, 0));
+  EXPECT_EQ(std::memcmp(buf, data, 16), 0);
+  EXPECT_FALSE(dm.ReadLog(buf, 16, 16));
+
+  auto trace = dm.GetTrace();
+  ASSERT_EQ(trace.size(), 5);
+  EXPECT_EQ(trace[0].op_, IoTraceEntry::Op::READ_PAGE);
+  EXPECT_EQ(trace[1].op_, IoTraceEntry::Op::WRITE_PAGE);
+  EXPECT_EQ(trace[1].page_id_, 5);
+  EXPECT_EQ(trace[1].latency_, std::chrono::microseconds(1200));
+  EXPECT_EQ(trace[2].latency_, std::chrono::microseconds(1100));
+  EXPECT_EQ(trace[2].issue_time_, std::chrono::microseconds(2300));
+  EXPECT_EQ(dm.GetSimulatedTime(), std::chrono::microseconds(1100 + 1200 + 1100 + 203 + 103));
+
+  // The same seed gives the same latencies.
+  options.read_latency_.kind_ = LatencyDistribution::Kind::EXPONENTIAL;
+  auto dm1 = SimulatedDiskManager(options);
+  auto dm2 = SimulatedDiskManager(options);
+  for (int i = 0; i < 10; i++) {
+    dm1.ReadPage(i, buf);
+    dm2.ReadPage(i, buf);
+  }
+  EXPECT_EQ(dm1.GetSimulatedTime(), dm2.GetSimulatedTime());
+
+  // Up to queue_depth I/Os overlap, the transfers still take turns on the channel.
+  options.read_latency_.kind_ = LatencyDistribution::Kind::CONSTANT;
+  options.queue_depth_ = 2;
+  auto dm3 = SimulatedDiskManager(options);
+  for (int i = 0; i < 4; i++) {
+    dm3.ReadPage(i, buf);
+  }
+  trace = dm3.GetTrace();
+  ASSERT_EQ(trace.size(), 4);
+  // Two reads are issued at once, the third once the first is done at 1100us, the fourth once the second is at 2100us.
+  EXPECT_EQ(trace[0].issue_time_, std::chrono::microseconds(0));
+  EXPECT_EQ(trace[1].issue_time_, std::chrono::microseconds(0));
+  EXPECT_EQ(trace[1].latency_, std::chrono::microseconds(2100));
+  EXPECT_EQ(trace[2].issue_time_, std::chrono::microseconds(1100));
+  EXPECT_EQ(trace[2].latency_, std::chrono::microseconds(2000));
+  EXPECT_EQ(trace[3].issue_time_, std::chrono::microseconds(2100));
+  EXPECT_EQ(trace[3].latency_, std::chrono::microseconds(2000));
+
+  // Without the bandwidth cap, the reads in flight together take no longer than one.
+  options.bandwidth_bytes_per_sec_ = 0;
+  auto dm4 = SimulatedDiskManager(options);
+  for (int i = 0; i < 4; i++) {
+    dm4.ReadPage(i, buf);
+  }
+  trace = dm4.GetTrace();
+  EXPECT_EQ(trace[1].issue_time_, std::chrono::microseconds(0));
+  EXPECT_EQ(trace[2].issue_time_, std::chrono::microseconds(100));
+  EXPECT_EQ(trace[3].issue_time_, std::chrono::microseconds(100));
+  EXPECT_EQ(trace[3].latency_, std::chrono::microseconds(100));
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
@@ -0,0 +1,402 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// recovery_bench.cpp
+//
+// Identification: tools/recovery_bench/recovery_bench.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "catalog/schema.h"
+#include "common/exception.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "recovery/checkpoint_manager.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+// Runs a multi-threaded insert/update/delete workload against a table heap, crashes it at a random point, recovers
+// and checks that exactly the committed transactions survived. Every worker owns the tuples it inserts, so workers
+// never wait for each other's locks and can simply drop their running transaction at the crash.
+//
+// A crash keeps nothing but the database file and the log: the buffer pool is discarded without flushing it and the
+// log is cut at a random offset between the end that was durable when the workload stopped and the end of everything
+// appended, i.e. the log buffer that was still in memory is partially lost. After recovery the workload goes on with
+// the recovered database and log and crashes again, --reopens times per round.
+
+namespace bustub {
+
+/** Options of a benchmark run, each can be set on the command line as --name=value. */
+struct BenchOptions {
+  int threads_{4};
+  /** The crash comes after a random number of committed transactions, at most this many. */
+  int txns_{2000};
+  int ops_per_txn_{8};
+  /** The share of transactions that roll back instead of committing. */
+  double abort_ratio_{0.1};
+  size_t pool_size_{64};
+  int rounds_{3};
+  /** Crash and recover this many more times per round, each time going on with the recovered database and log. */
+  int reopens_{1};
+  /** Take a fuzzy checkpoint this often, 0 to never take one. */
+  int checkpoint_interval_ms_{0};
+  /** Lose a random part of the log tail that was not durable yet. */
+  bool truncate_tail_{true};
+  uint64_t seed_{15445};
+  std::string db_file_{"recovery_bench.db"};
+};
+
+/** The committed content of the tuples owned by one worker, the key is stored in the tuple next to the value. */
+using TableState = std::unordered_map<RID, std::pair<int32_t, int32_t>>;
+
+static auto LogStem(const BenchOptions &options) -> std::string {
+  return options.db_file_.substr(0, options.db_file_.rfind('.'));
+}
+
+static auto LogSegmentName(const BenchOptions &options, int segment) -> std::string {
+  return segment == 0 ? LogStem(options) + ".log" : LogStem(options) + ".log." + std::to_string(segment);
+}
+
+/** Removes the database file, the log segments and the master record. */
+static void RemoveFiles(const BenchOptions &options) {
+  std::filesystem::path db_path(options.db_file_);
+  std::string log_prefix = std::filesystem::path(LogStem(options)).filename().string() + ".log";
+  std::error_code error;
+  std::filesystem::remove(db_path, error);
+  std::filesystem::remove(LogStem(options) + ".master", error);
+  auto parent = db_path.has_parent_path() ? db_path.parent_path() : std::filesystem::path(".");
+  std::vector<std::filesystem::path> segments;
+  for (const auto &entry : std::filesystem::directory_iterator(parent, error)) {
+    if (entry.path().filename().string().compare(0, log_prefix.size(), log_prefix) == 0) {
+      segments.push_back(entry.path());
+    }
+  }
+  for (const auto &segment : segments) {
+    std::filesystem::remove(segment, error);
+  }
+}
+
+/** Cuts the log at offset, as if the writes behind it never reached the disk. */
+static void TruncateLogTail(const BenchOptions &options, int64_t offset) {
+  auto segment = static_cast<int>(offset / LOG_SEGMENT_SIZE);
+  if (std::filesystem::exists(LogSegmentName(options, segment))) {
+    std::filesystem::resize_file(LogSegmentName(options, segment), offset % LOG_SEGMENT_SIZE);
+  }
+  for (int next = segment + 1; std::filesystem::exists(LogSegmentName(options, next)); next++) {
+    std::filesystem::remove(LogSegmentName(options, next));
+  }
+}
+
+static auto MakeTuple(const Schema &schema, int32_t key, int32_t value) -> Tuple {
+  return Tuple({ValueFactory::GetIntegerValue(key), ValueFactory::GetIntegerValue(value)}, &schema);
+}
+
+/** @return the time it takes to process a GB of log at the rate time / bytes, in seconds */
+static auto SecondsPerGigabyte(std::chrono::microseconds time, uint64_t bytes) -> double {
+  return bytes == 0 ? 0 : static_cast<double>(time.count()) / 1e6 * (1ULL << 30) / static_cast<double>(bytes);
+}
+
+/** Totals over all rounds. */
+struct BenchResult {
+  uint64_t log_bytes_{0};
+  std::chrono::microseconds redo_time_{0};
+  std::chrono::microseconds undo_time_{0};
+  int num_recoveries_{0};
+  int num_inconsistent_{0};
+};
+
+/**
+ * Runs the workload until a random crash point, recovers and verifies, once more for every reopen. The workloads after
+ * the first go on with the recovered database and log.
+ */
+static void RunRound(const BenchOptions &options, int round, BenchResult *result) {
+  RemoveFiles(options);
+  std::mt19937_64 rng(options.seed_ + round);
+  Schema schema({Column{"key", TypeId::INTEGER}, Column{"value", TypeId::INTEGER}});
+
+  auto *disk_manager = new DiskManager(options.db_file_);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManagerInstance(options.pool_size_, disk_manager, log_manager);
+  auto *lock_manager = new LockManager();
+  auto *txn_mgr = new TransactionManager(lock_manager, log_manager);
+  log_manager->RunFlushThread();
+
+  Transaction *txn = txn_mgr->Begin();
+  auto *table = new TableHeap(bpm, lock_manager, log_manager, txn);
+  page_id_t first_page_id = table->GetFirstPageId();
+  txn_mgr->Commit(txn);
+  delete txn;
+
+  std::vector<TableState> states(options.threads_);
+  // Keys are never reused, not even those of transactions lost in a crash.
+  std::vector<int32_t> next_keys(options.threads_);
+  for (int id = 0; id < options.threads_; id++) {
+    next_keys[id] = id;
+  }
+  for (int reopen = 0; reopen <= options.reopens_; reopen++) {
+    const int crash_point = std::uniform_int_distribution<int>(1, options.txns_)(rng);
+    auto *checkpoint_mgr = new CheckpointManager(txn_mgr, log_manager, bpm);
+    if (reopen > 0) {
+      log_manager->RunFlushThread();
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> num_committed{0};
+    std::vector<Transaction *> abandoned(options.threads_, nullptr);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < options.threads_; id++) {
+      workers.emplace_back([&, id] {
+        int64_t run = round * (options.reopens_ + 1) + reopen;
+        std::mt19937_64 worker_rng(options.seed_ + run * options.threads_ + id + 1);
+        std::uniform_real_distribution<double> coin(0, 1);
+        TableState &committed = states[id];
+        std::vector<RID> live;
+        for (const auto &[rid, content] : committed) {
+          live.push_back(rid);
+        }
+        int32_t &next_key = next_keys[id];
+        while (true) {
+          Transaction *txn = txn_mgr->Begin();
+          // The new content of the tuples changed by txn, nullopt for deleted ones.
+          std::unordered_map<RID, std::optional<std::pair<int32_t, int32_t>>> changes;
+          // Where the transaction stops if the crash comes while it runs.
+          int crash_op = std::uniform_int_distribution<int>(0, options.ops_per_txn_ - 1)(worker_rng);
+          for (int op = 0; op < options.ops_per_txn_; op++) {
+            if (stop && op >= crash_op) {
+              abandoned[id] = txn;
+              return;
+            }
+            double dice = coin(worker_rng);
+            auto value = static_cast<int32_t>(worker_rng() & 0x7fffffff);
+            if (live.empty() || dice < 0.5) {
+              RID rid;
+              if (!table->InsertTuple(MakeTuple(schema, next_key, value), &rid, txn)) {
+                throw Exception("insert failed");
+              }
+              changes[rid] = std::make_pair(next_key, value);
+              next_key += options.threads_;
+              continue;
+            }
+            RID rid = live[worker_rng() % live.size()];
+            auto change = changes.find(rid);
+            if (change != changes.end() && !change->second.has_value()) {
+              continue;
+            }
+            int32_t key = committed[rid].first;
+            if (dice < 0.8) {
+              if (!table->UpdateTuple(MakeTuple(schema, key, value), rid, txn)) {
+                throw Exception("update failed");
+              }
+              changes[rid] = std::make_pair(key, value);
+            } else {
+              if (!table->MarkDelete(rid, txn)) {
+                throw Exception("delete failed");
+              }
+              changes[rid] = std::nullopt;
+            }
+          }
+          if (coin(worker_rng) < options.abort_ratio_) {
+            txn_mgr->Abort(txn);
+            txn_mgr->Recycle(txn);
+            continue;
+          }
+          txn_mgr->Commit(txn);
+          txn_mgr->Recycle(txn);
+          for (const auto &[rid, content] : changes) {
+            bool existed = committed.count(rid) != 0;
+            if (content.has_value()) {
+              committed[rid] = *content;
+              if (!existed) {
+                live.push_back(rid);
+              }
+            } else {
+              committed.erase(rid);
+              live.erase(std::find(live.begin(), live.end(), rid));
+            }
+          }
+          if (++num_committed >= crash_point) {
+            stop = true;
+          }
+        }
+      });
+    }
+    std::thread checkpointer;
+    if (options.checkpoint_interval_ms_ > 0) {
+      checkpointer = std::thread([&] {
+        while (!stop) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(options.checkpoint_interval_ms_));
+          checkpoint_mgr->BeginCheckpoint();
+          checkpoint_mgr->EndCheckpoint();
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    if (checkpointer.joinable()) {
+      checkpointer.join();
+    }
+
+    // Crash. Every commit returned so far is durable, the rest of the log may or may not have made it to disk.
+    int64_t durable_end = disk_manager->GetLogEndOffset();
+    log_manager->StopFlushThread();
+    int64_t log_end = disk_manager->GetLogEndOffset();
+    for (auto *loser : abandoned) {
+      delete loser;
+    }
+    delete table;
+    delete checkpoint_mgr;
+    delete txn_mgr;
+    delete lock_manager;
+    delete bpm;
+    delete log_manager;
+    disk_manager->ShutDown();
+    delete disk_manager;
+    int64_t cut = options.truncate_tail_ ? std::uniform_int_distribution<int64_t>(durable_end, log_end)(rng) : log_end;
+    TruncateLogTail(options, cut);
+
+    disk_manager = new DiskManager(options.db_file_);
+    log_manager = new LogManager(disk_manager);
+    bpm = new BufferPoolManagerInstance(options.pool_size_, disk_manager, log_manager);
+    {
+      LogRecovery log_recovery(disk_manager, bpm, log_manager);
+      log_recovery.Redo();
+      log_recovery.Undo();
+      const auto &stats = log_recovery.GetStatistics();
+      result->log_bytes_ += stats.log_bytes_;
+      result->redo_time_ += stats.redo_time_;
+      result->undo_time_ += stats.undo_time_;
+      result->num_recoveries_++;
+      printf("round %d, reopen %d: crashed after %d commits, lost %ld of %ld log bytes\n", round, reopen,
+             num_committed.load(), log_end - cut, log_end);
+      printf("  redo: %lu records, %lu replayed, %lu bytes in %.3f ms (%.2f s/GB)\n", stats.num_records_,
+             stats.num_redone_, stats.log_bytes_, static_cast<double>(stats.redo_time_.count()) / 1000,
+             SecondsPerGigabyte(stats.redo_time_, stats.log_bytes_));
+      printf("  undo: %lu records rolled back in %.3f ms (%.2f s/GB)\n", stats.num_undone_,
+             static_cast<double>(stats.undo_time_.count()) / 1000,
+             SecondsPerGigabyte(stats.undo_time_, stats.log_bytes_));
+    }
+
+    // Exactly the committed transactions survived.
+    lock_manager = new LockManager();
+    txn_mgr = new TransactionManager(lock_manager, log_manager);
+    table = new TableHeap(bpm, lock_manager, log_manager, first_page_id);
+    txn = txn_mgr->Begin();
+    size_t num_expected = 0;
+    int num_errors = 0;
+    for (const auto &state : states) {
+      num_expected += state.size();
+      for (const auto &[rid, content] : state) {
+        Tuple tuple;
+        if (!table->GetTuple(rid, &tuple, txn) || tuple.GetValue(&schema, 0).GetAs<int32_t>() != content.first ||
+            tuple.GetValue(&schema, 1).GetAs<int32_t>() != content.second) {
+          num_errors++;
+        }
+      }
+    }
+    size_t num_scanned = 0;
+    for (auto it = table->Begin(txn); it != table->End(); ++it) {
+      num_scanned++;
+    }
+    txn_mgr->Commit(txn);
+    delete txn;
+    if (num_errors > 0 || num_scanned != num_expected) {
+      printf("  INCONSISTENT: %d committed tuples lost or wrong, %zu tuples found for %zu expected\n", num_errors,
+             num_scanned, num_expected);
+      result->num_inconsistent_++;
+      break;
+    }
+    printf("  consistent: %zu tuples\n", num_expected);
+  }
+
+  delete table;
+  delete txn_mgr;
+  delete lock_manager;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+  RemoveFiles(options);
+}
+
+static auto ParseOptions(int argc, char **argv, BenchOptions *options) -> bool {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto equal = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equal == std::string::npos) {
+      return false;
+    }
+    std::string name = arg.substr(2, equal - 2);
+    std::string value = arg.substr(equal + 1);
+    if (name == "threads") {
+      options->threads_ = std::stoi(value);
+    } else if (name == "txns") {
+      options->txns_ = std::stoi(value);
+    } else if (name == "ops_per_txn") {
+      options->ops_per_txn_ = std::stoi(value);
+    } else if (name == "abort_ratio") {
+      options->abort_ratio_ = std::stod(value);
+    } else if (name == "pool_size") {
+      options->pool_size_ = std::stoul(value);
+    } else if (name == "rounds") {
+      options->rounds_ = std::stoi(value);
+    } else if (name == "reopens") {
+      options->reopens_ = std::stoi(value);
+    } else if (name == "checkpoint_interval_ms") {
+      options->checkpoint_interval_ms_ = std::stoi(value);
+    } else if (name == "truncate_tail") {
+      options->truncate_tail_ = value != "0" && value != "false";
+    } else if (name == "seed") {
+      options->seed_ = std::stoull(value);
+    } else if (name == "db_file") {
+      options->db_file_ = value;
+    } else {
+      return false;
+    }
+  }
+  return options->threads_ > 0 && options->txns_ > 0 && options->ops_per_txn_ > 0 && options->rounds_ > 0 &&
+         options->reopens_ >= 0 && options->pool_size_ > 0 && options->db_file_.find('.') != std::string::npos;
+}
+
+static auto RunBench(int argc, char **argv) -> int {
+  BenchOptions options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--threads=N] [--txns=N] [--ops_per_txn=N] [--abort_ratio=R] [--pool_size=N] [--rounds=N]"
+                 " [--reopens=N] [--checkpoint_interval_ms=N] [--truncate_tail=0|1] [--seed=N] [--db_file=NAME.db]"
+              << std::endl;
+    return 2;
+  }
+  BenchResult result;
+  for (int round = 0; round < options.rounds_; round++) {
+    RunRound(options, round, &result);
+  }
+  printf("total: %lu log bytes, redo %.2f s/GB, undo %.2f s/GB, %d of %d recoveries inconsistent\n",
+         result.log_bytes_, SecondsPerGigabyte(result.redo_time_, result.log_bytes_),
+         SecondsPerGigabyte(result.undo_time_, result.log_bytes_), result.num_inconsistent_, result.num_recoveries_);
+  return result.num_inconsistent_ == 0 ? 0 : 1;
+}
+
+}  // namespace bustub
+
+auto main(int argc, char **argv) -> int { return bustub::RunBench(argc, argv); }